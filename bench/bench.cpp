@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+/*
+ * The microbenchmarks of the hot paths in the core, built as cpeditor_bench when CPEDITOR_BUILD_BENCHMARKS is ON.
+ * The inputs are generated from fixed seeds and the default settings are used, so every run measures the same work.
+ * The results are written in JSON, so that they can be compared across releases.
+ */
+
+#include "Core/Checker.hpp"
+#include "Core/EventLogger.hpp"
+#include "Core/MessageLogger.hpp"
+#include "Settings/SettingsManager.hpp"
+#include "Util/FileUtil.hpp"
+#include "Util/LineDiff.hpp"
+#include "Util/Util.hpp"
+#include "Widgets/TestCases.hpp"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QtConcurrent>
+#include <algorithm>
+#include <generated/SettingsHelper.hpp>
+#include <generated/version.hpp>
+#include <random>
+
+namespace
+{
+const int SAMPLE_COUNT = 10; // the number of timed samples of each benchmark
+
+volatile qint64 sink = 0; // the results are accumulated here, so that the measured work isn't optimized away
+
+// measures the benchmarks and collects the results
+class Bench
+{
+  public:
+    Bench(qint64 minTime, const QRegularExpression &filter, QTextStream &progress)
+        : minTime(minTime), filter(filter), progress(progress)
+    {
+    }
+
+    /**
+     * @brief measure a function
+     * @param name the name of the benchmark, like "group/case/size"
+     * @param bytes the size of the input processed by each call, 0 if it's not meaningful
+     * @param function the function to measure, it returns a value which is added to the sink
+     * @note The function is called in batches, a batch is doubled until it takes a tenth of the minimum time.
+     */
+    template <typename Function> void run(const QString &name, qint64 bytes, Function function)
+    {
+        if (!filter.match(name).hasMatch())
+            return;
+
+        sink = sink + function(); // warm up
+
+        QElapsedTimer timer;
+        qint64 batch = 1;
+        while (true)
+        {
+            timer.start();
+            for (qint64 i = 0; i < batch; ++i)
+                sink = sink + function();
+            if (timer.nsecsElapsed() * 10 >= minTime * 1000000 || batch >= (qint64(1) << 40))
+                break;
+            batch *= 2;
+        }
+
+        QVector<double> samples;
+        for (int s = 0; s < SAMPLE_COUNT; ++s)
+        {
+            timer.start();
+            for (qint64 i = 0; i < batch; ++i)
+                sink = sink + function();
+            samples.push_back(double(timer.nsecsElapsed()) / batch);
+        }
+        std::sort(samples.begin(), samples.end());
+
+        double mean = 0;
+        for (auto sample : samples)
+            mean += sample;
+        mean /= samples.size();
+
+        QJsonObject result;
+        result["name"] = name;
+        result["iterations"] = batch * SAMPLE_COUNT;
+        result["nsPerOp"] = mean;
+        result["minNsPerOp"] = samples.front();
+        result["medianNsPerOp"] = samples[samples.size() / 2];
+        result["bytesPerOp"] = bytes;
+        result["mbPerSecond"] = bytes == 0 ? 0.0 : bytes / samples[samples.size() / 2] * 1e9 / (1 << 20);
+        results.push_back(result);
+
+        progress << QString("%1 %2 ns/op\n").arg(name, -48).arg(samples[samples.size() / 2], 16, 'f', 1);
+        progress.flush();
+    }
+
+    QJsonArray toJson() const
+    {
+        return results;
+    }
+
+  private:
+    qint64 minTime;            // the minimum time of each benchmark in milliseconds
+    QRegularExpression filter; // only the benchmarks whose names match it are run
+    QTextStream &progress;     // a line is written into it when a benchmark is finished
+    QJsonArray results;        // the results of the finished benchmarks
+};
+
+// the sizes of the generated inputs, in lines
+const QVector<QPair<QString, int>> SIZES = {{"1K", 1000}, {"100K", 100000}, {"1M", 1000000}};
+
+// generates an output of a typical problem: lines of space-separated integers
+QString generateOutput(int lines, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> count(1, 8), value(-1000000000, 1000000000);
+    QString res;
+    for (int i = 0; i < lines; ++i)
+    {
+        int n = count(random);
+        for (int j = 0; j < n; ++j)
+        {
+            if (j)
+                res += ' ';
+            res += QString::number(value(random));
+        }
+        res += '\n';
+    }
+    return res;
+}
+
+// changes about one in a hundred lines of a text, so that the diff has some work to do
+QString mutate(const QString &text, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> percent(0, 99);
+    auto lines = text.split('\n');
+    for (auto &line : lines)
+    {
+        if (percent(random) == 0)
+            line += " 42";
+    }
+    return lines.join('\n');
+}
+
+void benchCheckers(Bench &bench)
+{
+    MessageLogger log;
+    qint64 verdicts = 0;
+
+    for (auto type : {Core::Checker::IgnoreTrailingSpaces, Core::Checker::Strict})
+    {
+        // the built-in checkers check synchronously, so the verdict is emitted inside reqeustCheck
+        Core::Checker checker(type, &log);
+        QObject::connect(&checker, &Core::Checker::checkFinished,
+                         [&verdicts](int, Core::Checker::Verdict verdict) { verdicts += verdict; });
+        checker.prepare(QString());
+        QString name = type == Core::Checker::Strict ? "strict" : "ignore-trailing-spaces";
+
+        for (const auto &size : SIZES)
+        {
+            auto output = generateOutput(size.second, 1);
+            // the same output with trailing spaces, so the whole output is compared and it's accepted
+            auto expected = type == Core::Checker::Strict ? output : QString(output).replace('\n', " \n");
+            bench.run("checker/" + name + "/" + size.first, output.size() * 2, [&] {
+                checker.reqeustCheck(0, QString(), output, expected);
+                return verdicts;
+            });
+        }
+    }
+}
+
+void benchDiff(Bench &bench)
+{
+    for (const auto &size : SIZES)
+    {
+        if (size.second > 100000)
+            break; // the diff is run in the background of the diff viewer, a million lines take too long to repeat
+
+        // DiffViewer::setText runs Util::diffLines in a worker thread, the diff generation is measured directly
+        auto output = generateOutput(size.second, 2);
+        auto expected = mutate(output, 3);
+        bench.run("diff/lines/" + size.first, output.size() * 2,
+                  [&] { return qint64(Util::diffLines(output, expected).rows.size()); });
+    }
+
+    for (const auto &size : SIZES)
+    {
+        auto output = generateOutput(size.second, 4);
+        auto expected = mutate(output, 5);
+        bench.run("diff/first-mismatches/" + size.first, output.size() * 2,
+                  [&] { return qint64(Util::firstMismatches(output, expected, 3).size()); });
+    }
+
+    auto line = generateOutput(1, 6).repeated(50).replace('\n', ' ');
+    auto changed = mutate(generateOutput(50, 6), 7).replace('\n', ' ');
+    bench.run("diff/tokens/long-line", line.size() * 2,
+              [&] { return qint64(Util::diffTokens(line, changed).first.size()); });
+}
+
+void benchSplitArgument(Bench &bench)
+{
+    const QString simple = "g++ -Wall -O2 -std=c++17";
+    const QString quoted = "g++ -Wall -O2 \"-DTITLE=\\\"A B\\\"\" -I'/path with spaces/include' -std=c++17";
+    QStringList many;
+    for (int i = 0; i < 100; ++i)
+        many.push_back(QString("-DMACRO_%1=\"value %1\"").arg(i));
+    const QString longCommand = "g++ " + many.join(' ');
+
+    bench.run("util/split-argument/simple", simple.size() * 2,
+              [&] { return qint64(Util::splitArgument(simple).size()); });
+    bench.run("util/split-argument/quoted", quoted.size() * 2,
+              [&] { return qint64(Util::splitArgument(quoted).size()); });
+    bench.run("util/split-argument/100-arguments", longCommand.size() * 2,
+              [&] { return qint64(Util::splitArgument(longCommand).size()); });
+}
+
+void benchFiles(Bench &bench, const QTemporaryDir &dir)
+{
+    const QVector<QPair<QString, int>> fileSizes = {{"4K", 4 << 10}, {"1M", 1 << 20}, {"16M", 16 << 20}};
+
+    for (const auto &size : fileSizes)
+    {
+        auto content = generateOutput(size.second / 50 + 1, 8).left(size.second);
+        auto path = dir.filePath("file-" + size.first + ".txt");
+
+        bench.run("file/save/" + size.first, content.size(), [&] {
+            return qint64(Util::saveFile(path, content, "Bench", false));
+        });
+        bench.run("file/save-safe/" + size.first, content.size(), [&] {
+            return qint64(Util::saveFile(path, content, "Bench", true));
+        });
+        bench.run("file/read/" + size.first, content.size(),
+                  [&] { return qint64(Util::readFile(path, "Bench").size()); });
+    }
+}
+
+void benchSavedTestCases(Bench &bench, const QTemporaryDir &dir)
+{
+    for (int count : {10, 100})
+    {
+        // the testcases are saved next to the source file by the rules in the settings, like the editor does
+        QDir sourceDir(dir.filePath(QString("testcases-%1").arg(count)));
+        sourceDir.mkpath(".");
+        auto sourcePath = sourceDir.filePath("sol.cpp");
+        Util::saveFile(sourcePath, "int main() {}\n", "Bench", false);
+        qint64 bytes = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            auto input = generateOutput(100, 100 + i), answer = generateOutput(100, 200 + i);
+            bytes += input.size() + answer.size();
+            Util::saveFile(Widgets::TestCases::inputFilePath(sourcePath, i), input, "Bench", false);
+            Util::saveFile(Widgets::TestCases::answerFilePath(sourcePath, i), answer, "Bench", false);
+        }
+        // find and read the files like TestCases::loadFromSavedFiles(), which reads them in the thread pool
+        bench.run(QString("testcases/load-saved/%1").arg(count), bytes, [&] {
+            QMap<int, QString> inputPaths, answerPaths;
+            Widgets::TestCases::findSavedFiles(sourcePath, inputPaths, answerPaths);
+            QList<Widgets::TestCases::TestCaseFile> files;
+            int lengthLimit = SettingsHelper::getLoadTestCaseFileLengthLimit();
+            for (auto it = inputPaths.cbegin(); it != inputPaths.cend(); ++it)
+                files.push_back({it.key(), true, it.value(), lengthLimit, Widgets::TestCases::TestCaseFile::Pending,
+                                 QString()});
+            for (auto it = answerPaths.cbegin(); it != answerPaths.cend(); ++it)
+                files.push_back({it.key(), false, it.value(), lengthLimit, Widgets::TestCases::TestCaseFile::Pending,
+                                 QString()});
+            qint64 loaded = 0;
+            for (const auto &file : QtConcurrent::blockingMapped(files, &Widgets::TestCases::readTestCaseFile))
+                loaded += file.content.size();
+            return loaded;
+        });
+    }
+}
+
+void benchSettings(Bench &bench)
+{
+    const QString key = "C++/Compile Command";
+    bench.run("settings/get/by-name", 0, [&] { return qint64(SettingsManager::get(key).toString().size()); });
+    bench.run("settings/get/typed", 0, [] { return qint64(SettingsHelper::getCppCompileCommand().size()); });
+    bench.run("settings/get/bool", 0, [] { return qint64(SettingsHelper::isSaveFaster()); });
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("cpeditor_bench");
+    QCoreApplication::setApplicationVersion(APP_VERSION "+g" GIT_COMMIT_HASH);
+
+    QTextStream cerr(stderr, QIODevice::WriteOnly);
+
+    QCommandLineParser parser;
+    parser.addVersionOption();
+    parser.addHelpOption();
+    parser.setApplicationDescription("Run the microbenchmarks of CP Editor and write the results in JSON.");
+    parser.addOptions({{"filter", "Only run the benchmarks whose names match <regex>.", "regex", "."},
+                       {"min-time", "Run each benchmark for at least about <ms> milliseconds. (default: 500)", "ms",
+                        "500"},
+                       {"output", "Write the results to <file> instead of stdout.", "file"}});
+    parser.process(app);
+
+    bool ok = false;
+    qint64 minTime = parser.value("min-time").toLongLong(&ok);
+    QRegularExpression filter(parser.value("filter"));
+    if (!ok || minTime <= 0 || !filter.isValid())
+    {
+        cerr << "Invalid arguments, see --help for more information.\n";
+        return 1;
+    }
+
+    // the user's settings are not loaded, so the results don't depend on the machine's configuration
+    QStandardPaths::setTestModeEnabled(true);
+    Core::Log::init(0);
+    Core::Log::setLevel(Core::Log::WTF);
+    SettingsManager::init();
+
+    QTemporaryDir dir;
+    if (!dir.isValid())
+    {
+        cerr << "Failed to create a temporary directory.\n";
+        return 1;
+    }
+
+    Bench bench(minTime, filter, cerr);
+    benchCheckers(bench);
+    benchDiff(bench);
+    benchSplitArgument(bench);
+    benchFiles(bench, dir);
+    benchSavedTestCases(bench, dir);
+    benchSettings(bench);
+
+    QJsonObject json;
+    json["version"] = APP_VERSION;
+    json["commit"] = GIT_COMMIT_HASH;
+    json["qt"] = qVersion();
+    json["os"] = QSysInfo::prettyProductName();
+    json["cpu"] = QSysInfo::currentCpuArchitecture();
+    json["minTime"] = minTime;
+    json["benchmarks"] = bench.toJson();
+    auto data = QJsonDocument(json).toJson();
+
+    if (parser.isSet("output"))
+    {
+        if (!Util::saveFile(parser.value("output"), data, "Bench", false))
+        {
+            cerr << "Failed to write the results to " << parser.value("output") << "\n";
+            return 1;
+        }
+    }
+    else
+    {
+        QTextStream(stdout, QIODevice::WriteOnly) << data;
+    }
+
+    return 0;
+}
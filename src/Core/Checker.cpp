@@ -21,13 +21,41 @@
 #include "Core/MessageLogger.hpp"
 #include "Core/Runner.hpp"
 #include "Util/FileUtil.hpp"
+#include <QCoreApplication>
+#include <QDir>
 #include <QFile>
+#include <QHash>
+#include <QPointer>
 #include <QTemporaryDir>
 #include <generated/SettingsHelper.hpp>
 
 namespace Core
 {
 
+namespace
+{
+// a testlib checker compiled once and used by all checkers with the same type and compile command
+struct SharedChecker
+{
+    QString path;                               // the path to the source code, the executable is next to it
+    bool compiled = false;                      // whether it's compiled successfully
+    Compiler *compiler = nullptr;               // the running compilation, nullptr if it's not compiling
+    QVector<QPointer<Checker>> waitingCheckers; // the checkers waiting for the compilation
+};
+
+QHash<QString, SharedChecker> sharedCheckers; // the key is the type and the compile command
+QTemporaryDir *sharedDir = nullptr;           // the directory of the shared checkers, removed when the app quits
+
+void cleanUpSharedCheckers()
+{
+    for (auto &shared : sharedCheckers)
+        delete shared.compiler;
+    sharedCheckers.clear();
+    delete sharedDir;
+    sharedDir = nullptr;
+}
+} // namespace
+
 Checker::Checker(CheckerType type, MessageLogger *logger, QObject *parent) : QObject(parent)
 {
     LOG_INFO("Checker of type " << type << "created");
@@ -67,43 +95,12 @@ void Checker::prepare(const QString &compileCommand)
         LOG_INFO("Compiling checker with command " << compileCommand);
         // compile the checker if it's not compiled
 
-        QString checkerResource;
-
-        // get the checker resource
-        switch (checkerType)
+        if (checkerType == IgnoreTrailingSpaces || checkerType == Strict)
         {
-        case IgnoreTrailingSpaces:
-        case Strict:
             onCompilationFinished(); // terminate compilation if this is a built-in checker
             return;
-        case Ncmp:
-            checkerResource = ":/testlib/checkers/ncmp.cpp";
-            break;
-        case Rcmp4:
-            checkerResource = ":/testlib/checkers/rcmp4.cpp";
-            break;
-        case Rcmp6:
-            checkerResource = ":/testlib/checkers/rcmp6.cpp";
-            break;
-        case Rcmp9:
-            checkerResource = ":/testlib/checkers/rcmp9.cpp";
-            break;
-        case Wcmp:
-            checkerResource = ":/testlib/checkers/wcmp.cpp";
-            break;
-        case Nyesno:
-            checkerResource = ":/testlib/checkers/nyesno.cpp";
-            break;
-        case Custom:
-            checkerResource = checkerPath;
-            break;
         }
 
-        // get the code of the checker
-        QString checkerCode = Util::readFile(checkerResource, "Read Checker", log);
-        if (checkerCode.isNull())
-            return;
-
         // create a temporary directory
         tmpDir = new QTemporaryDir();
         if (!tmpDir->isValid())
@@ -112,6 +109,18 @@ void Checker::prepare(const QString &compileCommand)
             return;
         }
 
+        if (checkerType != Custom)
+        {
+            // the testlib checkers are not changed by the user, so they are compiled only once
+            compileShared(checkerType, compileCommand, this);
+            return;
+        }
+
+        // get the code of the checker
+        QString checkerCode = Util::readFile(checkerPath, "Read Checker", log);
+        if (checkerCode.isNull())
+            return;
+
         // save the checker source file on the disk
         checkerPath = tmpDir->filePath("checker.cpp");
         if (!Util::saveFile(checkerPath, checkerCode, "Checker", false, log))
@@ -143,6 +152,14 @@ void Checker::reqeustCheck(int index, const QString &input, const QString &outpu
         pendingTasks.push_back({index, input, output, expected}); // otherwise push it into the pending tasks list
 }
 
+void Checker::prebuild(CheckerType type, const QString &compileCommand)
+{
+    if (type == IgnoreTrailingSpaces || type == Strict || type == Custom)
+        return;
+    LOG_INFO("Prebuilding checker of type " << type << " with command " << compileCommand);
+    compileShared(type, compileCommand, nullptr);
+}
+
 void Checker::onCompilationFinished()
 {
     compiled = true; // mark that the checker is compiled
@@ -154,6 +171,9 @@ void Checker::onCompilationFinished()
 void Checker::onCompilationErrorOccurred(const QString &error)
 {
     log->error("Checker", "Error occurred while compiling the checker:\n" + error);
+    for (auto t : pendingTasks)
+        emit checkFinished(t.index, UNKNOWN); // the pending tasks can't be checked
+    pendingTasks.clear();
 }
 
 void Checker::onCompilationKilled()
@@ -191,17 +211,20 @@ void Checker::onRunFinished(int index, const QString &out, const QString &err, i
                    "Checker exited with unknown exit code " + QString::number(exitCode));
         if (!err.isEmpty())
             log->error(QString("Checker[%1]").arg(index + 1), err);
+        emit checkFinished(index, UNKNOWN);
     }
 }
 
 void Checker::onFailedToStartRun(int index, const QString &error)
 {
     log->error(QString("Checker[%1]").arg(index + 1), error);
+    emit checkFinished(index, UNKNOWN);
 }
 
 void Checker::onRunTimeout(int index)
 {
     log->warn(QString("Checker[%1]").arg(index + 1), "Time Limit Exceeded");
+    emit checkFinished(index, UNKNOWN);
 }
 
 void Checker::onRunOutputLimitExceeded(int index, const QString &type)
@@ -311,4 +334,134 @@ void Checker::check(int index, const QString &input, const QString &output, cons
     }
 }
 
+QString Checker::resourcePath(CheckerType type)
+{
+    switch (type)
+    {
+    case Ncmp:
+        return ":/testlib/checkers/ncmp.cpp";
+    case Rcmp4:
+        return ":/testlib/checkers/rcmp4.cpp";
+    case Rcmp6:
+        return ":/testlib/checkers/rcmp6.cpp";
+    case Rcmp9:
+        return ":/testlib/checkers/rcmp9.cpp";
+    case Wcmp:
+        return ":/testlib/checkers/wcmp.cpp";
+    case Nyesno:
+        return ":/testlib/checkers/nyesno.cpp";
+    default:
+        return QString();
+    }
+}
+
+void Checker::compileShared(CheckerType type, const QString &compileCommand, Checker *waiting)
+{
+    auto key = QString::number(type) + ' ' + compileCommand;
+    bool isNew = !sharedCheckers.contains(key);
+    auto &shared = sharedCheckers[key];
+
+    if (shared.compiled)
+    {
+        if (waiting)
+        {
+            waiting->checkerPath = shared.path;
+            waiting->onCompilationFinished();
+        }
+        return;
+    }
+
+    if (waiting)
+        shared.waitingCheckers.push_back(waiting);
+
+    if (shared.compiler)
+        return; // it's being compiled, the waiting checker is notified when it's finished
+
+    MessageLogger *log = waiting ? waiting->log : nullptr;
+
+    if (sharedDir == nullptr)
+    {
+        sharedDir = new QTemporaryDir();
+        qAddPostRoutine(cleanUpSharedCheckers);
+    }
+    if (!sharedDir->isValid())
+    {
+        auto waitingCheckers = shared.waitingCheckers;
+        shared.waitingCheckers.clear();
+        failWaitingCheckers(waitingCheckers, "Failed to create temporary directory");
+        return;
+    }
+
+    if (isNew)
+    {
+        // each shared checker has its own directory, so the executables don't overwrite each other
+        QDir dir(sharedDir->filePath(QString::number(sharedCheckers.size())));
+        dir.mkpath(".");
+        shared.path = dir.filePath("checker.cpp");
+
+        auto checkerCode = Util::readFile(resourcePath(type), "Read Checker", log);
+        auto testlib_h = Util::readFile(":/testlib/testlib.h", "Read testlib.h", log);
+        if (checkerCode.isNull() || testlib_h.isNull() ||
+            !Util::saveFile(shared.path, checkerCode, "Checker", false, log) ||
+            !Util::saveFile(dir.filePath("testlib.h"), testlib_h, "Save testlib.h", false, log))
+        {
+            failWaitingCheckers(sharedCheckers.take(key).waitingCheckers,
+                                "Failed to write the checker and testlib.h into the temporary directory");
+            return;
+        }
+    }
+
+    shared.compiler = new Compiler();
+    QObject::connect(shared.compiler, &Compiler::compilationFinished,
+                     [key] { onSharedCompilationFinished(key, true, QString()); });
+    QObject::connect(shared.compiler, &Compiler::compilationErrorOccurred,
+                     [key](const QString &error) { onSharedCompilationFinished(key, false, error); });
+    QObject::connect(shared.compiler, &Compiler::compilationKilled,
+                     [key] { onSharedCompilationFinished(key, false, QString()); });
+    shared.compiler->start(shared.path, "", compileCommand, "C++");
+}
+
+void Checker::failWaitingCheckers(const QVector<QPointer<Checker>> &waitingCheckers, const QString &error)
+{
+    // the pending tasks of the waiting checkers are finished as UNKNOWN, instead of waiting forever
+    for (const auto &checker : waitingCheckers)
+    {
+        if (!checker.isNull())
+            checker->onCompilationErrorOccurred(error);
+    }
+}
+
+void Checker::onSharedCompilationFinished(const QString &key, bool succeeded, const QString &error)
+{
+    auto it = sharedCheckers.find(key);
+    if (it == sharedCheckers.end())
+        return;
+
+    LOG_INFO(INFO_OF(key) << BOOL_INFO_OF(succeeded));
+
+    // it's called in a signal of the compiler, so the compiler can't be deleted directly
+    it->compiler->deleteLater();
+    it->compiler = nullptr;
+    it->compiled = succeeded;
+    auto path = it->path;
+    auto waitingCheckers = it->waitingCheckers;
+    it->waitingCheckers.clear();
+
+    // a failed compilation is retried the next time a checker is prepared
+    for (const auto &checker : waitingCheckers)
+    {
+        if (checker.isNull())
+            continue;
+        if (succeeded)
+        {
+            checker->checkerPath = path;
+            checker->onCompilationFinished();
+        }
+        else if (!error.isEmpty())
+        {
+            checker->onCompilationErrorOccurred(error);
+        }
+    }
+}
+
 } // namespace Core
\ No newline at end of file
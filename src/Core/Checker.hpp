@@ -22,13 +22,15 @@
  * The checker should be setup before required to check outputs, and the
  * response is not always immediate.
  * The official testlib checkers are saved in the Qt Resources, and are
- * compiled during the runtime.
+ * compiled during the runtime. A testlib checker is compiled only once for
+ * each compile command, the compiled checker is shared by all checkers.
  */
 
 #ifndef CHECKER_HPP
 #define CHECKER_HPP
 
 #include <QObject>
+#include <QPointer>
 #include <QVector>
 
 class QTemporaryDir;
@@ -112,11 +114,19 @@ class Checker : public QObject
      */
     void reqeustCheck(int index, const QString &input, const QString &output, const QString &expected);
 
+    /**
+     * @brief compile a testlib checker in the background before it's needed
+     * @param type the type of the checker, it does nothing for built-in checkers and custom checkers
+     * @param compileCommand the command used to compile the checker
+     * @note The checkers prepared with the same type and compile command later use the compiled checker directly.
+     */
+    static void prebuild(CheckerType type, const QString &compileCommand);
+
   signals:
     /**
      * @brief return the check result
      * @param index the index of the checked testcase
-     * @param verdict the result of this check
+     * @param verdict the result of this check, UNKNOWN if the checker failed
      */
     void checkFinished(int index, Verdict verdict);
 
@@ -198,6 +208,36 @@ class Checker : public QObject
      */
     void check(int index, const QString &input, const QString &output, const QString &expected);
 
+    /**
+     * @brief get the path to the source code of a checker in the Qt Resources
+     * @param type the type of the checker, it should be a testlib checker
+     */
+    static QString resourcePath(CheckerType type);
+
+    /**
+     * @brief compile a testlib checker which is shared by all checkers with the same compile command
+     * @param type the type of the checker, it should be a testlib checker
+     * @param compileCommand the command used to compile the checker
+     * @param waiting the checker which is notified when the compilation is finished, it can be nullptr
+     * @note If it's already compiled, the waiting checker is notified immediately.
+     */
+    static void compileShared(CheckerType type, const QString &compileCommand, Checker *waiting);
+
+    /**
+     * @brief the compilation of a shared checker is finished
+     * @param key the key of the shared checker
+     * @param succeeded whether the checker is compiled successfully
+     * @param error the error message, empty if the compilation is killed
+     */
+    static void onSharedCompilationFinished(const QString &key, bool succeeded, const QString &error);
+
+    /**
+     * @brief tell the checkers waiting for a shared checker that it can't be compiled
+     * @param waitingCheckers the waiting checkers, they should be removed from the shared checker before this call
+     * @param error the reason of the failure
+     */
+    static void failWaitingCheckers(const QVector<QPointer<Checker>> &waitingCheckers, const QString &error);
+
     // a struct with the info of a testcase, or called a check task, used to save check requests
     struct Task
     {
@@ -206,8 +246,8 @@ class Checker : public QObject
     };
 
     CheckerType checkerType;         // the type of the checker
-    QString checkerPath;             // the file path to the custom checker
-    QTemporaryDir *tmpDir = nullptr; // the temp directory to save the I/O files, testlib.h and the compiled checker
+    QString checkerPath;             // the file path to the source code of the checker
+    QTemporaryDir *tmpDir = nullptr; // the temp directory to save the I/O files, and the custom checker with testlib.h
                                      // It's not needed by built-in checkers
     MessageLogger *log = nullptr;    // the message logger to show messages to the user
     Compiler *compiler = nullptr;    // the compiler used to compile the checker
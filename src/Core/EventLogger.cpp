@@ -16,31 +16,263 @@
  */
 
 #include "Core/EventLogger.hpp"
+#include <QCoreApplication>
+#include <QDataStream>
 #include <QDateTime>
 #include <QDesktopServices>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QHash>
 #include <QProcess>
+#include <QSemaphore>
 #include <QStandardPaths>
 #include <QSysInfo>
+#include <QThread>
 #include <QUrl>
 #include <generated/version.hpp>
+#include <cstdio>
 
 namespace Core
 {
 
-QFile Log::logFile;
-QTextStream Log::logStream;
+namespace
+{
+// a log in the queue, the strings of the source location are literals so they are not copied
+struct Record
+{
+    std::atomic<Record *> next{nullptr};
+    Log::Level level;
+    const char *function;
+    int line;
+    const char *file;
+    qint64 time;
+    QString message;
+};
+
+// Dmitry Vyukov's intrusive multiple-producer single-consumer queue, a push is a single atomic exchange
+class RecordQueue
+{
+  public:
+    RecordQueue() : head(&stub), tail(&stub)
+    {
+    }
+
+    void push(Record *record)
+    {
+        record->next.store(nullptr, std::memory_order_relaxed);
+        auto prev = head.exchange(record, std::memory_order_acq_rel);
+        prev->next.store(record, std::memory_order_release);
+    }
+
+    // only called by the consumer, returns nullptr if the queue is empty or the next push is not finished
+    Record *pop()
+    {
+        auto first = tail;
+        auto next = first->next.load(std::memory_order_acquire);
+        if (first == &stub)
+        {
+            if (next == nullptr)
+                return nullptr;
+            tail = first = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next != nullptr)
+        {
+            tail = next;
+            return first;
+        }
+        if (first != head.load(std::memory_order_acquire))
+            return nullptr;
+        push(&stub);
+        next = first->next.load(std::memory_order_acquire);
+        if (next != nullptr)
+        {
+            tail = next;
+            return first;
+        }
+        return nullptr;
+    }
+
+  private:
+    std::atomic<Record *> head;
+    Record *tail;
+    Record stub;
+};
+
+const char BINARY_MAGIC[] = "CPLOG\x01";
+const int BINARY_MAGIC_SIZE = 6;
+
+enum BinaryTag : quint8
+{
+    LocationTag = 0, // defines a source location: quint32 ID, QByteArray function, QByteArray file, qint32 line
+    RecordTag = 1,   // a log: quint32 location ID, quint8 level, qint64 time, QByteArray message in UTF-8
+};
+
+RecordQueue queue;
+QFile logFile;                                    // the log file or stderr, only used by the writer after init()
+QTextStream logStream;                            // writes to logFile in the text format
+QDataStream binaryStream;                         // writes to logFile in the binary format
+bool binaryFormat = false;                        // whether the logs are written in the binary format
+QHash<QPair<quintptr, int>, quint32> locationIDs; // the IDs of the source locations in the binary format
+std::atomic<bool> running{false};                 // whether the logs are pushed into the queue
+std::atomic<bool> stopRequested{false};           // whether the writer should stop after draining the queue
+std::atomic<bool> writerWaiting{false};           // whether the writer may be waiting for wakeUp
+QSemaphore wakeUp;                                // released to wake up the writer when it's waiting
+
+QString levelName(int level)
+{
+    switch (level)
+    {
+    case Log::WTF:
+        return " WTF ";
+    case Log::ERR:
+        return "ERROR";
+    case Log::WARN:
+        return "WARN ";
+    default:
+        return "INFO ";
+    }
+}
+
+void writeText(QTextStream &stream, qint64 time, int level, QString function, int line, QString file,
+               const QString &message, int maxFunctionSize, int maxFileSize)
+{
+    if (function.size() > maxFunctionSize)
+        function = function.right(maxFunctionSize);
+    file = file.mid(qMax(file.lastIndexOf('/'), file.lastIndexOf('\\')) + 1);
+    if (file.size() > maxFileSize)
+        file = file.right(maxFileSize);
+
+    stream << "[" << QDateTime::fromMSecsSinceEpoch(time).toString(Qt::ISODateWithMs) << "]" << center << "["
+           << levelName(level) << "][" << qSetFieldWidth(maxFunctionSize) << function << qSetFieldWidth(0) << "]["
+           << qSetFieldWidth(maxFileSize) << file << qSetFieldWidth(0) << left << "]"
+           << "(" << line << ")::" << message << "\n";
+}
+
+void writeBinary(const Record *record)
+{
+    auto key = qMakePair(reinterpret_cast<quintptr>(record->function), record->line);
+    auto it = locationIDs.find(key);
+    if (it == locationIDs.end())
+    {
+        it = locationIDs.insert(key, locationIDs.size());
+        binaryStream << quint8(LocationTag) << it.value() << QByteArray(record->function)
+                     << QByteArray(record->file) << qint32(record->line);
+    }
+    binaryStream << quint8(RecordTag) << it.value() << quint8(record->level) << record->time
+                 << record->message.toUtf8();
+}
+
+// drains the queue in the background, so the logging threads never wait for the disk
+class LogWriter : public QThread
+{
+  public:
+    LogWriter(int maxFunctionSize, int maxFileSize) : maxFunctionSize(maxFunctionSize), maxFileSize(maxFileSize)
+    {
+    }
+
+    // returns whether any log is written
+    bool drain()
+    {
+        bool written = false;
+        while (auto record = queue.pop())
+        {
+            if (binaryFormat)
+                writeBinary(record);
+            else
+                writeText(logStream, record->time, record->level, record->function, record->line, record->file,
+                          record->message, maxFunctionSize, maxFileSize);
+            delete record;
+            written = true;
+        }
+        if (written)
+        {
+            logStream.flush();
+            logFile.flush();
+        }
+        return written;
+    }
+
+  protected:
+    void run() override
+    {
+        while (true)
+        {
+            bool stopping = stopRequested.load(std::memory_order_acquire);
+            drain();
+            if (stopping)
+                break;
+
+            // the queue is drained again after announcing the wait, so a log pushed meanwhile either is written here
+            // or sees writerWaiting and releases wakeUp
+            writerWaiting.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!drain() && !stopRequested.load(std::memory_order_acquire))
+                wakeUp.acquire();
+            writerWaiting.store(false);
+        }
+    }
+
+  private:
+    int maxFunctionSize, maxFileSize;
+};
+
+LogWriter *writer = nullptr;
+} // namespace
+
+std::atomic<int> Log::minimumLevel{Log::INFO};
 
 int Log::NUMBER_OF_LOGS_TO_KEEP = 50;
 int Log::MAXIMUM_FUNCTION_NAME_SIZE = 30;
 int Log::MAXIMUM_FILE_NAME_SIZE = 20;
+int Log::MAXIMUM_MESSAGE_SIZE = 4096;
 QString Log::LOG_DIR_NAME = "cpeditorLogFiles";
 QString Log::LOG_FILE_NAME = "cpeditor";
 
-void Log::init(int instance, bool dumptoStderr)
+Log::Entry::Entry(Level level, const char *function, int line, const char *file)
+    : level(level), function(function), line(line), file(file), time(QDateTime::currentMSecsSinceEpoch())
+{
+    textStream.setString(&message, QIODevice::WriteOnly);
+}
+
+Log::Entry::~Entry()
+{
+    textStream.flush();
+    // some logs contain whole testcases, they are truncated so that writing the logs is never the bottleneck
+    if (message.size() > MAXIMUM_MESSAGE_SIZE)
+    {
+        int more = message.size() - MAXIMUM_MESSAGE_SIZE;
+        message.truncate(MAXIMUM_MESSAGE_SIZE);
+        message += QString("... (%1 more characters)").arg(more);
+    }
+
+    if (running.load(std::memory_order_acquire))
+    {
+        queue.push(new Record{{nullptr}, level, function, line, file, time, message});
+        // only wake up the writer if it's waiting, so that a burst of logs costs a single wake-up
+        if (writerWaiting.exchange(false))
+            wakeUp.release();
+    }
+    else
+    {
+        // before init() or after deinit(), there is only the main thread
+        QString text;
+        QTextStream stream(&text);
+        writeText(stream, time, level, function, line, file, message, MAXIMUM_FUNCTION_NAME_SIZE,
+                  MAXIMUM_FILE_NAME_SIZE);
+        stream.flush();
+        fputs(text.toLocal8Bit().constData(), stderr);
+    }
+}
+
+QTextStream &Log::Entry::stream()
+{
+    return textStream;
+}
+
+void Log::init(int instance, bool dumptoStderr, bool binary)
 {
-    logStream.setDevice(&logFile);
     if (!dumptoStderr)
     {
         // get the path to the log file
@@ -52,33 +284,109 @@ void Log::init(int instance, bool dumptoStderr)
         if (dir.cd(LOG_DIR_NAME))
         {
             // keep NUMBER_OF_LOGS_TO_KEEP log files
-            auto entries = dir.entryList({LOG_FILE_NAME + "*.log"}, QDir::Files, QDir::Time);
+            auto entries =
+                dir.entryList({LOG_FILE_NAME + "*.log", LOG_FILE_NAME + "*.cplog"}, QDir::Files, QDir::Time);
             for (int i = NUMBER_OF_LOGS_TO_KEEP; i < entries.length(); ++i)
                 dir.remove(entries[i]);
 
             // open the log file
             logFile.setFileName(dir.filePath(LOG_FILE_NAME +
                                              QDateTime::currentDateTime().toString("-yyyy-MM-dd-hh-mm-ss-zzz-") +
-                                             QString::number(instance) + ".log"));
-            logFile.open(QIODevice::WriteOnly | QFile::Text);
+                                             QString::number(instance) + (binary ? ".cplog" : ".log")));
+            logFile.open(binary ? QIODevice::WriteOnly : QIODevice::WriteOnly | QFile::Text);
             LOG_ERR_IF(!logFile.isOpen() || !logFile.isWritable(), "Failed to open file" << logFile.fileName());
+            binaryFormat = binary && logFile.isOpen();
         }
         else
         {
             LOG_ERR("Failed to open directory" << dir.filePath(LOG_DIR_NAME));
         }
     }
-    else
-    {
-        logFile.open(stderr, QIODevice::WriteOnly);
-    }
+    if (!logFile.isOpen() || !logFile.isWritable())
+        logFile.open(stderr, QIODevice::WriteOnly); // dump to stderr if failed to open log file
+
+    logStream.setDevice(&logFile);
+    binaryStream.setDevice(&logFile);
+    binaryStream.setVersion(QDataStream::Qt_5_12);
+    if (binaryFormat)
+        logFile.write(BINARY_MAGIC, BINARY_MAGIC_SIZE);
+
+    writer = new LogWriter(MAXIMUM_FUNCTION_NAME_SIZE, MAXIMUM_FILE_NAME_SIZE);
+    running.store(true, std::memory_order_release);
+    writer->start(QThread::LowPriority);
+    qAddPostRoutine(deinit);
+
     LOG_INFO("Event logger has been initialized successfully");
     platformInformation();
 }
 
-QString Log::dateTimeStamp()
+void Log::deinit()
 {
-    return "[" + QDateTime::currentDateTime().toString(Qt::ISODateWithMs) + "]";
+    if (writer == nullptr)
+        return;
+    // the logs pushed by other threads after this are lost, there should be no other threads when quitting
+    running.store(false, std::memory_order_release);
+    stopRequested.store(true, std::memory_order_release);
+    wakeUp.release();
+    writer->wait();
+    writer->drain();
+    delete writer;
+    writer = nullptr;
+}
+
+void Log::setLevel(Level level)
+{
+    minimumLevel.store(level, std::memory_order_relaxed);
+}
+
+bool Log::decode(QIODevice *input, QTextStream &output)
+{
+    if (input->read(BINARY_MAGIC_SIZE) != QByteArray(BINARY_MAGIC, BINARY_MAGIC_SIZE))
+        return false;
+
+    struct Location
+    {
+        QString function, file;
+        int line = 0;
+    };
+    QHash<quint32, Location> locations;
+
+    QDataStream stream(input);
+    stream.setVersion(QDataStream::Qt_5_12);
+    while (!stream.atEnd())
+    {
+        quint8 tag;
+        quint32 id;
+        stream >> tag >> id;
+        if (tag == LocationTag)
+        {
+            QByteArray function, file;
+            qint32 line;
+            stream >> function >> file >> line;
+            if (stream.status() == QDataStream::Ok)
+                locations[id] = {QString::fromUtf8(function), QString::fromUtf8(file), line};
+        }
+        else if (tag == RecordTag)
+        {
+            quint8 level;
+            qint64 time;
+            QByteArray message;
+            stream >> level >> time >> message;
+            if (stream.status() == QDataStream::Ok)
+            {
+                auto location = locations.value(id);
+                writeText(output, time, level, location.function, location.line, location.file,
+                          QString::fromUtf8(message), MAXIMUM_FUNCTION_NAME_SIZE, MAXIMUM_FILE_NAME_SIZE);
+            }
+        }
+        else
+        {
+            return false;
+        }
+        if (stream.status() != QDataStream::Ok)
+            break; // the last log is not completely written
+    }
+    return true;
 }
 
 void Log::platformInformation()
@@ -102,25 +410,6 @@ void Log::platformInformation()
     LOG_INFO(INFO_OF(__TIME__));
 }
 
-QTextStream &Log::log(const QString &priority, QString funcName, int line, QString fileName)
-{
-    if (!logFile.isOpen() || !logFile.isWritable())
-        logFile.open(stderr, QIODevice::WriteOnly); // dump to stderr if failed to open log file
-    if (funcName.size() > MAXIMUM_FUNCTION_NAME_SIZE)
-        funcName = funcName.right(MAXIMUM_FUNCTION_NAME_SIZE);
-
-    QFileInfo info(fileName);
-    fileName = info.fileName();
-
-    if (fileName.size() > MAXIMUM_FILE_NAME_SIZE)
-        fileName = fileName.right(MAXIMUM_FILE_NAME_SIZE);
-
-    return logStream << dateTimeStamp() << center << "[" << priority << "]["
-                     << qSetFieldWidth(MAXIMUM_FUNCTION_NAME_SIZE) << funcName << qSetFieldWidth(0) << "]["
-                     << qSetFieldWidth(MAXIMUM_FILE_NAME_SIZE) << fileName << qSetFieldWidth(0) << left << "]"
-                     << "(" << line << ")::";
-}
-
 void Log::revealInFileManager()
 {
     // Reference: http://lynxline.com/show-in-finder-show-in-explorer/ and https://forum.qt.io/post/296072
@@ -205,7 +494,7 @@ void Log::clearOldLogs()
     QDir dir(path);
     if (dir.cd(LOG_DIR_NAME))
     {
-        auto entries = dir.entryList({LOG_FILE_NAME + "*.log"}, QDir::Files);
+        auto entries = dir.entryList({LOG_FILE_NAME + "*.log", LOG_FILE_NAME + "*.cplog"}, QDir::Files);
         for (auto const &e : entries)
         {
             if (e != logFile.fileName()) // clear all except the current
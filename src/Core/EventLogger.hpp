@@ -18,14 +18,20 @@
 /*
  * The event logger is used for logging events of the editor.
  * The logs can helps the maintainers find the bug.
+ *
+ * Logging is cheap for the calling thread: a log is formatted into a string and pushed into a lock-free queue,
+ * and a background thread formats the time and the source location and writes the logs into the file.
+ * It's safe to log in any thread.
  */
 
 #ifndef EVENTLOGGER_HPP
 #define EVENTLOGGER_HPP
 
+#include <QString>
 #include <QTextStream>
+#include <atomic>
 
-class QFile;
+class QIODevice;
 
 /**
  * There are four log levels:
@@ -43,27 +49,39 @@ class QFile;
 // WARN: Level 2
 // INFO: Level 1
 
-#define LOG_WTF(stream) Core::Log::log(" WTF ", __func__, __LINE__, __FILE__) << stream << endl;
-#define LOG_ERR(stream) Core::Log::log("ERROR", __func__, __LINE__, __FILE__) << stream << endl;
-#define LOG_WARN(stream) Core::Log::log("WARN ", __func__, __LINE__, __FILE__) << stream << endl;
-#define LOG_INFO(stream) Core::Log::log("INFO ", __func__, __LINE__, __FILE__) << stream << endl;
+// The logs below this level are not compiled, and the arguments of them are not evaluated.
+#ifndef CPEDITOR_MIN_LOG_LEVEL
+#define CPEDITOR_MIN_LOG_LEVEL 1
+#endif
+
+#define LOG_AT_LEVEL(level, stream)                                                                                    \
+    if (Core::Log::isEnabled(level))                                                                                   \
+    {                                                                                                                  \
+        Core::Log::Entry logEntry(level, __func__, __LINE__, __FILE__);                                                \
+        logEntry.stream() << stream;                                                                                   \
+    }
+
+#define LOG_WTF(stream) LOG_AT_LEVEL(Core::Log::WTF, stream)
+#define LOG_ERR(stream) LOG_AT_LEVEL(Core::Log::ERR, stream)
+#define LOG_WARN(stream) LOG_AT_LEVEL(Core::Log::WARN, stream)
+#define LOG_INFO(stream) LOG_AT_LEVEL(Core::Log::INFO, stream)
 
 #define LOG_INFO_IF(cond, stream)                                                                                      \
     if (cond)                                                                                                          \
     {                                                                                                                  \
-        Core::Log::log("INFO ", __func__, __LINE__, __FILE__) << stream << endl;                                       \
+        LOG_INFO(stream)                                                                                               \
     }
 
 #define LOG_WARN_IF(cond, stream)                                                                                      \
     if (cond)                                                                                                          \
     {                                                                                                                  \
-        Core::Log::log("WARN ", __func__, __LINE__, __FILE__) << stream << endl;                                       \
+        LOG_WARN(stream)                                                                                               \
     }
 
 #define LOG_ERR_IF(cond, stream)                                                                                       \
     if (cond)                                                                                                          \
     {                                                                                                                  \
-        Core::Log::log("ERROR", __func__, __LINE__, __FILE__) << stream << endl;                                       \
+        LOG_ERR(stream)                                                                                                \
     }
 
 #define INFO_OF(variable) "<" #variable ">: [" << (variable) << "], "
@@ -74,13 +92,66 @@ namespace Core
 class Log
 {
   public:
+    enum Level
+    {
+        INFO = 1,
+        WARN = 2,
+        ERR = 3,
+        WTF = 4
+    };
+
+    // a log being written by a LOG_* macro, it's pushed into the queue when it's destructed
+    class Entry
+    {
+      public:
+        Entry(Level level, const char *function, int line, const char *file);
+        ~Entry();
+
+        QTextStream &stream();
+
+      private:
+        Level level;
+        const char *function;
+        int line;
+        const char *file;
+        qint64 time;
+        QString message;
+        QTextStream textStream;
+    };
+
     /**
      * @brief initialize the event logger
      * @param instanceCount the instance ID provided by SingleApplication, to distinct processes from each other
      * @param dumpToStderr whether to print the logs into stderr or not
-     * @note this should be called only once before logging anything
+     * @param binary whether to write the logs in the compact binary format, which can be read by decode()
+     * @note this should be called only once before logging anything, the logs before it are written into stderr
+     */
+    static void init(int instanceCount, bool dumpToStderr = false, bool binary = false);
+
+    /**
+     * @brief stop the background thread after writing all logs in the queue
+     * @note it's called automatically when the application quits, the logs after it are written into stderr
      */
-    static void init(int instanceCount, bool dumpToStderr = false);
+    static void deinit();
+
+    /**
+     * @brief set the minimum level of the logs to write at runtime
+     * @note the logs below CPEDITOR_MIN_LOG_LEVEL are never written
+     */
+    static void setLevel(Level level);
+
+    static bool isEnabled(Level level)
+    {
+        return level >= CPEDITOR_MIN_LOG_LEVEL && level >= minimumLevel.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief convert a log file in the binary format to text
+     * @param input the binary log file
+     * @param output the text logs are written into it
+     * @returns whether the input is a valid binary log file, it may be truncated at the end
+     */
+    static bool decode(QIODevice *input, QTextStream &output);
 
     /**
      * @brief clear old logs
@@ -93,20 +164,17 @@ class Log
      */
     static void revealInFileManager();
 
-    static QTextStream &log(const QString &priority, QString funcName, int lineNumber, QString fileName);
-
   private:
-    static QString dateTimeStamp();
     static void platformInformation();
 
-    static QTextStream logStream; // the text stream for logging, writes to logFile
-    static QFile logFile;         // the device for logging, a file or stderr
+    static std::atomic<int> minimumLevel; // the minimum level of the logs to write
 
     static int NUMBER_OF_LOGS_TO_KEEP;     // Number of log files to keep in Temporary directory
     static QString LOG_FILE_NAME;          // Base Name of the log file
     static QString LOG_DIR_NAME;           // Directory inside Temp where log files will be stored
     static int MAXIMUM_FUNCTION_NAME_SIZE; // Maximum size of function name, it is used to determine spacing in log file
     static int MAXIMUM_FILE_NAME_SIZE;     // Maximum size of file name, it is used to determine spacing in log file
+    static int MAXIMUM_MESSAGE_SIZE;       // Maximum size of a message, the rest of it is truncated
 };
 
 } // namespace Core
@@ -0,0 +1,484 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+#include "Core/Judge.hpp"
+#include "Core/Compiler.hpp"
+#include "Core/EventLogger.hpp"
+#include "Core/MessageLogger.hpp"
+#include "Core/Runner.hpp"
+#include "Core/TestCaseArchive.hpp"
+#include "Settings/SettingsManager.hpp"
+#include "Util/FileUtil.hpp"
+#include "Util/LineDiff.hpp"
+#include "Widgets/TestCases.hpp"
+#include <QCollator>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QRegularExpression>
+#include <QSet>
+#include <QTemporaryDir>
+#include <generated/SettingsHelper.hpp>
+
+namespace Core
+{
+
+Judge::Judge(const QString &sourcePath, const QString &lang, Checker::CheckerType checkerType,
+             const QString &checkerPath, int jobs, QObject *parent)
+    : QObject(parent), sourcePath(sourcePath), lang(lang), jobs(qMax(1, jobs))
+{
+    timeLimit = SettingsHelper::getTimeLimit();
+
+    // the messages of the checker are not shown, a WA is described by the first different token instead
+    log = new MessageLogger();
+    if (checkerType == Checker::Custom)
+        checker = new Checker(checkerPath, log, this);
+    else
+        checker = new Checker(checkerType, log, this);
+    connect(checker, &Checker::checkFinished, this, &Judge::onCheckFinished);
+}
+
+Judge::~Judge()
+{
+    for (auto runner : runners)
+        delete runner;
+    delete checker; // the checker uses log, so it should be deleted before log
+    if (compiler != nullptr)
+        delete compiler;
+    if (tmpDir != nullptr)
+        delete tmpDir;
+    delete log;
+}
+
+void Judge::start(const QVector<TestCase> &testcases)
+{
+    LOG_INFO(INFO_OF(sourcePath) << INFO_OF(lang) << INFO_OF(testcases.size()) << INFO_OF(jobs));
+
+    tests = testcases;
+    results = QVector<Result>(tests.size());
+
+    // the testlib checker is compiled at the same time as the solution
+    checker->prepare(SettingsManager::get("C++/Compile Command").toString());
+
+    // the solution is copied into a temporary directory like an untitled tab, so nothing is written next to it
+    tmpDir = new QTemporaryDir();
+    auto code = Util::readFile(sourcePath, "Judge");
+    if (!tmpDir->isValid() || code.isNull())
+    {
+        onCompilationErrorOccurred("Failed to copy the source file into a temporary directory");
+        return;
+    }
+    tmpFilePath = tmpDir->filePath(lang == "Python" ? "sol.py" : lang == "Java" ? "sol.java" : "sol.cpp");
+    if (!Util::saveFile(tmpFilePath, code, "Judge", false))
+    {
+        onCompilationErrorOccurred("Failed to copy the source file into a temporary directory");
+        return;
+    }
+
+    compiler = new Compiler();
+    connect(compiler, SIGNAL(compilationFinished(const QString &)), this, SLOT(onCompilationFinished()));
+    connect(compiler, SIGNAL(compilationErrorOccurred(const QString &)), this,
+            SLOT(onCompilationErrorOccurred(const QString &)));
+    compiler->start(tmpFilePath, sourcePath, SettingsManager::get(lang + "/Compile Command").toString(), lang);
+}
+
+QVector<Judge::TestCase> Judge::findTestCases(const QString &sourcePath, const QString &path)
+{
+    QVector<TestCase> res;
+
+    if (path.isEmpty() && SettingsHelper::isSaveTestcasesInArchive())
+    {
+        // the testcases saved by the editor in an archive, or in separate files if the archive isn't saved yet
+        auto archivePath = Widgets::TestCases::archiveFilePath(sourcePath);
+        if (QFile::exists(archivePath))
+            return findArchivedTestCases(archivePath);
+    }
+
+    if (QFileInfo(path).isFile())
+        return findArchivedTestCases(path);
+
+    if (path.isEmpty())
+    {
+        // the testcases saved by the editor when the file is saved
+        for (int i = 0;; ++i)
+        {
+            auto inputPath = Widgets::TestCases::inputFilePath(sourcePath, i);
+            auto answerPath = Widgets::TestCases::answerFilePath(sourcePath, i);
+            if (!QFile::exists(inputPath) || !QFile::exists(answerPath))
+                break;
+            res.push_back(
+                {QFileInfo(inputPath).fileName(), Util::readFile(inputPath), Util::readFile(answerPath)});
+        }
+        return res;
+    }
+
+    QStringList paths;
+    QDirIterator it(path, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext())
+        paths.push_back(it.next());
+
+    QCollator collator;
+    collator.setNumericMode(true);
+    std::sort(paths.begin(), paths.end(), collator);
+    QSet<QString> remain;
+    for (const auto &path : paths)
+        remain.insert(path);
+
+    // paired like "Add Pairs of Testcases From Directory", an answer is only matched in the directory of its input
+    for (const auto &rule : SettingsHelper::getTestcasesMatchingRules())
+    {
+        auto list = rule.toStringList();
+        QRegularExpression regex("^" + list.front() + "$");
+        for (const auto &inputPath : paths)
+        {
+            QFileInfo inputInfo(inputPath);
+            if (!remain.contains(inputPath) || !regex.match(inputInfo.fileName()).hasMatch())
+                continue;
+            auto answerPath = inputInfo.dir().filePath(inputInfo.fileName().replace(regex, list.back()));
+            if (answerPath == inputPath || !remain.contains(answerPath))
+                continue;
+            remain.remove(inputPath);
+            remain.remove(answerPath);
+            res.push_back({QDir(path).relativeFilePath(inputPath), Util::readFile(inputPath),
+                           Util::readFile(answerPath)});
+        }
+    }
+
+    std::sort(res.begin(), res.end(),
+              [&collator](const TestCase &a, const TestCase &b) { return collator.compare(a.name, b.name) < 0; });
+    return res;
+}
+
+QVector<Judge::TestCase> Judge::findArchivedTestCases(const QString &archivePath)
+{
+    QVector<TestCase> res;
+    TestCaseArchive archive(archivePath);
+    if (!archive.open())
+    {
+        LOG_ERR(archive.errorString());
+        return res;
+    }
+    auto fileName = QFileInfo(archivePath).fileName();
+    for (int i = 0; i < archive.count(); ++i)
+        res.push_back({QString("%1 #%2").arg(fileName).arg(i + 1), QString(), QString(), archivePath, i});
+    return res;
+}
+
+QString Judge::verdictName(Verdict verdict)
+{
+    switch (verdict)
+    {
+    case Pending:
+        return "--";
+    case AC:
+        return "AC";
+    case WA:
+        return "WA";
+    case TLE:
+        return "TLE";
+    case RE:
+        return "RE";
+    case OLE:
+        return "OLE";
+    case FAIL:
+        return "FAIL";
+    case CE:
+        return "CE";
+    }
+    return QString();
+}
+
+Judge::Verdict Judge::verdict() const
+{
+    if (compilationFailed)
+        return CE;
+    for (const auto &result : results)
+    {
+        if (result.verdict != AC)
+            return result.verdict;
+    }
+    return AC;
+}
+
+QString Judge::toTable() const
+{
+    QString res;
+
+    if (compilationFailed)
+        return "Compilation Error\n" + compilationMessage + "\n";
+
+    res += QString("%1  %2  %3  %4  %5\n")
+               .arg("#", 4)
+               .arg("Verdict", -7)
+               .arg("Time", 8)
+               .arg("Memory", 10)
+               .arg("Test");
+
+    int accepted = 0;
+    for (int i = 0; i < results.size(); ++i)
+    {
+        const auto &result = results[i];
+        if (result.verdict == AC)
+            ++accepted;
+        res += QString("%1  %2  %3  %4  %5\n")
+                   .arg(i + 1, 4)
+                   .arg(verdictName(result.verdict), -7)
+                   .arg(result.time == -1 ? QString("-") : QString("%1 ms").arg(result.time), 8)
+                   .arg(result.memory == -1 ? QString("-") : QString("~%1 MiB").arg(result.memory / 1024.0, 0, 'f', 1),
+                        10)
+                   .arg(tests[i].name);
+        if (!result.message.isEmpty())
+            res += QString(" ").repeated(6) + result.message.split('\n').front() + "\n";
+    }
+
+    res += "\nThe memory is sampled while running, so it's approximate and may miss the peak of a short run.\n";
+    res += QString("%1: %2/%3 accepted\n").arg(verdictName(verdict())).arg(accepted).arg(results.size());
+    return res;
+}
+
+QJsonObject Judge::toJson() const
+{
+    QJsonObject json;
+    json["source"] = sourcePath;
+    json["language"] = lang;
+    json["verdict"] = verdictName(verdict());
+    json["compilationError"] = compilationFailed ? compilationMessage : QString();
+
+    QJsonArray testcases;
+    for (int i = 0; i < results.size(); ++i)
+    {
+        const auto &result = results[i];
+        QJsonObject test;
+        test["name"] = tests[i].name;
+        test["verdict"] = verdictName(result.verdict);
+        test["time"] = result.time;
+        test["memory"] = result.memory;
+        test["exitCode"] = result.exitCode;
+        test["message"] = result.message;
+        testcases.push_back(test);
+    }
+    json["tests"] = testcases;
+
+    return json;
+}
+
+void Judge::onCompilationFinished()
+{
+    LOG_INFO("The solution is compiled");
+    if (tests.isEmpty())
+    {
+        emit finished();
+        return;
+    }
+    schedule();
+}
+
+void Judge::onCompilationErrorOccurred(const QString &error)
+{
+    LOG_INFO("Failed to compile the solution");
+    compilationFailed = true;
+    compilationMessage = error;
+    emit finished();
+}
+
+void Judge::schedule()
+{
+    while (runners.size() < jobs && nextTest < tests.size())
+    {
+        int index = nextTest++;
+
+        // the testcases in an archive are read when they run, so only the running ones are in the memory
+        QByteArray input;
+        QString error;
+        if (tests[index].archivePath.isEmpty())
+        {
+            input = tests[index].input.toUtf8();
+        }
+        else if (!readArchivedTest(index, input, error))
+        {
+            finishTest(index, FAIL, error);
+            continue;
+        }
+
+        auto runner = new Runner(index);
+        connect(runner, SIGNAL(runFinished(int, const QString &, const QString &, int, int)), this,
+                SLOT(onRunFinished(int, const QString &, const QString &, int, int)));
+        connect(runner, SIGNAL(failedToStartRun(int, const QString &)), this,
+                SLOT(onFailedToStartRun(int, const QString &)));
+        connect(runner, SIGNAL(runTimeout(int)), this, SLOT(onRunTimeout(int)));
+        connect(runner, SIGNAL(runOutputLimitExceeded(int, const QString &)), this,
+                SLOT(onRunOutputLimitExceeded(int, const QString &)));
+
+        runner->enableMemorySampling();
+
+        // insert the runner before running, because failedToStartRun may be emitted in Runner::run
+        runners[index] = runner;
+        runner->run(tmpFilePath, sourcePath, lang, SettingsManager::get(lang + "/Run Command").toString(),
+                    SettingsManager::get(lang + "/Run Arguments").toString(), input, timeLimit);
+    }
+}
+
+void Judge::onRunFinished(int index, const QString &out, const QString &err, int exitCode, int timeUsed)
+{
+    auto runner = runners.value(index);
+    if (runner == nullptr || results[index].verdict != Pending)
+        return; // it's killed after a timeout or an output limit
+
+    auto &result = results[index];
+    result.time = timeUsed;
+    result.memory = runner->peakMemory();
+    result.exitCode = exitCode;
+    releaseRunner(index);
+
+    if (exitCode != 0)
+    {
+        finishTest(index, RE, err.trimmed().isEmpty() ? QString("exit code %1").arg(exitCode) : err.trimmed());
+        return;
+    }
+
+    // the next testcase runs while this one is being checked
+    outputs[index] = out;
+    checker->reqeustCheck(index, tests[index].input, out, tests[index].expected);
+    schedule();
+}
+
+void Judge::onFailedToStartRun(int index, const QString &error)
+{
+    releaseRunner(index);
+    finishTest(index, FAIL, error);
+}
+
+void Judge::onRunTimeout(int index)
+{
+    auto runner = runners.value(index);
+    if (runner != nullptr)
+    {
+        results[index].time = timeLimit;
+        results[index].memory = runner->peakMemory();
+    }
+    releaseRunner(index);
+    finishTest(index, TLE, QString("time limit %1 ms").arg(timeLimit));
+}
+
+void Judge::onRunOutputLimitExceeded(int index, const QString &type)
+{
+    auto runner = runners.value(index);
+    if (runner != nullptr)
+        results[index].memory = runner->peakMemory();
+    releaseRunner(index);
+    finishTest(index, OLE,
+               QString("the %1 is longer than %2 characters").arg(type).arg(SettingsHelper::getOutputLengthLimit()));
+}
+
+void Judge::onCheckFinished(int index, Checker::Verdict verdict)
+{
+    if (index < 0 || index >= results.size() || results[index].verdict != Pending)
+        return;
+
+    auto output = outputs.take(index);
+    switch (verdict)
+    {
+    case Checker::AC:
+        finishTest(index, AC, QString());
+        break;
+    case Checker::WA:
+        finishTest(index, WA, describeMismatch(output, tests[index].expected));
+        break;
+    case Checker::UNKNOWN:
+        finishTest(index, FAIL, "the checker failed");
+        break;
+    }
+}
+
+void Judge::finishTest(int index, Verdict verdict, const QString &message)
+{
+    if (results[index].verdict != Pending)
+        return;
+    LOG_INFO(INFO_OF(index) << INFO_OF(verdictName(verdict)));
+    results[index].verdict = verdict;
+    results[index].message = message;
+    if (!tests[index].archivePath.isEmpty())
+    {
+        // it's read from the archive again if it's needed
+        tests[index].input.clear();
+        tests[index].expected.clear();
+    }
+    if (++finishedCount == tests.size())
+        emit finished();
+    else
+        schedule();
+}
+
+void Judge::releaseRunner(int index)
+{
+    // it may be called in a signal of the runner, so the runner can't be deleted directly
+    auto runner = runners.take(index);
+    if (runner != nullptr)
+    {
+        disconnect(runner, nullptr, this, nullptr);
+        runner->deleteLater();
+    }
+}
+
+bool Judge::readArchivedTest(int index, QByteArray &input, QString &error)
+{
+    auto &test = tests[index];
+    auto archive = archives.value(test.archivePath);
+    if (archive.isNull())
+    {
+        archive = QSharedPointer<TestCaseArchive>::create(test.archivePath);
+        if (!archive->open())
+        {
+            error = archive->errorString();
+            return false;
+        }
+        archives[test.archivePath] = archive;
+    }
+
+    input = archive->read(test.archiveIndex, true);
+    auto answer = archive->read(test.archiveIndex, false);
+    if (input.isNull() || answer.isNull())
+    {
+        error = archive->errorString();
+        return false;
+    }
+    // the checker needs them as well, they are dropped when the testcase is finished
+    test.input = QString::fromUtf8(input);
+    test.expected = QString::fromUtf8(answer);
+    return true;
+}
+
+QString Judge::describeMismatch(const QString &output, const QString &expected)
+{
+    auto mismatches = Util::firstMismatches(output, expected, 1);
+    if (mismatches.isEmpty())
+        return QString();
+    auto token = [](const QString &token, bool ended) {
+        if (ended)
+            return QString("end of file");
+        if (token.isEmpty())
+            return QString("end of line");
+        return token;
+    };
+    const auto &mismatch = mismatches.front();
+    return QString("line %1: got %2, expected %3")
+        .arg(mismatch.line + 1)
+        .arg(token(mismatch.got, mismatch.outputEnded), token(mismatch.expected, mismatch.expectedEnded));
+}
+
+} // namespace Core
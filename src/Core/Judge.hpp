@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+/*
+ * The Judge compiles a solution, runs it on a set of testcases and checks the outputs, without any GUI.
+ * It's used by the command line judge mode (cpeditor --judge), so the verdicts are the same as in the editor.
+ * The testcases are run in parallel, and each of them is checked as soon as it finishes.
+ * You have to create a new Judge for each judgement. The end of the judgement is told by a signal.
+ */
+
+#ifndef JUDGE_HPP
+#define JUDGE_HPP
+
+#include "Core/Checker.hpp"
+#include <QJsonObject>
+#include <QMap>
+#include <QSharedPointer>
+#include <QVector>
+
+class MessageLogger;
+class QTemporaryDir;
+
+namespace Core
+{
+
+class Compiler;
+class Runner;
+class TestCaseArchive;
+
+class Judge : public QObject
+{
+    Q_OBJECT
+
+  public:
+    // The verdict of a testcase
+    enum Verdict
+    {
+        Pending, // the testcase hasn't finished
+        AC,      // Accepted
+        WA,      // Wrong Answer
+        TLE,     // Time Limit Exceeded
+        RE,      // Runtime Error, the program exited with a non-zero exit code
+        OLE,     // Output Limit Exceeded
+        FAIL,    // the program failed to start or the checker failed
+        CE       // Compilation Error, only used as the overall verdict
+    };
+
+    // a testcase to judge
+    struct TestCase
+    {
+        QString name;          // the name shown in the results, usually the file name of the input
+        QString input;         // the input of the testcase
+        QString expected;      // the expected output of the testcase
+        QString archivePath;   // the archive which contains the testcase, empty if it's not in an archive
+        int archiveIndex = -1; // the index of the testcase in the archive
+    };
+
+    // the result of a testcase
+    struct Result
+    {
+        Verdict verdict = Pending; // the verdict of the testcase
+        int time = -1;             // the time used in milliseconds, -1 if it's not finished
+        qint64 memory = -1;        // the sampled peak memory usage in KiB, approximate, -1 if it's unknown
+        int exitCode = 0;          // the exit code of the program
+        QString message;           // describes a verdict which is not AC, e.g. the first different token of a WA
+    };
+
+    /**
+     * @brief construct a judge
+     * @param sourcePath the path to the source file of the solution
+     * @param lang the language of the solution, one of "C++", "Java" and "Python"
+     * @param checkerType the type of the checker
+     * @param checkerPath the file path to the custom checker, only used when *checkerType* is Custom
+     * @param jobs the maximum number of testcases running at the same time
+     * @param parent the parent of a QObject
+     * @note The compile commands, the run commands and the limits are read from the settings.
+     */
+    Judge(const QString &sourcePath, const QString &lang, Checker::CheckerType checkerType, const QString &checkerPath,
+          int jobs, QObject *parent = nullptr);
+
+    /**
+     * @brief destruct the judge
+     * @note All running processes are killed.
+     */
+    ~Judge();
+
+    /**
+     * @brief compile the solution and judge it on the testcases
+     * @param tests the testcases to judge
+     * @note This should be called only once. finished() is emitted when all testcases are judged.
+     */
+    void start(const QVector<TestCase> &tests);
+
+    /**
+     * @brief find the testcases of a solution
+     * @param sourcePath the path to the source file of the solution
+     * @param path the directory or the archive of the testcases, the testcases saved with the source file are used if
+     *             it's empty
+     * @returns the testcases sorted by their names
+     * @note The input files and the answer files in the directory are paired by the testcases matching rules in the
+     *       settings, an input file without answer file is ignored. The testcases in an archive are not read until
+     *       they run, only their indexes are returned.
+     */
+    static QVector<TestCase> findTestCases(const QString &sourcePath, const QString &path);
+
+    /**
+     * @brief get the short name of a verdict, e.g. "AC"
+     */
+    static QString verdictName(Verdict verdict);
+
+    /**
+     * @brief get the overall verdict, which is the verdict of the first testcase that is not accepted
+     */
+    Verdict verdict() const;
+
+    /**
+     * @brief get the results in a human-readable table
+     */
+    QString toTable() const;
+
+    /**
+     * @brief get the results in JSON
+     */
+    QJsonObject toJson() const;
+
+  signals:
+    /**
+     * @brief all testcases are judged, or the compilation failed
+     */
+    void finished();
+
+  private slots:
+    void onCompilationFinished();
+    void onCompilationErrorOccurred(const QString &error);
+    void onRunFinished(int index, const QString &out, const QString &err, int exitCode, int timeUsed);
+    void onFailedToStartRun(int index, const QString &error);
+    void onRunTimeout(int index);
+    void onRunOutputLimitExceeded(int index, const QString &type);
+    void onCheckFinished(int index, Core::Checker::Verdict verdict);
+
+  private:
+    void schedule();
+    void finishTest(int index, Verdict verdict, const QString &message);
+    void releaseRunner(int index);
+    bool readArchivedTest(int index, QByteArray &input, QString &error);
+    static QVector<TestCase> findArchivedTestCases(const QString &archivePath);
+    static QString describeMismatch(const QString &output, const QString &expected);
+
+    QString sourcePath;              // the path to the source file of the solution
+    QString lang;                    // the language of the solution
+    QString tmpFilePath;             // the path to the copy of the solution which is compiled
+    int jobs;                        // the maximum number of testcases running at the same time
+    int timeLimit;                   // the time limit of each testcase, in milliseconds
+    Checker *checker = nullptr;      // the checker used to check the outputs
+    Compiler *compiler = nullptr;    // the compiler of the solution
+    QTemporaryDir *tmpDir = nullptr; // the directory where the solution is compiled
+    MessageLogger *log = nullptr;    // a message logger without container, it discards the messages
+    QVector<TestCase> tests;         // the testcases to judge
+    QVector<Result> results;         // the results of the testcases
+    QMap<int, Runner *> runners;     // the running runners, by the indexes of their testcases
+    QMap<int, QString> outputs;      // the outputs being checked, by the indexes of their testcases
+    int nextTest = 0;                // the next testcase to run
+    int finishedCount = 0;           // the number of judged testcases
+    bool compilationFailed = false;  // whether the compilation failed
+    QString compilationMessage;      // the error or the warnings of the compilation
+
+    // the opened archives of the testcases, by their paths
+    QMap<QString, QSharedPointer<TestCaseArchive>> archives;
+};
+
+} // namespace Core
+
+#endif // JUDGE_HPP
@@ -18,40 +18,190 @@
 #include "Core/MessageLogger.hpp"
 #include "Core/EventLogger.hpp"
 #include <QDateTime>
+#include <QDesktopServices>
+#include <QScrollBar>
+#include <QTextBlock>
 #include <QTextBrowser>
+#include <QTimer>
 #include <generated/SettingsHelper.hpp>
 
+static const int MAX_MESSAGES = 1000;           // the maximum number of messages kept
+static const qint64 MAX_TOTAL_LENGTH = 1 << 22; // the maximum total length of the messages kept
+static const int COLLAPSED_LINES = 30;          // a message with more lines is collapsed
+static const int COLLAPSED_LENGTH = 3000;       // a message with more characters is collapsed
+static const QString EXPAND_SCHEME = "cpeditor-expand-message";
+
+MessageLogger::MessageLogger(QObject *parent) : QObject(parent)
+{
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(0);
+    connect(flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+}
+
 void MessageLogger::setContainer(QTextBrowser *container)
 {
     MessageLogger::box = container;
     LOG_INFO("MessageLogger container has been initialized");
-    box->setOpenExternalLinks(true);
+    // the links are handled in onAnchorClicked, the external links are still opened in the browser
+    box->setOpenLinks(false);
+    box->document()->setUndoRedoEnabled(false);
+    connect(box, SIGNAL(anchorClicked(const QUrl &)), this, SLOT(onAnchorClicked(const QUrl &)));
 }
 
 void MessageLogger::message(const QString &head, const QString &body, const QString &color)
 {
-    // replace spaces by "&nbsp;" to avoid multiple spaces becoming one, important for compilation errors
-    auto newHead = head.toHtmlEscaped().replace(" ", "&nbsp;");
-    auto newBody = body.toHtmlEscaped().replace(" ", "&nbsp;");
+    if (box == nullptr)
+        return;
 
-    // don't display too long messages, otherwise the application may stuck
+    // don't keep too long messages, otherwise the application may stuck
+    auto newBody = body;
     if (newBody.length() > SettingsHelper::getMessageLengthLimit())
         newBody = newBody.left(SettingsHelper::getMessageLengthLimit()) + "\n... The message is too long";
 
+    bool collapsed = newBody.length() > COLLAPSED_LENGTH || newBody.count('\n') >= COLLAPSED_LINES;
+    pending.push_back({nextID++, QTime::currentTime().toString(), head, newBody, color, collapsed});
+    totalLength += newBody.length();
+
+    // the oldest pending messages would be removed right after they are shown, so they are dropped now
+    while (pending.length() > MAX_MESSAGES || (pending.length() > 1 && totalLength > MAX_TOTAL_LENGTH))
+    {
+        totalLength -= pending.takeFirst().body.length();
+        ++omittedCount;
+    }
+
+    if (!flushTimer->isActive())
+        flushTimer->start();
+}
+
+void MessageLogger::flush()
+{
+    if (box == nullptr || (pending.isEmpty() && omittedCount == 0))
+        return;
+
+    if (omittedCount > 0)
+    {
+        pending.push_front({nextID++, QTime::currentTime().toString(), "Message Logger",
+                            QString("%1 messages are omitted because there are too many messages").arg(omittedCount),
+                            "green", false});
+        omittedCount = 0;
+    }
+
+    auto scrollBar = box->verticalScrollBar();
+    bool atBottom = scrollBar->value() == scrollBar->maximum();
+
+    // all pending messages are inserted in a single edit, so the document is laid out only once
+    QTextCursor cursor(box->document());
+    cursor.beginEditBlock();
+    cursor.movePosition(QTextCursor::End);
+    for (const auto &message : pending)
+    {
+        if (!messages.isEmpty())
+            cursor.insertBlock(QTextBlockFormat(), QTextCharFormat());
+        cursor.insertHtml(toHtml(message));
+        messages.push_back(message);
+    }
+    pending.clear();
+    removeOldMessages();
+    cursor.endEditBlock();
+
+    if (atBottom)
+        scrollBar->setValue(scrollBar->maximum());
+}
+
+void MessageLogger::removeOldMessages()
+{
+    int count = 0;
+    qint64 removedLength = 0;
+    while (messages.length() - count > MAX_MESSAGES ||
+           (messages.length() - count > 1 && totalLength - removedLength > MAX_TOTAL_LENGTH))
+    {
+        removedLength += messages[count].body.length();
+        ++count;
+    }
+    if (count == 0)
+        return;
+
+    QTextCursor cursor(box->document());
+    cursor.setPosition(box->document()->findBlockByNumber(count).position(), QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+
+    messages.erase(messages.begin(), messages.begin() + count);
+    totalLength -= removedLength;
+}
+
+QString MessageLogger::toHtml(const Message &message) const
+{
+    auto body = message.body;
+    int hiddenLength = 0;
+    if (message.collapsed)
+    {
+        // show the first lines which are not longer than COLLAPSED_LENGTH in total
+        int end = -1;
+        for (int i = 0; i < COLLAPSED_LINES; ++i)
+        {
+            int next = body.indexOf('\n', end + 1);
+            if (next == -1 || next > COLLAPSED_LENGTH)
+                break;
+            end = next;
+        }
+        if (end == -1)
+            end = qMin(body.length(), COLLAPSED_LENGTH);
+        hiddenLength = body.length() - end;
+        body.truncate(end);
+    }
+
+    // replace spaces by "&nbsp;" to avoid multiple spaces becoming one, important for compilation errors
+    auto newHead = message.head.toHtmlEscaped().replace(" ", "&nbsp;");
+    auto newBody = body.toHtmlEscaped().replace(" ", "&nbsp;");
+
     // get the HTML of the message
     // use monospace for the message body, it's important for compilation errors
     // "monospace" might not work on Windows, but "Consolas,Courier,monospace" works
-    QString res = QString("<b>[%1] [%2] </b><span style=\"").arg(QTime::currentTime().toString(), newHead);
-    if (!color.isEmpty())
-        res += "color:" + color;
+    QString res = QString("<b>[%1] [%2] </b><span style=\"").arg(message.time, newHead);
+    if (!message.color.isEmpty())
+        res += "color:" + message.color;
     res += "\">[";
-    if (newBody.contains('\n'))
+    if (newBody.contains('\n') || message.collapsed)
         res += "<br>" + newBody.replace("\n", "<br>");
     else
         res += newBody;
-    res += "]</span>";
+    if (message.collapsed)
+    {
+        res += QString("<br>... </span><a href=\"%1:%2\">Show all (%3 more characters)</a>")
+                   .arg(EXPAND_SCHEME)
+                   .arg(message.id)
+                   .arg(hiddenLength);
+    }
+    else
+    {
+        res += "]</span>";
+    }
+    return res;
+}
+
+void MessageLogger::onAnchorClicked(const QUrl &url)
+{
+    if (url.scheme() != EXPAND_SCHEME)
+    {
+        QDesktopServices::openUrl(url);
+        return;
+    }
 
-    box->append(res);
+    qint64 id = url.path().toLongLong();
+    for (int i = messages.length() - 1; i >= 0; --i)
+    {
+        if (messages[i].id == id)
+        {
+            LOG_INFO("Expanding message " << INFO_OF(id));
+            messages[i].collapsed = false;
+            auto block = box->document()->findBlockByNumber(i);
+            QTextCursor cursor(block);
+            cursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+            cursor.insertHtml(toHtml(messages[i]));
+            return;
+        }
+    }
 }
 
 void MessageLogger::info(const QString &head, const QString &body)
@@ -75,5 +225,10 @@ void MessageLogger::error(const QString &head, const QString &body)
 void MessageLogger::clear()
 {
     LOG_INFO("MessageLogger box has been cleared");
-    box->clear();
+    messages.clear();
+    pending.clear();
+    totalLength = 0;
+    omittedCount = 0;
+    if (box != nullptr)
+        box->clear();
 }
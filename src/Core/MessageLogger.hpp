@@ -17,24 +17,36 @@
 
 /*
  * The MessageLogger is used to send messages to the user directly in the GUI.
+ *
+ * The messages are not shown immediately, they are batched and shown together in the next event loop iteration,
+ * so that a flood of messages (e.g. the stderr of many testcases) doesn't make the GUI unresponsive.
+ * Only the latest messages are kept, limited by both the number of messages and the total length of them.
+ * A long message is collapsed to its beginning, and the whole message is shown when the user clicks the link.
  */
 
 #ifndef MESSAGELOGGER_HPP
 #define MESSAGELOGGER_HPP
 
-class QString;
+#include <QList>
+#include <QObject>
+
 class QTextBrowser;
+class QTimer;
+class QUrl;
 
-class MessageLogger
+class MessageLogger : public QObject
 {
+    Q_OBJECT
+
   public:
-    MessageLogger() = default;
+    explicit MessageLogger(QObject *parent = nullptr);
 
     /**
      * @brief show a message
      * @param head the head of the message, indicates where the message is from
      * @param body the main part of the message
      * @param color the color of the message, use the default color if this parameter is empty
+     * @note the message is discarded if the container is not set
      */
     void message(const QString &head, const QString &body, const QString &color);
 
@@ -73,8 +85,31 @@ class MessageLogger
      */
     void setContainer(QTextBrowser *container);
 
+  private slots:
+    void flush();
+    void onAnchorClicked(const QUrl &url);
+
   private:
-    QTextBrowser *box; // the container of the message logger
+    struct Message
+    {
+        qint64 id;      // increasing, used in the link to expand the message
+        QString time;   // the time when the message is sent
+        QString head;   // the head of the message
+        QString body;   // the body of the message, truncated by the message length limit
+        QString color;  // the color of the message
+        bool collapsed; // whether only the beginning of the body is shown
+    };
+
+    QString toHtml(const Message &message) const;
+    void removeOldMessages();
+
+    QTextBrowser *box = nullptr; // the container of the message logger
+    QTimer *flushTimer;          // shows the pending messages in the next event loop iteration
+    QList<Message> messages;     // the shown messages, the i-th message is the i-th block of the document
+    QList<Message> pending;      // the messages which are not shown yet
+    qint64 totalLength = 0;      // the total length of the bodies of the shown and pending messages
+    int omittedCount = 0;        // the number of pending messages dropped since the last flush
+    qint64 nextID = 0;           // the ID of the next message
 };
 
 #endif // MESSAGELOGGER_HPP
@@ -0,0 +1,447 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+#include "Core/Minimizer.hpp"
+#include "Core/Compiler.hpp"
+#include "Core/EventLogger.hpp"
+#include "Core/MessageLogger.hpp"
+#include "Core/Runner.hpp"
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+
+namespace Core
+{
+
+Minimizer::Minimizer(const Program &program, Checker::CheckerType checkerType, const QString &checkerPath,
+                     const QString &checkerCompileCommand, int timeLimit, QObject *parent)
+    : QObject(parent), program(program), timeLimit(timeLimit)
+{
+    // each candidate runs the program and maybe the reference solution, so half of the threads are enough
+    parallelism = qMax(1, QThread::idealThreadCount() / 2);
+
+    // The checker messages (e.g. the WA messages of the testlib checkers) are not interesting for the user,
+    // so they are sent to a message logger without container.
+    checkerLog = new MessageLogger();
+    if (checkerType == Checker::Custom)
+        checker = new Checker(checkerPath, checkerLog, this);
+    else
+        checker = new Checker(checkerType, checkerLog, this);
+    connect(checker, &Checker::checkFinished, this, &Minimizer::onCheckFinished);
+    checker->prepare(checkerCompileCommand);
+}
+
+Minimizer::~Minimizer()
+{
+    stopAll();
+    delete checker; // the checker uses checkerLog, so it should be deleted before checkerLog
+    if (compiler != nullptr)
+        delete compiler;
+    if (tmpDir != nullptr)
+        delete tmpDir;
+    delete checkerLog;
+}
+
+void Minimizer::setReference(const QString &sourcePath, const QString &lang, const QString &compileCommand,
+                             const QString &runCommand, const QString &args)
+{
+    LOG_INFO(INFO_OF(sourcePath) << INFO_OF(lang) << INFO_OF(compileCommand));
+    reference = {QString(), QString(), lang, runCommand, args};
+    referenceCompileCommand = compileCommand;
+
+    // Compile the reference solution in a temporary directory, so that it won't overwrite the executable file of
+    // the program under test even if they have the same output path.
+    tmpDir = new QTemporaryDir();
+    if (!tmpDir->isValid())
+        return;
+    reference.tmpFilePath = tmpDir->filePath(QFileInfo(sourcePath).fileName());
+    if (!QFile::copy(sourcePath, reference.tmpFilePath))
+        reference.tmpFilePath.clear();
+}
+
+void Minimizer::start(const QString &input)
+{
+    LOG_INFO(INFO_OF(input.length()) << INFO_OF(parallelism));
+    units = QStringList{input};
+
+    if (reference.lang.isEmpty() || reference.lang == "Python")
+    {
+        beginPhase(Original, input);
+        return;
+    }
+
+    if (reference.tmpFilePath.isEmpty())
+    {
+        fail("Failed to copy the reference solution to a temporary directory");
+        return;
+    }
+
+    emit minimizationProgress("Compiling the reference solution");
+    compiler = new Compiler();
+    connect(compiler, SIGNAL(compilationFinished(const QString &)), this, SLOT(onReferenceCompiled()));
+    connect(compiler, SIGNAL(compilationErrorOccurred(const QString &)), this,
+            SLOT(onReferenceCompilationErrorOccurred(const QString &)));
+    compiler->start(reference.tmpFilePath, "", referenceCompileCommand, reference.lang);
+}
+
+void Minimizer::onReferenceCompiled()
+{
+    beginPhase(Original, units.front());
+}
+
+void Minimizer::onReferenceCompilationErrorOccurred(const QString &error)
+{
+    fail("Failed to compile the reference solution:\n" + error);
+}
+
+void Minimizer::beginPhase(Phase newPhase, const QString &input)
+{
+    LOG_INFO(INFO_OF(newPhase) << INFO_OF(input.length()));
+    phase = newPhase;
+    granularity = 2;
+    units.clear();
+
+    switch (phase)
+    {
+    case Original:
+        units.push_back(input);
+        break;
+    case Lines:
+    {
+        // each unit is a line with its line break, so joining the units gives the input back
+        int begin = 0;
+        for (int i = 0; i < input.length(); ++i)
+        {
+            if (input[i] == '\n')
+            {
+                units.push_back(input.mid(begin, i + 1 - begin));
+                begin = i + 1;
+            }
+        }
+        if (begin < input.length())
+            units.push_back(input.mid(begin));
+        break;
+    }
+    case Tokens:
+    {
+        // each unit is a token with the blank characters after it, the leading blanks are kept in the first unit
+        auto it = QRegularExpression("\\S+\\s*").globalMatch(input);
+        while (it.hasNext())
+            units.push_back(it.next().captured());
+        if (units.isEmpty())
+            units.push_back(input);
+        else
+            units.front().prepend(input.left(input.length() - units.join("").length()));
+        break;
+    }
+    }
+
+    step();
+}
+
+void Minimizer::finishPhase()
+{
+    auto input = units.join("");
+    if (phase == Lines)
+    {
+        emit minimizationProgress(
+            QString("The input is reduced to %1 lines, now minimizing the tokens").arg(units.size()));
+        beginPhase(Tokens, input);
+    }
+    else
+    {
+        LOG_INFO(INFO_OF(evaluationCount) << INFO_OF(input.length()));
+        stopped = true;
+        emit minimizationFinished(input, expected);
+    }
+}
+
+void Minimizer::step()
+{
+    if (stopped)
+        return;
+
+    candidates.clear();
+    if (phase == Original)
+    {
+        candidates.push_back(units.front());
+    }
+    else
+    {
+        if (units.size() < 2)
+        {
+            finishPhase();
+            return;
+        }
+        // test the subsets first, then the complements, the complements are the same as the subsets when n = 2
+        for (int i = 0; i < granularity; ++i)
+        {
+            auto range = chunk(i);
+            candidates.push_back(units.mid(range.first, range.second - range.first).join(""));
+        }
+        if (granularity > 2)
+        {
+            for (int i = 0; i < granularity; ++i)
+            {
+                auto range = chunk(i);
+                candidates.push_back((units.mid(0, range.first) + units.mid(range.second)).join(""));
+            }
+        }
+    }
+
+    candidateVerdicts = QVector<int>(candidates.size(), -1);
+    candidateExpecteds = QVector<QString>(candidates.size());
+    nextCandidate = 0;
+    schedule();
+}
+
+void Minimizer::schedule()
+{
+    while (!stopped && evaluations.size() < parallelism && nextCandidate < candidates.size())
+    {
+        int candidate = nextCandidate++;
+        auto key = hash(candidates[candidate]);
+        if (verdictCache.contains(key))
+        {
+            candidateVerdicts[candidate] = verdictCache[key];
+            candidateExpecteds[candidate] = expectedCache.value(key);
+        }
+        else
+        {
+            evaluate(candidate);
+        }
+    }
+    resolve();
+}
+
+void Minimizer::resolve()
+{
+    if (stopped)
+        return;
+
+    // Take the first failing candidate, so the result doesn't depend on which process finishes first.
+    // A candidate is taken only when all candidates before it are known to pass.
+    for (int i = 0; i < candidates.size(); ++i)
+    {
+        if (candidateVerdicts[i] == -1)
+            return;
+        if (candidateVerdicts[i] == 0)
+            continue;
+
+        stopAll();
+        expected = candidateExpecteds[i];
+
+        if (phase == Original)
+        {
+            emit minimizationProgress("The testcase fails, now minimizing the lines");
+            beginPhase(Lines, candidates[i]);
+            return;
+        }
+
+        if (i < granularity)
+        {
+            // reduce to the subset
+            auto range = chunk(i);
+            units = units.mid(range.first, range.second - range.first);
+            granularity = 2;
+        }
+        else
+        {
+            // reduce to the complement
+            auto range = chunk(i - granularity);
+            units = units.mid(0, range.first) + units.mid(range.second);
+            granularity = qMax(granularity - 1, 2);
+        }
+        step();
+        return;
+    }
+
+    // no candidate fails
+    if (phase == Original)
+        fail("The testcase doesn't fail. It should make the program crash or reach the time limit, or get a wrong "
+             "answer when checked against the reference solution");
+    else if (granularity < units.size())
+    {
+        granularity = qMin(granularity * 2, units.size());
+        step();
+    }
+    else
+        finishPhase();
+}
+
+void Minimizer::evaluate(int candidate)
+{
+    int id = nextEvaluationId++;
+    auto input = candidates[candidate].toUtf8(); // encoded once for both the program and the reference solution
+
+    // insert the evaluation before running, because failedToStartRun may be emitted in Runner::run
+    auto &evaluation = evaluations[id];
+    evaluation.candidate = candidate;
+    evaluation.input = candidates[candidate];
+
+    // the index of a runner is id * 2 for the program, and id * 2 + 1 for the reference solution
+    auto makeRunner = [this](int index) {
+        auto runner = new Runner(index);
+        connect(runner, SIGNAL(runFinished(int, const QString &, const QString &, int, int)), this,
+                SLOT(onRunFinished(int, const QString &, const QString &, int, int)));
+        connect(runner, SIGNAL(failedToStartRun(int, const QString &)), this,
+                SLOT(onFailedToStartRun(int, const QString &)));
+        connect(runner, SIGNAL(runTimeout(int)), this, SLOT(onRunTimeout(int)));
+        connect(runner, SIGNAL(runOutputLimitExceeded(int, const QString &)), this,
+                SLOT(onRunOutputLimitExceeded(int)));
+        return runner;
+    };
+
+    evaluation.programRunner = makeRunner(id * 2);
+    if (!reference.lang.isEmpty())
+        evaluation.referenceRunner = makeRunner(id * 2 + 1);
+
+    // copy the pointers, evaluation may be removed when a runner fails to start
+    auto programRunner = evaluation.programRunner;
+    auto referenceRunner = evaluation.referenceRunner;
+
+    programRunner->run(program.tmpFilePath, program.sourceFilePath, program.lang, program.runCommand, program.args,
+                       input, timeLimit);
+    if (referenceRunner != nullptr)
+        referenceRunner->run(reference.tmpFilePath, reference.sourceFilePath, reference.lang, reference.runCommand,
+                             reference.args, input, timeLimit);
+}
+
+void Minimizer::onRunFinished(int index, const QString &out, const QString &, int exitCode, int)
+{
+    int id = index / 2;
+    if (!evaluations.contains(id))
+        return;
+
+    auto &evaluation = evaluations[id];
+    if (index % 2 == 0)
+    {
+        evaluation.programFinished = true;
+        evaluation.output = out;
+        evaluation.programFailed |= exitCode != 0;
+    }
+    else
+    {
+        evaluation.referenceFinished = true;
+        evaluation.expected = out;
+        evaluation.referenceFailed |= exitCode != 0;
+    }
+
+    if (!evaluation.programFinished || (evaluation.referenceRunner != nullptr && !evaluation.referenceFinished))
+        return;
+
+    if (evaluation.referenceRunner != nullptr && evaluation.referenceFailed)
+        finishEvaluation(id, false); // the candidate is not a valid input for the reference solution
+    else if (evaluation.programFailed)
+        finishEvaluation(id, true);
+    else if (evaluation.referenceRunner == nullptr)
+        finishEvaluation(id, false);
+    else
+        checker->reqeustCheck(id, evaluation.input, evaluation.output, evaluation.expected);
+}
+
+void Minimizer::onFailedToStartRun(int index, const QString &error)
+{
+    // this may be emitted in Runner::run, so don't delete the runners here
+    auto head = index % 2 == 0 ? QString("Failed to run the program: ") : QString("Failed to run the reference: ");
+    QTimer::singleShot(0, this, [this, head, error] { fail(head + error); });
+}
+
+void Minimizer::onRunTimeout(int index)
+{
+    // runFinished is emitted after the process is killed
+    int id = index / 2;
+    if (!evaluations.contains(id))
+        return;
+    if (index % 2 == 0)
+        evaluations[id].programFailed = true;
+    else
+        evaluations[id].referenceFailed = true;
+}
+
+void Minimizer::onRunOutputLimitExceeded(int index)
+{
+    onRunTimeout(index);
+}
+
+void Minimizer::onCheckFinished(int index, Checker::Verdict verdict)
+{
+    if (evaluations.contains(index))
+        finishEvaluation(index, verdict == Checker::WA);
+}
+
+void Minimizer::finishEvaluation(int id, bool failed)
+{
+    auto evaluation = evaluations.take(id);
+    ++evaluationCount;
+
+    // the runners have finished, but this may be called in their signals
+    evaluation.programRunner->deleteLater();
+    if (evaluation.referenceRunner != nullptr)
+        evaluation.referenceRunner->deleteLater();
+
+    auto key = hash(evaluation.input);
+    verdictCache[key] = failed;
+    if (!evaluation.expected.isEmpty())
+        expectedCache[key] = evaluation.expected;
+
+    candidateVerdicts[evaluation.candidate] = failed;
+    candidateExpecteds[evaluation.candidate] = evaluation.expected;
+    schedule();
+}
+
+void Minimizer::stopAll()
+{
+    for (auto &evaluation : evaluations)
+    {
+        for (auto runner : {evaluation.programRunner, evaluation.referenceRunner})
+        {
+            if (runner != nullptr)
+            {
+                // the runner kills the process when it's destructed, and we don't need runKilled
+                disconnect(runner, nullptr, this, nullptr);
+                runner->deleteLater();
+            }
+        }
+    }
+    evaluations.clear();
+}
+
+void Minimizer::fail(const QString &error)
+{
+    if (stopped)
+        return;
+    LOG_WARN(INFO_OF(error));
+    stopped = true;
+    stopAll();
+    emit minimizationFailed(error);
+}
+
+QPair<int, int> Minimizer::chunk(int index) const
+{
+    return {index * units.size() / granularity, (index + 1) * units.size() / granularity};
+}
+
+QByteArray Minimizer::hash(const QString &input)
+{
+    return QCryptographicHash::hash(input.toUtf8(), QCryptographicHash::Md5);
+}
+
+} // namespace Core
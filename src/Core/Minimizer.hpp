@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+/*
+ * The Minimizer reduces a failing input to a smaller input which still fails.
+ * It runs ddmin (delta debugging) on the lines of the input at first, and then on the tokens.
+ * An input fails if the program crashes or reaches the time limit, or, when a reference solution is set,
+ * the checker rejects the output of the program with the output of the reference solution as the answer.
+ * The candidates of each step are run in parallel, and the verdicts are cached by the hash of the candidate.
+ * The program under test should be compiled before the minimization, it's not compiled by the Minimizer.
+ * You have to create a new Minimizer for each minimization. The results are returned by signals.
+ */
+
+#ifndef MINIMIZER_HPP
+#define MINIMIZER_HPP
+
+#include "Core/Checker.hpp"
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QStringList>
+
+class MessageLogger;
+class QTemporaryDir;
+
+namespace Core
+{
+
+class Compiler;
+class Runner;
+
+class Minimizer : public QObject
+{
+    Q_OBJECT
+
+  public:
+    // the information needed by Core::Runner to run a program
+    struct Program
+    {
+        QString tmpFilePath;    // the path to the temporary file which is compiled
+        QString sourceFilePath; // the path to the original source file
+        QString lang;           // the language of the program, one of "C++", "Java" and "Python"
+        QString runCommand;     // the command for running the program
+        QString args;           // the command line arguments added at the back to start the program
+    };
+
+    /**
+     * @brief construct a minimizer
+     * @param program the compiled program to minimize the input for
+     * @param checkerType the type of the checker used to compare the outputs
+     * @param checkerPath the file path to the custom checker, only used when *checkerType* is Custom
+     * @param checkerCompileCommand the command used to compile the testlib checker
+     * @param timeLimit the time limit of each execution, in milliseconds
+     * @param parent the parent of a QObject
+     */
+    Minimizer(const Program &program, Checker::CheckerType checkerType, const QString &checkerPath,
+              const QString &checkerCompileCommand, int timeLimit, QObject *parent = nullptr);
+
+    /**
+     * @brief destruct the minimizer
+     * @note All running processes are killed.
+     */
+    ~Minimizer();
+
+    /**
+     * @brief set the reference solution, its output is used as the answer of a candidate
+     * @param sourcePath the path to the source file of the reference solution
+     * @param lang the language of the reference solution
+     * @param compileCommand the command used to compile the reference solution
+     * @param runCommand the command used to run the reference solution
+     * @param args the command line arguments added at the back to start the reference solution
+     * @note This should be called before start(). Without a reference solution, an input fails only if the program
+     *       crashes or reaches the time limit.
+     */
+    void setReference(const QString &sourcePath, const QString &lang, const QString &compileCommand,
+                      const QString &runCommand, const QString &args);
+
+    /**
+     * @brief start the minimization
+     * @param input the failing input to minimize
+     * @note This should be called only once.
+     */
+    void start(const QString &input);
+
+  signals:
+    /**
+     * @brief the minimization has made some progress
+     * @param message a string to describe the progress
+     */
+    void minimizationProgress(const QString &message);
+
+    /**
+     * @brief the minimization has finished
+     * @param input the minimized input
+     * @param expected the output of the reference solution on the minimized input, empty if there's no reference
+     */
+    void minimizationFinished(const QString &input, const QString &expected);
+
+    /**
+     * @brief the minimization has failed
+     * @param error a string to describe the error
+     */
+    void minimizationFailed(const QString &error);
+
+  private slots:
+    void onReferenceCompiled();
+    void onReferenceCompilationErrorOccurred(const QString &error);
+    void onRunFinished(int index, const QString &out, const QString &err, int exitCode, int timeUsed);
+    void onFailedToStartRun(int index, const QString &error);
+    void onRunTimeout(int index);
+    void onRunOutputLimitExceeded(int index);
+    void onCheckFinished(int index, Core::Checker::Verdict verdict);
+
+  private:
+    // the state of a candidate being evaluated
+    struct Evaluation
+    {
+        int candidate;                     // the index of the candidate in the current step
+        QString input;                     // the candidate input
+        QString output, expected;          // the outputs of the program and the reference solution
+        Runner *programRunner = nullptr;   // the runner of the program
+        Runner *referenceRunner = nullptr; // the runner of the reference solution, nullptr if there's no reference
+        bool programFinished = false;      // whether the program has finished
+        bool referenceFinished = false;    // whether the reference solution has finished
+        bool programFailed = false;        // whether the program crashed, reached the time limit or the output limit
+        bool referenceFailed = false;      // whether the reference solution crashed or reached any limit
+    };
+
+    enum Phase
+    {
+        Original, // check whether the original input fails
+        Lines,    // minimize the lines
+        Tokens    // minimize the tokens
+    };
+
+    void beginPhase(Phase newPhase, const QString &input);
+    void finishPhase();
+    void step();
+    void schedule();
+    void resolve();
+    void evaluate(int candidate);
+    void finishEvaluation(int id, bool failed);
+    void stopAll();
+    void fail(const QString &error);
+    QPair<int, int> chunk(int index) const;
+    static QByteArray hash(const QString &input);
+
+    Program program;                     // the program under test
+    Program reference;                   // the reference solution, its lang is empty if there's no reference
+    QString referenceCompileCommand;     // the command used to compile the reference solution
+    Checker *checker = nullptr;          // the checker used to compare the outputs
+    Compiler *compiler = nullptr;        // the compiler of the reference solution
+    QTemporaryDir *tmpDir = nullptr;     // the directory where the reference solution is compiled
+    MessageLogger *checkerLog = nullptr; // a message logger without container, it discards the checker messages
+    int timeLimit;                       // the time limit of each execution
+    int parallelism;                     // the maximum number of candidates evaluated at the same time
+    bool stopped = false;                // whether the minimization has finished or failed
+
+    Phase phase = Original;                   // the current phase
+    QStringList units;                        // the lines/tokens of the current input
+    int granularity = 2;                      // the number of chunks the units are split into
+    QStringList candidates;                   // the candidate inputs of the current step
+    QVector<int> candidateVerdicts;           // -1: pending, 0: passed, 1: failed
+    QVector<QString> candidateExpecteds;      // the outputs of the reference solution on the candidates
+    int nextCandidate = 0;                    // the next candidate to evaluate
+    int nextEvaluationId = 0;                 // the id of the next evaluation
+    QMap<int, Evaluation> evaluations;        // the running evaluations, by their ids
+    QHash<QByteArray, bool> verdictCache;     // whether an input fails, by the hash of the input
+    QHash<QByteArray, QString> expectedCache; // the outputs of the reference solution, by the hash of the input
+    int evaluationCount = 0;                  // the number of evaluated candidates, used in the progress messages
+    QString expected;                         // the output of the reference solution on the current input
+};
+
+} // namespace Core
+
+#endif // MINIMIZER_HPP
@@ -19,13 +19,23 @@
 #include "Core/Compiler.hpp"
 #include "Core/EventLogger.hpp"
 #include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
 #include <QTimer>
 #include <generated/SettingsHelper.hpp>
 
+#if defined(Q_OS_WIN)
+#include <windows.h>
+// windows.h must be included before psapi.h
+#include <psapi.h>
+#endif
+
 namespace Core
 {
 
+// the interval of sampling the memory usage of a running process
+static const int MEMORY_SAMPLE_INTERVAL = 10;
+
 Runner::Runner(int index) : runnerIndex(index)
 {
     runProcess = new QProcess();
@@ -57,6 +67,12 @@ Runner::~Runner()
 
 void Runner::run(const QString &tmpFilePath, const QString &sourceFilePath, const QString &lang,
                  const QString &runCommand, const QString &args, const QString &input, int timeLimit)
+{
+    run(tmpFilePath, sourceFilePath, lang, runCommand, args, input.toUtf8(), timeLimit);
+}
+
+void Runner::run(const QString &tmpFilePath, const QString &sourceFilePath, const QString &lang,
+                 const QString &runCommand, const QString &args, const QByteArray &input, int timeLimit)
 {
     LOG_INFO(INFO_OF(tmpFilePath) << INFO_OF(sourceFilePath) << INFO_OF(lang) << INFO_OF(runCommand) << INFO_OF(args)
                                   << INFO_OF(timeLimit));
@@ -85,6 +101,13 @@ void Runner::run(const QString &tmpFilePath, const QString &sourceFilePath, cons
     killTimer->setInterval(timeLimit);
     connect(killTimer, SIGNAL(timeout()), this, SLOT(onTimeout()));
 
+    if (isMemorySampled)
+    {
+        memoryTimer = new QTimer(runProcess);
+        memoryTimer->setInterval(MEMORY_SAMPLE_INTERVAL);
+        connect(memoryTimer, SIGNAL(timeout()), this, SLOT(sampleMemory()));
+    }
+
     runTimer = new QElapsedTimer();
 
     killTimer->start();
@@ -101,14 +124,22 @@ void Runner::run(const QString &tmpFilePath, const QString &sourceFilePath, cons
         return;
     }
 
+    if (memoryTimer != nullptr)
+    {
+        sampleMemory();
+        memoryTimer->start();
+    }
+
     // write input to the program
-    runProcess->write(input.toStdString().c_str());
+    runProcess->write(input);
     runProcess->closeWriteChannel();
 }
 
 void Runner::runDetached(const QString &tmpFilePath, const QString &sourceFilePath, const QString &lang,
                          const QString &runCommand, const QString &args)
 {
+    connect(runProcess, SIGNAL(finished(int, QProcess::ExitStatus)), this, SIGNAL(detachedRunFinished()));
+
     // different steps on different OSs
 #if defined(__unix__)
     // use xterm on Linux
@@ -147,8 +178,20 @@ void Runner::runDetached(const QString &tmpFilePath, const QString &sourceFilePa
 #endif
 }
 
+void Runner::enableMemorySampling()
+{
+    isMemorySampled = true;
+}
+
+qint64 Runner::peakMemory() const
+{
+    return peakMemoryUsage;
+}
+
 void Runner::onFinished(int exitCode, QProcess::ExitStatus exitStatus)
 {
+    if (memoryTimer != nullptr)
+        memoryTimer->stop();
     emit runFinished(runnerIndex, processStdout + runProcess->readAllStandardOutput(),
                      processStderr + runProcess->readAllStandardError(), exitCode, runTimer->elapsed());
 }
@@ -192,6 +235,38 @@ void Runner::onReadyReadStandardError()
     }
 }
 
+void Runner::sampleMemory()
+{
+    if (runProcess->state() != QProcess::Running)
+        return;
+
+    // both of them are high-water marks, so the samples only miss the growth after the last one
+#if defined(Q_OS_LINUX)
+    QFile status(QString("/proc/%1/status").arg(runProcess->processId()));
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+        return;
+    for (const auto &line : status.readAll().split('\n'))
+    {
+        if (line.startsWith("VmHWM:"))
+        {
+            bool ok = false;
+            auto value = line.mid(6).trimmed().split(' ').front().toLongLong(&ok);
+            if (ok)
+                peakMemoryUsage = qMax(peakMemoryUsage, value);
+            break;
+        }
+    }
+#elif defined(Q_OS_WIN)
+    auto handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, DWORD(runProcess->processId()));
+    if (handle == nullptr)
+        return;
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(handle, &counters, sizeof(counters)))
+        peakMemoryUsage = qMax(peakMemoryUsage, qint64(counters.PeakWorkingSetSize / 1024));
+    CloseHandle(handle);
+#endif
+}
+
 QString Runner::getCommand(const QString &tmpFilePath, const QString &sourceFilePath, const QString &lang,
                            const QString &runCommand, const QString &args)
 {
@@ -64,6 +64,15 @@ class Runner : public QObject
     void run(const QString &tmpFilePath, const QString &sourceFilePath, const QString &lang, const QString &runCommand,
              const QString &args, const QString &input, int timeLimit);
 
+    /**
+     * @brief run a program on a given raw input
+     * @param input the raw bytes written to the stdin of the program
+     * @note The other parameters are the same as the QString overload. Use this one to feed a decompressed testcase
+     *       of a TestCaseArchive or an encoded candidate of the Minimizer without converting it to a QString.
+     */
+    void run(const QString &tmpFilePath, const QString &sourceFilePath, const QString &lang, const QString &runCommand,
+             const QString &args, const QByteArray &input, int timeLimit);
+
     /**
      * @brief run a program in a pop-up terminal
      * @param tmpFilePath the path to the temporary file which is compiled
@@ -71,12 +80,28 @@ class Runner : public QObject
      * @param lang the language to run, one of "C++", "Java" and "Python"
      * @param runCommand the command for running a program
      * @param args the command line arguments added at the back to start the program
-     * @note runFinished, runTimeout and runKilled won't be emitted when using runDetached. failedToStartRun will only
-     *       be emitted when xterm is not installed on Linux, it's not emitted even the source file is not compiled.
+     * @note runFinished, runTimeout and runKilled won't be emitted when using runDetached, detachedRunFinished is
+     *       emitted instead. failedToStartRun will only be emitted when xterm is not installed on Linux, it's not
+     *       emitted even the source file is not compiled.
      */
     void runDetached(const QString &tmpFilePath, const QString &sourceFilePath, const QString &lang,
                      const QString &runCommand, const QString &args);
 
+    /**
+     * @brief enable sampling the memory usage of the program, it's disabled by default
+     * @note This should be called before run(). The memory is sampled by a timer on the thread of the Runner, so
+     *       it's only enabled when the memory usage is needed, e.g. by the Judge.
+     */
+    void enableMemorySampling();
+
+    /**
+     * @brief get the peak memory usage of the program
+     * @returns the peak resident memory in KiB, or -1 if it's unknown or the sampling is not enabled
+     * @note The memory is sampled while the program is running, so it's approximate, and the last growth of a short
+     *       program can be missed. It's only supported on Linux and Windows.
+     */
+    qint64 peakMemory() const;
+
   signals:
     /**
      * @brief the execution has just started
@@ -122,6 +147,13 @@ class Runner : public QObject
      */
     void runKilled(int index);
 
+    /**
+     * @brief the process started by runDetached has finished
+     * @note On Linux, it's emitted when the terminal is closed. On Mac OS and Windows, it's emitted when the terminal
+     *       is opened, and the program keeps running in it.
+     */
+    void detachedRunFinished();
+
   private slots:
     /**
      * @brief the process is finished
@@ -153,6 +185,11 @@ class Runner : public QObject
      */
     void onReadyReadStandardError();
 
+    /**
+     * @brief update the peak memory usage of the running process
+     */
+    void sampleMemory();
+
   private:
     /**
      * @brief get the command to run a program
@@ -169,6 +206,9 @@ class Runner : public QObject
     QProcess *runProcess = nullptr;          // the process to run the program
     QTimer *killTimer = nullptr;             // the timer used to kill the process when the time limit is reached
     QElapsedTimer *runTimer = nullptr;       // the timer used to measure how much time did the execution use
+    QTimer *memoryTimer = nullptr;           // the timer used to sample the memory usage of the process
+    qint64 peakMemoryUsage = -1;             // the peak resident memory of the process in KiB, -1 if it's unknown
+    bool isMemorySampled = false;            // whether to sample the memory usage of the process
     QString processStdout;                   // the stdout of the process
     QString processStderr;                   // the stderr of the process
     bool outputLimitExceededEmitted = false; // whether runOutputLimitExceeded is emitted or not
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+#include "Core/SaveService.hpp"
+#include "Core/EventLogger.hpp"
+#include "Util/FileUtil.hpp"
+#include "Util/Util.hpp"
+#include <QDir>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QSaveFile>
+#include <QTemporaryDir>
+#include <QtConcurrent>
+
+namespace Core
+{
+SaveService::SaveService(QObject *parent) : QObject(parent)
+{
+}
+
+SaveService::~SaveService()
+{
+    for (auto &job : jobs)
+    {
+        job.watcher->waitForFinished();
+        if (job.hasPending && !isSkipped(job.pending))
+            run(job.pending, states.value(job.pending.filePath).savedHash, prepareFormatDir(job.pending));
+    }
+    delete formatDir;
+}
+
+bool SaveService::save(const SaveRequest &request)
+{
+    auto it = jobs.find(request.filePath);
+    if (it != jobs.end())
+    {
+        // only the latest request matters, it's started when the running one is finished
+        it->pending = request;
+        it->hasPending = true;
+        return true;
+    }
+
+    if (isSkipped(request))
+        return false;
+
+    LOG_INFO("Saving " << request.filePath << " in the background " << BOOL_INFO_OF(request.format));
+    start(jobs[request.filePath], request);
+    return true;
+}
+
+void SaveService::cancel(const QString &filePath)
+{
+    auto it = jobs.find(filePath);
+    if (it != jobs.end())
+    {
+        LOG_INFO("Waiting for the background save of " << filePath);
+        // the watcher is deleted when it's finished, and its result is dropped
+        auto watcher = it->watcher;
+        jobs.erase(it);
+        watcher->waitForFinished();
+    }
+    states.remove(filePath);
+}
+
+void SaveService::onSaveFinished()
+{
+    auto watcher = static_cast<QFutureWatcher<SaveResult> *>(sender());
+    auto result = watcher->result();
+    auto it = jobs.find(result.filePath);
+
+    if (it == jobs.end() || it->watcher != watcher)
+    {
+        // it's canceled
+        watcher->deleteLater();
+        return;
+    }
+
+    if (result.ok)
+        states[result.filePath] = {Util::textHash(result.text), Util::textHash(result.savedText)};
+    else
+        states.remove(result.filePath);
+
+    if (it->hasPending && !isSkipped(it->pending))
+    {
+        auto request = it->pending;
+        it->hasPending = false;
+        it->pending = SaveRequest();
+        start(*it, request);
+        if (!result.ok)
+            emit finished(result);
+        return;
+    }
+
+    jobs.erase(it);
+    watcher->deleteLater();
+    emit finished(result);
+}
+
+bool SaveService::isSkipped(const SaveRequest &request) const
+{
+    auto it = states.find(request.filePath);
+    return it != states.end() && it->textHash == Util::textHash(request.text);
+}
+
+void SaveService::start(Job &job, const SaveRequest &request)
+{
+    if (job.watcher == nullptr)
+    {
+        job.watcher = new QFutureWatcher<SaveResult>(this);
+        connect(job.watcher, SIGNAL(finished()), this, SLOT(onSaveFinished()));
+    }
+    job.watcher->setFuture(QtConcurrent::run(&SaveService::run, request, states.value(request.filePath).savedHash,
+                                             prepareFormatDir(request)));
+}
+
+QString SaveService::prepareFormatDir(const SaveRequest &request)
+{
+    if (!request.format)
+        return QString();
+
+    // the directory is reused until it's removed by others
+    if (formatDir == nullptr || !formatDir->isValid() || !QDir(formatDir->path()).exists())
+    {
+        delete formatDir;
+        formatDir = new QTemporaryDir();
+        formatStyle.clear();
+        if (!formatDir->isValid())
+            return QString();
+    }
+
+    // it's replaced atomically, so that the running formattings read either the old style or the new one
+    if (request.formatStyle != formatStyle || formatStyle.isNull())
+    {
+        if (!Util::saveFile(formatDir->filePath(".clang-format"), request.formatStyle, "Auto Save", true))
+            return QString();
+        formatStyle = request.formatStyle;
+    }
+    return formatDir->path();
+}
+
+SaveResult SaveService::run(SaveRequest request, QByteArray savedHash, QString formatDirPath)
+{
+    // This is called in a worker thread, so don't touch the widgets or the message loggers here
+    SaveResult result;
+    result.filePath = request.filePath;
+    result.text = request.text;
+    result.savedText = request.text;
+
+    if (request.format &&
+        Extensions::ClangFormatter::formatText(request.formatBinary, formatDirPath, request.filePath, request.text,
+                                               request.formatLines, result.replacements, result.formatError))
+    {
+        result.formatted = true;
+        result.savedText = Extensions::ClangFormatter::applyReplacements(request.text, result.replacements);
+    }
+
+    // the file already has the content, e.g. only the formatting is changed in the editor
+    if (!savedHash.isEmpty() && Util::textHash(result.savedText) == savedHash)
+    {
+        result.ok = true;
+        return result;
+    }
+
+    auto content = result.savedText.toUtf8();
+    if (request.safe)
+    {
+        QSaveFile file(request.filePath);
+        result.ok = file.open(QIODevice::WriteOnly | QIODevice::Text) && file.write(content) != -1 && file.commit();
+    }
+    else
+    {
+        QFile file(request.filePath);
+        result.ok = file.open(QIODevice::WriteOnly | QIODevice::Text) && file.write(content) != -1;
+    }
+
+    if (!result.ok)
+    {
+        LOG_ERR("Failed to save to [" << request.filePath << "]");
+        result.error = "Failed to save to [" + request.filePath + "]. Do I have write permission?";
+    }
+    return result;
+}
+} // namespace Core
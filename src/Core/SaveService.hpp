@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+/*
+ * The SaveService saves the source files in the background, it's used by auto save.
+ * The text is taken on the GUI thread, and it's formatted and written to the file in a worker thread.
+ * The formatting gives the replacements instead of the whole text, so that only the changed parts of the editor are
+ * replaced when the result is applied on the GUI thread.
+ * Only one save of a file runs at a time, and if a file is saved again while it's being saved, only the latest
+ * request is kept and it's started when the running one is finished.
+ * A request is skipped if the text is the same as the last text saved to the file, and the file is not written if
+ * the formatted text is the same as the content last written to it.
+ */
+
+#ifndef SAVESERVICE_HPP
+#define SAVESERVICE_HPP
+
+#include "Extensions/ClangFormatter.hpp"
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+class QTemporaryDir;
+template <typename T> class QFutureWatcher;
+
+namespace Core
+{
+// everything needed to save a file, so that the worker thread doesn't touch the editor or the settings
+struct SaveRequest
+{
+    QString filePath;                     // the file to save to
+    QString text;                         // the text taken from the editor
+    bool safe = true;                     // whether to write to a temporary file and then replace the file with it
+    bool format = false;                  // whether to format the text with Clang Format before saving
+    QString formatBinary;                 // the path to the Clang Format binary
+    QString formatStyle;                  // the Clang Format style
+    QVector<QPair<int, int>> formatLines; // the ranges of the lines to format, all lines are formatted if it's empty
+};
+
+struct SaveResult
+{
+    QString filePath;       // the file saved to
+    QString text;           // the text in the request
+    QString savedText;      // the text in the file, it's different from text if it's formatted
+    bool ok = false;        // whether the file is saved
+    QString error;          // the error message if it's not saved
+    QString formatError;    // the error message of Clang Format, the unformatted text is saved if it's not empty
+    bool formatted = false; // whether savedText is formatted by Clang Format
+    // the replacements from text to savedText, they are applied to the editor instead of replacing the whole text
+    QVector<Extensions::ClangFormatter::Replacement> replacements;
+};
+
+class SaveService : public QObject
+{
+    Q_OBJECT
+
+  public:
+    explicit SaveService(QObject *parent = nullptr);
+
+    /**
+     * @brief destruct the save service
+     * @note It waits for the running saves, and the pending saves are done synchronously.
+     */
+    ~SaveService();
+
+    /**
+     * @brief save a file in the background
+     * @param request the file and the text to save
+     * @returns true if finished() will be emitted for the file, false if the request is skipped
+     */
+    bool save(const SaveRequest &request);
+
+    /**
+     * @brief drop the pending save of a file and wait for the running one
+     * @note This should be called before writing the file in other ways, so that an older text won't overwrite it
+     *       later. finished() is not emitted for the running save, and the next request of the file is never
+     *       skipped.
+     */
+    void cancel(const QString &filePath);
+
+  signals:
+    /**
+     * @brief a file is saved or failed to be saved
+     * @note When a file is saved several times in a row, it's only emitted for the last one, unless some fail.
+     */
+    void finished(const Core::SaveResult &result);
+
+  private slots:
+    void onSaveFinished();
+
+  private:
+    struct Job
+    {
+        QFutureWatcher<SaveResult> *watcher = nullptr; // the running save
+        bool hasPending = false;                        // whether there's a request to start after the running one
+        SaveRequest pending;                            // the latest request received while the file is being saved
+    };
+
+    struct FileState
+    {
+        QByteArray textHash;  // the MD5 of the text of the last successful request
+        QByteArray savedHash; // the MD5 of the content last written to the file
+    };
+
+    bool isSkipped(const SaveRequest &request) const;
+    void start(Job &job, const SaveRequest &request);
+    QString prepareFormatDir(const SaveRequest &request);
+    static SaveResult run(SaveRequest request, QByteArray savedHash, QString formatDirPath);
+
+    QHash<QString, Job> jobs;           // the files being saved
+    QHash<QString, FileState> states;   // the files saved before
+    QTemporaryDir *formatDir = nullptr; // the directory of the files being formatted, it's reused by all saves
+    QString formatStyle;                // the style saved to .clang-format in formatDir
+};
+} // namespace Core
+
+#endif // SAVESERVICE_HPP
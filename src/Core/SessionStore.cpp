@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+#include "Core/SessionStore.hpp"
+#include "Core/EventLogger.hpp"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <QUuid>
+#include <QtEndian>
+
+namespace Core
+{
+static const quint32 JOURNAL_MAGIC = 0x4350534A;  // "CPSJ"
+static const quint32 MANIFEST_MAGIC = 0x4350534D; // "CPSM"
+static const quint32 VERSION = 1;
+static const int HEADER_SIZE = 8;                  // magic + version
+static const int RECORD_HEADER_SIZE = 6;           // quint32 size + quint16 checksum
+static const qint64 MIN_COMPACTION_SIZE = 1 << 16; // the outdated part of a journal can be this large before compaction
+static const int COMPACTION_RATIO = 2; // compact a journal when it's this many times as large as its latest records
+static const QString JOURNAL_SUFFIX = ".journal";
+static const QString MANIFEST_NAME = "session";
+static const QString LIST_SIZE_SUFFIX = "/#";
+
+// store the lists element by element, so that only the changed elements are written
+static QVariantMap flatten(const QVariantMap &status)
+{
+    QVariantMap result;
+    for (auto it = status.begin(); it != status.end(); ++it)
+    {
+        if (it.value().type() == QVariant::StringList || it.value().type() == QVariant::List)
+        {
+            auto list = it.value().toList();
+            result[it.key() + LIST_SIZE_SUFFIX] = list.size();
+            for (int i = 0; i < list.size(); ++i)
+                result[QString("%1/%2").arg(it.key()).arg(i)] = list[i];
+        }
+        else
+        {
+            result[it.key()] = it.value();
+        }
+    }
+    return result;
+}
+
+static QVariantMap unflatten(const QVariantMap &flat)
+{
+    QVariantMap result;
+    for (auto it = flat.begin(); it != flat.end(); ++it)
+    {
+        if (it.key().endsWith(LIST_SIZE_SUFFIX))
+        {
+            auto key = it.key().left(it.key().length() - LIST_SIZE_SUFFIX.length());
+            QVariantList list;
+            for (int i = 0; i < it.value().toInt(); ++i)
+                list.push_back(flat.value(QString("%1/%2").arg(key).arg(i)));
+            result[key] = list;
+        }
+        else if (!it.key().contains('/')) // the elements of the lists are handled above
+        {
+            result[it.key()] = it.value();
+        }
+    }
+    return result;
+}
+
+static QByteArray header(quint32 magic)
+{
+    QByteArray result;
+    QDataStream stream(&result, QIODevice::WriteOnly);
+    stream << magic << VERSION;
+    return result;
+}
+
+static QByteArray encodeRecord(const QString &key, const QVariant &value)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_9);
+    stream << key << value;
+
+    QByteArray record(RECORD_HEADER_SIZE, Qt::Uninitialized);
+    qToBigEndian<quint32>(payload.size(), record.data());
+    qToBigEndian<quint16>(qChecksum(payload.constData(), payload.size()), record.data() + 4);
+    return record + payload;
+}
+
+static QByteArray digestOf(const char *record, int size)
+{
+    return QCryptographicHash::hash(QByteArray::fromRawData(record, size), QCryptographicHash::Md5);
+}
+
+SessionStore::SessionStore(const QString &path) : dir(path)
+{
+    if (!dir.mkpath("."))
+        LOG_ERR("Failed to create the session directory " << path);
+}
+
+bool SessionStore::hasSession() const
+{
+    return QFile::exists(dir.filePath(MANIFEST_NAME));
+}
+
+QStringList SessionStore::tabs(int &currentIndex, QList<QVariantMap> *summaries) const
+{
+    currentIndex = -1;
+    if (summaries != nullptr)
+        summaries->clear();
+    QFile file(dir.filePath(MANIFEST_NAME));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        LOG_WARN("Failed to open the session manifest: " << file.errorString());
+        return QStringList();
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_9);
+    quint32 magic = 0, version = 0;
+    qint32 index = -1;
+    QStringList ids;
+    QList<QVariantMap> tabSummaries;
+    stream >> magic >> version >> index >> ids >> tabSummaries;
+    if (stream.status() != QDataStream::Ok || magic != MANIFEST_MAGIC || version != VERSION ||
+        tabSummaries.size() != ids.size())
+    {
+        LOG_WARN("The session manifest is invalid");
+        return QStringList();
+    }
+
+    currentIndex = index;
+    if (summaries != nullptr)
+        *summaries = tabSummaries;
+    return ids;
+}
+
+QString SessionStore::newTab()
+{
+    return QUuid::createUuid().toString(QUuid::WithoutBraces);
+}
+
+QVariantMap SessionStore::load(const QString &id)
+{
+    auto &journal = journals[id];
+    journal = Journal();
+
+    QFile file(journalPath(id));
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        LOG_WARN("Failed to open the journal of " << id << ": " << file.errorString());
+        return QVariantMap();
+    }
+    const auto data = file.readAll();
+    file.close();
+
+    if (data.size() < HEADER_SIZE || !data.startsWith(header(JOURNAL_MAGIC)))
+    {
+        LOG_WARN("The journal of " << id << " is invalid");
+        return QVariantMap();
+    }
+
+    // replay the records, the later records of a key override the earlier ones
+    QVariantMap flat;
+    int pos = HEADER_SIZE;
+    while (pos + RECORD_HEADER_SIZE <= data.size())
+    {
+        const auto size = qFromBigEndian<quint32>(data.constData() + pos);
+        const auto checksum = qFromBigEndian<quint16>(data.constData() + pos + 4);
+        if (size > quint32(data.size() - pos - RECORD_HEADER_SIZE))
+            break;
+        const char *payload = data.constData() + pos + RECORD_HEADER_SIZE;
+        if (qChecksum(payload, size) != checksum)
+            break;
+
+        QDataStream stream(QByteArray::fromRawData(payload, int(size)));
+        stream.setVersion(QDataStream::Qt_5_9);
+        QString key;
+        QVariant value;
+        stream >> key >> value;
+        if (stream.status() != QDataStream::Ok)
+            break;
+
+        flat[key] = value;
+        journal.digests[key] = digestOf(data.constData() + pos, RECORD_HEADER_SIZE + int(size));
+        pos += RECORD_HEADER_SIZE + int(size);
+    }
+
+    if (pos != data.size())
+    {
+        // the last write is interrupted, drop it so that the new records are appended after the valid ones
+        LOG_WARN("Dropped " << data.size() - pos << " bytes at the end of the journal of " << id);
+        if (!QFile::resize(journalPath(id), pos))
+            pos = 0; // rewrite the whole journal on the next update
+    }
+    journal.fileSize = pos;
+
+    LOG_INFO(INFO_OF(id) << INFO_OF(flat.size()) << INFO_OF(journal.fileSize));
+    return unflatten(flat);
+}
+
+void SessionStore::update(const QString &id, const QVariantMap &status)
+{
+    auto &journal = journals[id];
+    const auto flat = flatten(status);
+
+    QByteArray changes, all;
+    QHash<QString, QByteArray> digests;
+    for (auto it = flat.begin(); it != flat.end(); ++it)
+    {
+        const auto record = encodeRecord(it.key(), it.value());
+        const auto digest = digestOf(record.constData(), record.size());
+        if (journal.digests.value(it.key()) != digest)
+            changes += record;
+        all += record;
+        digests[it.key()] = digest;
+    }
+
+    if (changes.isEmpty())
+    {
+        journal.digests = digests; // forget the removed list elements
+        return;
+    }
+
+    const bool compact = journal.fileSize + changes.size() > COMPACTION_RATIO * all.size() + MIN_COMPACTION_SIZE;
+    if (write(id, journal, compact ? all : changes, compact))
+        journal.digests = digests;
+    else
+        journal = Journal(); // the file may be broken, rewrite it on the next update
+}
+
+void SessionStore::setTabs(const QStringList &ids, const QList<QVariantMap> &summaries, int currentIndex)
+{
+    if (ids == savedTabs && summaries == savedSummaries && currentIndex == savedCurrentIndex && hasSession())
+        return;
+
+    LOG_INFO(INFO_OF(ids.size()) << INFO_OF(currentIndex));
+
+    QSaveFile file(dir.filePath(MANIFEST_NAME));
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        LOG_ERR("Failed to open the session manifest: " << file.errorString());
+        return;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_9);
+    stream << MANIFEST_MAGIC << VERSION << qint32(currentIndex) << ids << summaries;
+    if (stream.status() != QDataStream::Ok || !file.commit())
+    {
+        LOG_ERR("Failed to write the session manifest: " << file.errorString());
+        return;
+    }
+
+    savedTabs = ids;
+    savedSummaries = summaries;
+    savedCurrentIndex = currentIndex;
+
+    // the journals of the closed tabs and the tabs of older sessions are not needed anymore
+    for (const auto &name : dir.entryList({"*" + JOURNAL_SUFFIX}, QDir::Files))
+    {
+        auto id = name.left(name.length() - JOURNAL_SUFFIX.length());
+        if (!ids.contains(id))
+            remove(id);
+    }
+}
+
+void SessionStore::remove(const QString &id)
+{
+    LOG_INFO(INFO_OF(id));
+    journals.remove(id);
+    if (QFile::exists(journalPath(id)) && !QFile::remove(journalPath(id)))
+        LOG_WARN("Failed to remove the journal of " << id);
+}
+
+void SessionStore::clear()
+{
+    LOG_INFO("Clearing the session");
+    for (const auto &name : dir.entryList({"*" + JOURNAL_SUFFIX}, QDir::Files))
+        remove(name.left(name.length() - JOURNAL_SUFFIX.length()));
+    QFile::remove(dir.filePath(MANIFEST_NAME));
+    journals.clear();
+    savedTabs.clear();
+    savedSummaries.clear();
+    savedCurrentIndex = -1;
+}
+
+QString SessionStore::journalPath(const QString &id) const
+{
+    return dir.filePath(id + JOURNAL_SUFFIX);
+}
+
+bool SessionStore::write(const QString &id, Journal &journal, const QByteArray &records, bool rewrite)
+{
+    LOG_INFO(INFO_OF(id) << INFO_OF(records.size()) << BOOL_INFO_OF(rewrite));
+
+    if (rewrite)
+    {
+        // compaction is done by a QSaveFile, so the old journal is kept if it fails
+        QSaveFile file(journalPath(id));
+        const auto data = header(JOURNAL_MAGIC) + records;
+        if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit())
+        {
+            LOG_ERR("Failed to compact the journal of " << id << ": " << file.errorString());
+            return false;
+        }
+        journal.fileSize = data.size();
+        return true;
+    }
+
+    QFile file(journalPath(id));
+    const bool create = journal.fileSize == 0;
+    const auto data = create ? header(JOURNAL_MAGIC) + records : records;
+    if (!file.open(create ? QIODevice::WriteOnly | QIODevice::Truncate : QIODevice::WriteOnly | QIODevice::Append) ||
+        file.write(data) != data.size() || !file.flush())
+    {
+        LOG_ERR("Failed to write the journal of " << id << ": " << file.errorString());
+        return false;
+    }
+    journal.fileSize += data.size();
+    return true;
+}
+} // namespace Core
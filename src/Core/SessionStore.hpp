@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+/*
+ * The SessionStore keeps the status of the tabs for hot exit.
+ * Each tab has its own append-only journal file, and only the values which are changed since the last update are
+ * appended, so saving a session costs as much as the changes, not as much as all the tabs.
+ * A journal is compacted (rewritten with only the latest values) when most of it is outdated.
+ * The order of the tabs and a small summary of each tab (e.g. its file path for the tab title) are stored in a manifest
+ * file, so that each journal is only read when its tab is materialized.
+ * Lists (e.g. the inputs of the testcases) are stored element by element, so changing one testcase doesn't rewrite
+ * the others.
+ */
+
+#ifndef SESSIONSTORE_HPP
+#define SESSIONSTORE_HPP
+
+#include <QDir>
+#include <QHash>
+#include <QStringList>
+#include <QVariantMap>
+
+namespace Core
+{
+class SessionStore
+{
+  public:
+    /**
+     * @brief construct a session store
+     * @param path the directory of the manifest and the journals, it's created if it doesn't exist
+     */
+    explicit SessionStore(const QString &path);
+
+    /**
+     * @brief check whether there is a saved session, i.e. the manifest exists
+     */
+    bool hasSession() const;
+
+    /**
+     * @brief read the manifest
+     * @param currentIndex set to the index of the current tab, -1 if there's no current tab
+     * @param summaries set to the summaries of the tabs, one for each tab, if it's not nullptr
+     * @returns the IDs of the tabs in order
+     */
+    QStringList tabs(int &currentIndex, QList<QVariantMap> *summaries = nullptr) const;
+
+    /**
+     * @brief generate the ID of a new tab, its journal is created on the first update
+     */
+    static QString newTab();
+
+    /**
+     * @brief replay the journal of a tab
+     * @param id the ID of the tab
+     * @returns the latest status of the tab, it's empty if the journal doesn't exist or is invalid
+     * @note A truncated or corrupted record at the end of the journal (e.g. the application is killed during
+     *       writing) is dropped.
+     */
+    QVariantMap load(const QString &id);
+
+    /**
+     * @brief append the changes of the status of a tab to its journal
+     * @param id the ID of the tab
+     * @param status the whole status of the tab, only the changed values are written
+     */
+    void update(const QString &id, const QVariantMap &status);
+
+    /**
+     * @brief write the manifest if the tabs are changed, and remove the journals of the other tabs
+     * @param ids the IDs of the tabs in order
+     * @param summaries the summaries of the tabs, one for each tab. They should be small since they are read at startup
+     * @param currentIndex the index of the current tab
+     */
+    void setTabs(const QStringList &ids, const QList<QVariantMap> &summaries, int currentIndex);
+
+    /**
+     * @brief remove the journal of a tab
+     */
+    void remove(const QString &id);
+
+    /**
+     * @brief remove the manifest and all journals
+     */
+    void clear();
+
+  private:
+    struct Journal
+    {
+        QHash<QString, QByteArray> digests; // the MD5 of the latest record of each key
+        qint64 fileSize = 0;                // the size of the journal file, 0 if it's not created yet
+    };
+
+    QString journalPath(const QString &id) const;
+    bool write(const QString &id, Journal &journal, const QVector<QPair<QString, QByteArray>> &records, bool rewrite);
+
+    QDir dir;
+    QHash<QString, Journal> journals;  // the journals which are loaded or updated in this session
+    QStringList savedTabs;             // the tabs in the manifest
+    QList<QVariantMap> savedSummaries; // the summaries of the tabs in the manifest
+    int savedCurrentIndex = -1;        // the current index in the manifest
+};
+} // namespace Core
+
+#endif // SESSIONSTORE_HPP
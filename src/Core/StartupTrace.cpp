@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+#include "Core/StartupTrace.hpp"
+#include "Core/EventLogger.hpp"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace Core
+{
+
+QElapsedTimer StartupTrace::timer;
+QVector<QPair<QString, qint64>> StartupTrace::phases;
+QString StartupTrace::outputPath;
+bool StartupTrace::finished = false;
+
+void StartupTrace::start()
+{
+    timer.start();
+}
+
+void StartupTrace::setOutputPath(const QString &path)
+{
+    outputPath = path;
+}
+
+void StartupTrace::mark(const QString &phase)
+{
+    if (finished || !timer.isValid())
+        return;
+    auto elapsed = timer.elapsed();
+    auto duration = phases.isEmpty() ? elapsed : elapsed - phases.last().second;
+    phases.push_back({phase, elapsed});
+    LOG_INFO("Startup phase [" << phase << "] finished in " << duration << "ms, " << elapsed << "ms since launching");
+}
+
+void StartupTrace::finish(const QString &phase)
+{
+    mark(phase);
+    if (finished)
+        return;
+    finished = true;
+
+    if (outputPath.isEmpty())
+        return;
+
+    QJsonArray array;
+    qint64 last = 0;
+    for (const auto &p : phases)
+    {
+        QJsonObject object;
+        object["phase"] = p.first;
+        object["elapsed"] = p.second;
+        object["duration"] = p.second - last;
+        array.append(object);
+        last = p.second;
+    }
+    QJsonObject json;
+    json["phases"] = array;
+    json["total"] = last;
+
+    QFile file(outputPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(QJsonDocument(json).toJson()) == -1)
+        LOG_ERR("Failed to write the startup trace to " << outputPath << ": " << file.errorString());
+}
+
+} // namespace Core
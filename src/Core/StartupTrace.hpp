@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+/*
+ * The startup trace records when each phase of the startup is finished.
+ * The phases are written to the event log, and to a JSON file if it's given by --startup-trace,
+ * so that the time from launching to being interactive can be measured and compared.
+ */
+
+#ifndef STARTUPTRACE_HPP
+#define STARTUPTRACE_HPP
+
+#include <QElapsedTimer>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+namespace Core
+{
+class StartupTrace
+{
+  public:
+    /**
+     * @brief start timing the startup
+     * @note this should be called at the very beginning of main()
+     */
+    static void start();
+
+    /**
+     * @brief set the path of the JSON file which the phases are written into when the startup is finished
+     */
+    static void setOutputPath(const QString &path);
+
+    /**
+     * @brief record that a phase of the startup is finished
+     * @param phase the name of the phase
+     * @note this does nothing after finish() is called, so it's safe to call it in code which also runs later
+     */
+    static void mark(const QString &phase);
+
+    /**
+     * @brief record the last phase, and write the JSON file if its path is set
+     * @note only the first call takes effect
+     */
+    static void finish(const QString &phase);
+
+  private:
+    static QElapsedTimer timer;                    // started by start()
+    static QVector<QPair<QString, qint64>> phases; // the phases and the milliseconds since start() when they end
+    static QString outputPath;                     // the path of the JSON file, empty if it's not written
+    static bool finished;                          // whether finish() is called
+};
+} // namespace Core
+
+#endif // STARTUPTRACE_HPP
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+#include "Core/TestCaseArchive.hpp"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QSharedPointer>
+#include <cstring>
+
+namespace Core
+{
+const QString TestCaseArchive::FILE_SUFFIX = "cptests";
+const QString TestCaseArchive::NAME_FILTER = "Testcase Archive (*.cptests)";
+const int TestCaseArchive::MAX_ENTRY_SIZE;
+
+// The layout of an archive (all integers are big-endian):
+//   magic "CPTA", quint32 version, quint32 count
+//   count * (input entry, answer entry), each entry is quint64 offset, quint32 compressedSize, quint32 size, MD5
+//   the data section, the compressed inputs/answers in the order of the index
+static const char ARCHIVE_MAGIC[] = {'C', 'P', 'T', 'A'};
+static const quint32 ARCHIVE_VERSION = 1;
+static const int HASH_SIZE = 16;
+static const int HEADER_SIZE = 4 + 4 + 4;
+static const int ENTRY_SIZE = 8 + 4 + 4 + HASH_SIZE;
+static const int COMPRESSION_LEVEL = 6;
+
+TestCaseArchive::TestCaseArchive(const QString &path) : file(path)
+{
+}
+
+bool TestCaseArchive::open()
+{
+    inputEntries.clear();
+    answerEntries.clear();
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        error = QString("Failed to open [%1]: %2").arg(file.fileName()).arg(file.errorString());
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    char magic[sizeof(ARCHIVE_MAGIC)];
+    quint32 version = 0, number = 0;
+    if (stream.readRawData(magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) != 0)
+    {
+        error = QString("[%1] is not a testcase archive").arg(file.fileName());
+        return false;
+    }
+    stream >> version >> number;
+    if (version != ARCHIVE_VERSION)
+    {
+        error = QString("[%1] is a testcase archive of an unsupported version %2").arg(file.fileName()).arg(version);
+        return false;
+    }
+
+    // The index must fit in the file, this also rejects a corrupted count before allocating anything.
+    dataOffset = HEADER_SIZE + qint64(number) * 2 * ENTRY_SIZE;
+    if (dataOffset > file.size())
+    {
+        error = QString("The index of [%1] is truncated").arg(file.fileName());
+        return false;
+    }
+
+    inputEntries.reserve(number);
+    answerEntries.reserve(number);
+    for (quint32 i = 0; i < number * 2; ++i)
+    {
+        Entry entry;
+        entry.hash.resize(HASH_SIZE);
+        stream >> entry.offset >> entry.compressedSize >> entry.size;
+        stream.readRawData(entry.hash.data(), HASH_SIZE);
+        if (stream.status() != QDataStream::Ok ||
+            dataOffset + qint64(entry.offset) + entry.compressedSize > file.size())
+        {
+            error = QString("The index of [%1] is corrupted").arg(file.fileName());
+            return false;
+        }
+        (i % 2 == 0 ? inputEntries : answerEntries).push_back(entry);
+    }
+
+    return true;
+}
+
+int TestCaseArchive::count() const
+{
+    return inputEntries.size();
+}
+
+qint64 TestCaseArchive::size(int index, bool isInput) const
+{
+    return (isInput ? inputEntries : answerEntries)[index].size;
+}
+
+QByteArray TestCaseArchive::read(int index, bool isInput)
+{
+    Entry entry;
+    QByteArray compressed;
+    if (!readRaw(index, isInput, entry, compressed))
+        return QByteArray();
+
+    if (entry.size == 0)
+        return QByteArray("");
+
+    auto content = qUncompress(compressed);
+    if (quint32(content.size()) != entry.size ||
+        QCryptographicHash::hash(content, QCryptographicHash::Md5) != entry.hash)
+    {
+        error = QString("The %1 of testcase #%2 in [%3] is corrupted")
+                    .arg(isInput ? "input" : "answer")
+                    .arg(index + 1)
+                    .arg(file.fileName());
+        return QByteArray();
+    }
+
+    return content;
+}
+
+bool TestCaseArchive::readRaw(int index, bool isInput, Entry &entry, QByteArray &compressed)
+{
+    if (index < 0 || index >= count())
+    {
+        error = QString("There is no testcase #%1 in [%2]").arg(index + 1).arg(file.fileName());
+        return false;
+    }
+
+    entry = (isInput ? inputEntries : answerEntries)[index];
+    compressed.clear();
+    if (entry.compressedSize == 0)
+        return true;
+
+    if (!file.seek(dataOffset + qint64(entry.offset)))
+    {
+        error = QString("Failed to seek in [%1]: %2").arg(file.fileName()).arg(file.errorString());
+        return false;
+    }
+
+    compressed = file.read(entry.compressedSize);
+    if (compressed.size() != int(entry.compressedSize))
+    {
+        error = QString("Failed to read [%1]: %2").arg(file.fileName()).arg(file.errorString());
+        return false;
+    }
+
+    return true;
+}
+
+QString TestCaseArchive::errorString() const
+{
+    return error;
+}
+
+bool TestCaseArchive::write(const QString &path, const QStringList &inputs, const QStringList &answers, bool safe,
+                            QString *error)
+{
+    return write(path, inputs, answers, QVector<Reference>(), safe, error);
+}
+
+bool TestCaseArchive::write(const QString &path, const QStringList &inputs, const QStringList &answers,
+                            const QVector<Reference> &copied, bool safe, QString *error)
+{
+    auto fail = [&](const QString &reason) {
+        if (error != nullptr)
+            *error = reason;
+        return false;
+    };
+
+    if (inputs.size() != answers.size())
+        return fail("The number of inputs and the number of answers are different");
+
+    // the archives to copy from are opened once, and they are closed before the new archive replaces one of them
+    QHash<QString, QSharedPointer<TestCaseArchive>> sources;
+    for (const auto &reference : copied)
+    {
+        if (sources.contains(reference.archivePath))
+            continue;
+        auto source = QSharedPointer<TestCaseArchive>::create(reference.archivePath);
+        if (!source->open())
+            return fail(source->errorString());
+        sources[reference.archivePath] = source;
+        // writing to an archive which is being copied from truncates it, so write to a temporary file instead
+        if (QFileInfo(reference.archivePath).canonicalFilePath() == QFileInfo(path).canonicalFilePath())
+            safe = true;
+    }
+
+    QScopedPointer<QFileDevice> file;
+    if (safe)
+        file.reset(new QSaveFile(path));
+    else
+        file.reset(new QFile(path));
+
+    if (!file->open(QIODevice::WriteOnly))
+        return fail(QString("Failed to open [%1]: %2").arg(path).arg(file->errorString()));
+
+    QDataStream stream(file.data());
+    stream.setVersion(QDataStream::Qt_5_6);
+
+    // Skip the index, and write it after all entries are compressed and written, so that only one entry is kept
+    // in the memory at the same time.
+    const int number = inputs.size() + copied.size();
+    const qint64 dataOffset = HEADER_SIZE + qint64(number) * 2 * ENTRY_SIZE;
+    if (!file->seek(dataOffset))
+        return fail(QString("Failed to write [%1]: %2").arg(path).arg(file->errorString()));
+
+    QVector<Entry> entries;
+    entries.reserve(number * 2);
+    quint64 offset = 0;
+    for (int i = 0; i < number * 2; ++i)
+    {
+        bool isInput = i % 2 == 0;
+        Entry entry;
+        QByteArray compressed;
+        if (i / 2 < inputs.size())
+        {
+            auto content = (isInput ? inputs[i / 2] : answers[i / 2]).toUtf8();
+            if (content.size() > MAX_ENTRY_SIZE)
+                return fail(QString("The %1 of testcase #%2 is too large")
+                                .arg(isInput ? "input" : "answer")
+                                .arg(i / 2 + 1));
+            entry.size = content.size();
+            entry.hash = QCryptographicHash::hash(content, QCryptographicHash::Md5);
+            if (!content.isEmpty())
+                compressed = qCompress(content, COMPRESSION_LEVEL);
+        }
+        else
+        {
+            // the compressed data and the hash are copied as they are
+            const auto &reference = copied[i / 2 - inputs.size()];
+            auto source = sources[reference.archivePath];
+            if (!source->readRaw(reference.index, isInput, entry, compressed))
+                return fail(source->errorString());
+        }
+
+        entry.offset = offset;
+        entry.compressedSize = compressed.size();
+        if (!compressed.isEmpty() &&
+            stream.writeRawData(compressed.constData(), compressed.size()) != compressed.size())
+            return fail(QString("Failed to write [%1]: %2").arg(path).arg(file->errorString()));
+        offset += entry.compressedSize;
+        entries.push_back(entry);
+    }
+    sources.clear();
+
+    if (!file->seek(0))
+        return fail(QString("Failed to write [%1]: %2").arg(path).arg(file->errorString()));
+
+    stream.writeRawData(ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    stream << ARCHIVE_VERSION << quint32(number);
+    for (const auto &entry : entries)
+    {
+        stream << entry.offset << entry.compressedSize << entry.size;
+        stream.writeRawData(entry.hash.constData(), HASH_SIZE);
+    }
+
+    if (stream.status() != QDataStream::Ok)
+        return fail(QString("Failed to write [%1]: %2").arg(path).arg(file->errorString()));
+
+    if (safe && !static_cast<QSaveFile *>(file.data())->commit())
+        return fail(QString("Failed to save [%1]: %2").arg(path).arg(file->errorString()));
+
+    return true;
+}
+
+} // namespace Core
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+/*
+ * The TestCaseArchive stores a whole set of testcases in a single compressed file.
+ * The file starts with an index of the offsets, sizes and hashes of every input/answer,
+ * and each input/answer is compressed on its own, so one testcase can be read without
+ * decompressing the others.
+ * The testcases of a source file can be saved in an archive instead of separate files, so a problem can have thousands
+ * of testcases. The entries of an archive can be copied into a new archive without being decompressed.
+ * It doesn't log anything, so it can be used from worker threads. Use errorString() to get the reason of a failure.
+ */
+
+#ifndef TESTCASEARCHIVE_HPP
+#define TESTCASEARCHIVE_HPP
+
+#include <QFile>
+#include <QVector>
+
+namespace Core
+{
+
+class TestCaseArchive
+{
+  public:
+    static const QString FILE_SUFFIX;             // the suffix of archive files, without the leading dot
+    static const QString NAME_FILTER;             // the name filter used in file dialogs
+    static const int MAX_ENTRY_SIZE = 1000000000; // the maximum size of an input/answer, limited by qCompress
+
+    // a testcase in an existing archive, it's copied into a new archive without being decompressed
+    struct Reference
+    {
+        QString archivePath; // the path to the archive which contains the testcase
+        int index;           // the index of the testcase in that archive
+
+        bool operator==(const Reference &other) const
+        {
+            return archivePath == other.archivePath && index == other.index;
+        }
+    };
+
+    /**
+     * @brief construct an archive reader, the file is not opened until open() is called
+     * @param path the path to the archive file
+     */
+    explicit TestCaseArchive(const QString &path);
+
+    /**
+     * @brief open the archive and read its index
+     * @returns true on success, false if the file can't be opened or it's not a valid archive
+     */
+    bool open();
+
+    /**
+     * @brief get the number of testcases in the archive
+     */
+    int count() const;
+
+    /**
+     * @brief get the uncompressed size of an input/answer without decompressing it
+     * @param index the index of the testcase
+     * @param isInput whether to get the input or the answer
+     */
+    qint64 size(int index, bool isInput) const;
+
+    /**
+     * @brief decompress an input/answer
+     * @param index the index of the testcase
+     * @param isInput whether to read the input or the answer
+     * @returns the raw bytes, or a null QByteArray on failure
+     * @note The hash of the content is checked, a corrupted entry is treated as a failure.
+     */
+    QByteArray read(int index, bool isInput);
+
+    /**
+     * @brief get the reason of the last failure
+     */
+    QString errorString() const;
+
+    /**
+     * @brief write testcases to an archive
+     * @param path the path to the archive file, it's replaced if it exists
+     * @param inputs the inputs of the testcases
+     * @param answers the answers of the testcases, it should have the same size as *inputs*
+     * @param safe whether to write to a temporary file and rename it when finished
+     * @param error the reason of the failure is stored here if it's not nullptr
+     * @returns true on success
+     */
+    static bool write(const QString &path, const QStringList &inputs, const QStringList &answers, bool safe = true,
+                      QString *error = nullptr);
+
+    /**
+     * @brief write testcases to an archive, with some testcases copied from other archives
+     * @param copied the testcases copied from other archives, they are written after *inputs* in this order
+     * @note The other parameters are the same as the other overload. *path* itself can be copied from, it's written
+     *       to a temporary file and replaced when finished in this case, even if *safe* is false.
+     */
+    static bool write(const QString &path, const QStringList &inputs, const QStringList &answers,
+                      const QVector<Reference> &copied, bool safe = true, QString *error = nullptr);
+
+  private:
+    struct Entry
+    {
+        quint64 offset;         // the offset from the beginning of the data section
+        quint32 compressedSize; // the size of the compressed data
+        quint32 size;           // the size of the uncompressed data
+        QByteArray hash;        // the MD5 of the uncompressed data
+    };
+
+    bool readRaw(int index, bool isInput, Entry &entry, QByteArray &compressed);
+
+    QFile file;                   // the archive file
+    qint64 dataOffset = 0;        // the offset of the data section in the file
+    QVector<Entry> inputEntries;  // the index of the inputs
+    QVector<Entry> answerEntries; // the index of the answers
+    QString error;                // the reason of the last failure
+};
+
+} // namespace Core
+
+#endif // TESTCASEARCHIVE_HPP
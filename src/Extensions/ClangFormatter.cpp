@@ -19,10 +19,13 @@
 #include "Core/EventLogger.hpp"
 #include "Core/MessageLogger.hpp"
 #include "Util/FileUtil.hpp"
+#include "Util/Util.hpp"
 #include <QCodeEditor>
-#include <QJsonDocument>
-#include <QProcess>
+#include <QDir>
 #include <QTemporaryDir>
+#include <QTextDocument>
+#include <QTimer>
+#include <QXmlStreamReader>
 
 namespace Extensions
 {
@@ -31,6 +34,17 @@ ClangFormatter::ClangFormatter(const QString &clangFormatBinary, const QString &
     log = logger;
     updateBinary(clangFormatBinary);
     updateStyle(clangFormatStyle);
+
+    killTimer = new QTimer(this);
+    killTimer->setSingleShot(true);
+    killTimer->setInterval(2000);
+    connect(killTimer, SIGNAL(timeout()), this, SLOT(onFormatTimeout()));
+}
+
+ClangFormatter::~ClangFormatter()
+{
+    killFormatProcess();
+    delete tmpDir;
 }
 
 bool ClangFormatter::check(const QString &checkBinary, const QString &checkStyle)
@@ -69,6 +83,95 @@ bool ClangFormatter::check(const QString &checkBinary, const QString &checkStyle
     return program.exitCode() == 0;
 }
 
+bool ClangFormatter::formatText(const QString &formatBinary, const QString &formatDir, const QString &filePath,
+                                const QString &text, const QVector<QPair<int, int>> &lines,
+                                QVector<Replacement> &replacements, QString &error)
+{
+    // This is called in a worker thread, so don't touch the widgets or the loggers here
+    if (formatDir.isEmpty() || !QDir(formatDir).exists())
+    {
+        error = "Failed to create temporary directory";
+        return false;
+    }
+
+    // save the text in binary mode, so that the offsets in the file are the same as in content,
+    // files with the same name in different directories may be formatted at the same time
+    auto content = text.toUtf8();
+    auto fileName = QString::number(qHash(filePath), 16) + "-" + QFileInfo(filePath).fileName();
+    QFile file(QDir(formatDir).filePath(fileName));
+    if (!file.open(QIODevice::WriteOnly) || file.write(content) != content.size())
+    {
+        error = "Failed to save to [" + file.fileName() + "]. Do I have write permission?";
+        return false;
+    }
+    file.close();
+
+    QProcess formatProcess;
+    formatProcess.start(formatBinary, QStringList{"--output-replacements-xml", "--style=file"} +
+                                          linesArguments(lines) + QStringList{file.fileName()});
+    if (!formatProcess.waitForFinished(2000))
+    {
+        formatProcess.kill();
+        error = "The format process didn't finish in 2 seconds. You can set the path to clang-format in "
+                "Preferences->Formatting.";
+        return false;
+    }
+
+    if (formatProcess.exitCode() != 0)
+    {
+        error = "The format command is: " + formatBinary + " " + formatProcess.arguments().join(' ') + "\n" +
+                formatProcess.readAllStandardError();
+        return false;
+    }
+
+    if (!parseReplacements(formatProcess.readAllStandardOutput(), content, replacements))
+    {
+        error = "Failed to parse the output of Clang Format";
+        return false;
+    }
+    return true;
+}
+
+QString ClangFormatter::applyReplacements(const QString &text, const QVector<Replacement> &replacements)
+{
+    QString result;
+    int position = 0;
+    for (const auto &replacement : replacements)
+    {
+        result.append(text.midRef(position, replacement.offset - position));
+        result.append(replacement.text);
+        position = replacement.offset + replacement.length;
+    }
+    result.append(text.midRef(position));
+    return result;
+}
+
+void ClangFormatter::applyReplacements(QCodeEditor *editor, const QVector<Replacement> &replacements)
+{
+    if (replacements.isEmpty())
+        return;
+
+    auto cursor = editor->textCursor();
+    int position = mapPosition(cursor.position(), replacements);
+    int anchor = mapPosition(cursor.anchor(), replacements);
+
+    // replace from the back, so that the offsets of the other replacements are not changed,
+    // and it's a single undo step
+    QTextCursor edit(editor->document());
+    edit.beginEditBlock();
+    for (int i = replacements.size() - 1; i >= 0; --i)
+    {
+        edit.setPosition(replacements[i].offset);
+        edit.setPosition(replacements[i].offset + replacements[i].length, QTextCursor::KeepAnchor);
+        edit.insertText(replacements[i].text);
+    }
+    edit.endEditBlock();
+
+    cursor.setPosition(anchor);
+    cursor.setPosition(position, QTextCursor::KeepAnchor);
+    editor->setTextCursor(cursor);
+}
+
 void ClangFormatter::updateBinary(const QString &newBinary)
 {
     LOG_INFO("Updated clangformat binary to " << newBinary);
@@ -77,25 +180,33 @@ void ClangFormatter::updateBinary(const QString &newBinary)
 
 void ClangFormatter::updateStyle(const QString &newStyle)
 {
-    style = newStyle;
+    if (newStyle != style)
+    {
+        style = newStyle;
+        isStyleSaved = false;
+    }
 }
 
-void ClangFormatter::format(QCodeEditor *editor, const QString &filePath, const QString &lang, bool selectionOnly)
+void ClangFormatter::format(QCodeEditor *editor, const QString &filePath, const QString &lang, bool selectionOnly,
+                            bool wait, bool changedLinesOnly)
 {
-    LOG_INFO(BOOL_INFO_OF(editor == nullptr) << INFO_OF(filePath) << BOOL_INFO_OF(selectionOnly));
+    LOG_INFO(BOOL_INFO_OF(editor == nullptr) << INFO_OF(filePath) << BOOL_INFO_OF(selectionOnly) << BOOL_INFO_OF(wait)
+                                             << BOOL_INFO_OF(changedLinesOnly));
 
-    // get the cursor positions
-    auto cursor = editor->textCursor();
-    int start = cursor.selectionStart();
-    int end = cursor.selectionEnd();
-    int pos = cursor.position();
+    // only the latest formatting matters
+    killFormatProcess();
 
-    // get command line arguments related to cursor position
-    QStringList args = {"--cursor=" + QString::number(pos), "--style=file"};
-    if (selectionOnly && cursor.hasSelection())
+    auto cursor = editor->textCursor();
+    isFormattingSelection = selectionOnly && cursor.hasSelection();
+    QVector<QPair<int, int>> lines;
+    if (!isFormattingSelection && changedLinesOnly && editor == trackedEditor)
     {
-        args.append("--offset=" + QString::number(start));
-        args.append("--length=" + QString::number(end - start));
+        lines = changedLines();
+        if (lines.isEmpty() || isFormatted())
+        {
+            LOG_INFO("The codes are not changed since the last formatting");
+            return;
+        }
     }
 
     // get the file name
@@ -114,102 +225,254 @@ void ClangFormatter::format(QCodeEditor *editor, const QString &filePath, const
         tmpName = QFileInfo(filePath).fileName();
     }
 
-    // create a temporary directory
-    QTemporaryDir tmpDir;
-    if (!tmpDir.isValid())
+    // create the temporary directory, it's reused until it's removed by others
+    if (tmpDir == nullptr || !tmpDir->isValid() || !QDir(tmpDir->path()).exists())
     {
-        log->error("Formatter", "Failed to create temporary directory");
-        return;
+        delete tmpDir;
+        tmpDir = new QTemporaryDir();
+        isStyleSaved = false;
+        if (!tmpDir->isValid())
+        {
+            log->error("Formatter", "Failed to create temporary directory");
+            return;
+        }
     }
 
-    // save the text to a file
-    if (!Util::saveFile(tmpDir.filePath(tmpName), editor->toPlainText(), "Formatter", true, log))
-        return;
+    // save the style to .clang-format if it's changed
+    if (!isStyleSaved)
+    {
+        if (!Util::saveFile(tmpDir->filePath(".clang-format"), style, "Formatter", true, log))
+            return;
+        isStyleSaved = true;
+    }
 
-    // save the style to .clang-format
-    if (!Util::saveFile(tmpDir.filePath(".clang-format"), style, "Formatter", true, log))
+    // save the text in binary mode, so that the offsets in the file are the same as in formattingText
+    auto text = editor->toPlainText();
+    formattingText = text.toUtf8();
+    QFile file(tmpDir->filePath(tmpName));
+    if (!file.open(QIODevice::WriteOnly) || file.write(formattingText) != formattingText.size())
+    {
+        log->error("Formatter", "Failed to save to [" + file.fileName() + "]. Do I have write permission?");
         return;
+    }
+    file.close();
 
-    // add the file to be formatted in the command line arguments
-    args.append(tmpDir.filePath(tmpName));
-
-    // get format result with the current cursor
-    auto res = getFormatResult(args);
-    if (res.first == -1)
+    // Clang Format only tells what to replace, and the offsets are in bytes
+    QStringList args = {"--output-replacements-xml", "--style=file"};
+    if (isFormattingSelection)
     {
-        return;
+        int start = text.leftRef(cursor.selectionStart()).toUtf8().size();
+        int end = text.leftRef(cursor.selectionEnd()).toUtf8().size();
+        args.append("--offset=" + QString::number(start));
+        args.append("--length=" + QString::number(end - start));
     }
+    args.append(linesArguments(lines));
+    args.append(file.fileName());
+
+    formattingEditor = editor;
+    formattingRevision = editor->document()->revision();
+    formatProcess = new QProcess(this);
+    connect(formatProcess, SIGNAL(finished(int, QProcess::ExitStatus)), this,
+            SLOT(onFormatFinished(int, QProcess::ExitStatus)));
+    LOG_INFO("Starting format with args : " << args.join(","));
+    formatProcess->start(binary, args);
+    killTimer->start();
+
+    // finished() is emitted in waitForFinished() if it finishes in time
+    if (wait && !formatProcess->waitForFinished(2000))
+        onFormatTimeout();
+}
 
-    // set the formatted text and cursor position
-    cursor.select(QTextCursor::Document);
-    cursor.insertText(res.second);
-    cursor.setPosition(res.first);
+void ClangFormatter::onFormatFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    auto process = formatProcess;
+    formatProcess = nullptr;
+    killTimer->stop();
+    process->deleteLater();
 
-    if (start != end)
+    if (exitStatus != QProcess::NormalExit || exitCode != 0)
     {
-        // if there's a selection, we have to restore not only the cursor, but also the anchor
+        // the format process failed, show the error messages
+        LOG_WARN("Format process returned exit code " << exitCode);
 
-        // get the new position for the anchor
-        if (pos == end)
-            args[0] = "--cursor=" + QString::number(start);
-        else
-            args[0] = "--cursor=" + QString::number(end);
-        auto res2 = getFormatResult(args);
-        if (res2.first == -1)
-            return;
+        log->warn("Formatter", "The format command is: " + binary + " " + process->arguments().join(' '));
+        auto stdOut = process->readAllStandardOutput();
+        if (!stdOut.isEmpty())
+            log->warn("Formatter[stdout]", stdOut);
+        auto stdError = process->readAllStandardError();
+        if (!stdError.isEmpty())
+            log->error("Formatter[stderr]", stdError);
+        return;
+    }
 
-        // restore the selection
-        cursor.setPosition(res2.first, QTextCursor::MoveAnchor);
-        cursor.setPosition(res.first, QTextCursor::KeepAnchor);
+    auto editor = formattingEditor.data();
+    if (editor == nullptr || editor->document()->revision() != formattingRevision)
+    {
+        LOG_INFO("The editor is changed while formatting, the result is dropped");
+        return;
     }
 
-    // apply the cursor changes to the editor
-    editor->setTextCursor(cursor);
+    QVector<Replacement> replacements;
+    if (!parseReplacements(process->readAllStandardOutput(), formattingText, replacements))
+    {
+        log->warn("Formatter", "Failed to parse the output of Clang Format");
+        return;
+    }
+    formattingText.clear();
+    applyReplacements(editor, replacements);
+
+    // the lines out of the selection may be changed and not formatted yet
+    if (editor == trackedEditor && !isFormattingSelection)
+        markFormatted();
 
     log->info("Formatter", "Formatting completed");
 }
 
-QPair<int, QString> ClangFormatter::getFormatResult(const QStringList &args)
+void ClangFormatter::onFormatTimeout()
 {
-    // run the format porcess
+    if (formatProcess == nullptr)
+        return;
+    killFormatProcess();
+    log->warn("Formatter",
+              "The format process didn't finish in 2 seconds. This is probably because the clang-format binary is "
+              "not found by CP Editor. You can set the path to clang-format in Preferences->Formatting.");
+}
 
-    QProcess formatProcess;
-    formatProcess.start(binary, args);
-    LOG_INFO("Starting format with args : " << args.join(","));
+void ClangFormatter::trackChanges(QCodeEditor *editor)
+{
+    if (trackedEditor != nullptr)
+        disconnect(trackedEditor->document(), SIGNAL(contentsChange(int, int, int)), this,
+                   SLOT(onContentsChange(int, int, int)));
+    trackedEditor = editor;
+    connect(editor->document(), SIGNAL(contentsChange(int, int, int)), this, SLOT(onContentsChange(int, int, int)));
+    markFormatted();
+}
+
+void ClangFormatter::markFormatted()
+{
+    if (trackedEditor == nullptr)
+        return;
+    changedRanges.clear();
+    trackedBlockCount = trackedEditor->document()->blockCount();
+    trackedRevision = trackedEditor->document()->revision();
+    formattedHash = Util::textHash(trackedEditor->toPlainText());
+}
+
+bool ClangFormatter::isFormatted() const
+{
+    return trackedEditor != nullptr && Util::textHash(trackedEditor->toPlainText()) == formattedHash;
+}
+
+QVector<QPair<int, int>> ClangFormatter::changedLines() const
+{
+    QVector<QPair<int, int>> lines;
+    for (const auto &range : changedRanges)
+        lines.push_back({range.first + 1, range.second + 1});
+    return lines;
+}
 
-    bool finished = formatProcess.waitForFinished(2000); // BLOCKS main Thread
-    if (!finished)
+void ClangFormatter::onContentsChange(int position, int /*charsRemoved*/, int charsAdded)
+{
+    if (trackedEditor == nullptr)
+        return;
+    auto document = trackedEditor->document();
+
+    // only the formats are changed, e.g. by the highlighter
+    if (document->revision() == trackedRevision)
+        return;
+    trackedRevision = document->revision();
+
+    // the blocks [first, last] replace the blocks [first, last - delta] before the change
+    int delta = document->blockCount() - trackedBlockCount;
+    trackedBlockCount = document->blockCount();
+    int first = document->findBlock(position).blockNumber();
+    auto lastBlock = document->findBlock(position + charsAdded);
+    int last = lastBlock.isValid() ? lastBlock.blockNumber() : document->blockCount() - 1;
+    if (first == -1)
+        first = last;
+    int oldLast = last - delta;
+
+    QVector<QPair<int, int>> before, after;
+    for (const auto &range : changedRanges)
     {
-        formatProcess.kill();
-        log->warn("Formatter",
-                  "The format process didn't finish in 2 seconds. This is probably because the clang-format binary is "
-                  "not found by CP Editor. You can set the path to clang-format in Preferences->Formatting.");
-        return QPair<int, QString>(-1, QString());
+        if (range.second < first)
+        {
+            before.push_back(range);
+        }
+        else if (range.first > oldLast)
+        {
+            after.push_back({range.first + delta, range.second + delta});
+        }
+        else
+        {
+            first = qMin(first, range.first);
+            last = qMax(last, range.second + delta);
+        }
     }
+    changedRanges = before;
+    changedRanges.push_back({first, last});
+    changedRanges.append(after);
+}
 
-    if (formatProcess.exitCode() != 0)
+void ClangFormatter::killFormatProcess()
+{
+    killTimer->stop();
+    if (formatProcess != nullptr)
     {
-        // the format process failed, show the error messages and return {-1, QString()}
-        LOG_WARN("Format process returned exit code " << formatProcess.exitCode());
+        LOG_INFO("Killing the format process");
+        formatProcess->disconnect(this);
+        formatProcess->kill();
+        formatProcess->deleteLater();
+        formatProcess = nullptr;
+    }
+}
 
-        log->warn("Formatter", "The format command is: " + binary + " " + args.join(' '));
-        auto stdOut = formatProcess.readAllStandardOutput();
-        if (!stdOut.isEmpty())
-            log->warn("Formatter[stdout]", stdOut);
-        auto stdError = formatProcess.readAllStandardError();
-        if (!stdError.isEmpty())
-            log->error("Formatter[stderr]", stdError);
-        return QPair<int, QString>(-1, QString());
+bool ClangFormatter::parseReplacements(const QByteArray &xml, const QByteArray &text,
+                                       QVector<Replacement> &replacements)
+{
+    // the replacements are sorted and don't overlap, so the bytes are converted to QChars only once
+    int bytePos = 0, charPos = 0;
+    QXmlStreamReader reader(xml);
+    while (!reader.atEnd())
+    {
+        reader.readNext();
+        if (!reader.isStartElement() || reader.name() != "replacement")
+            continue;
+        int offset = reader.attributes().value("offset").toInt();
+        int length = reader.attributes().value("length").toInt();
+        if (offset < bytePos || length < 0 || offset + length > text.size())
+            return false;
+        charPos += QString::fromUtf8(text.constData() + bytePos, offset - bytePos).length();
+        bytePos = offset;
+        int charLength = QString::fromUtf8(text.constData() + offset, length).length();
+        replacements.push_back({charPos, charLength, reader.readElementText()});
     }
+    return !reader.hasError();
+}
 
-    // get the formatted codes and the new cursor position
-    auto result = formatProcess.readAllStandardOutput();
-    int firstNewLine = result.indexOf('\n');
-    QString jsonLine = result.left(firstNewLine);
-    auto formattedCodes = result.mid(firstNewLine + 1);
-    auto json = QJsonDocument::fromJson(jsonLine.toLocal8Bit());
-    int newCursorPos = json["Cursor"].toInt();
+QStringList ClangFormatter::linesArguments(const QVector<QPair<int, int>> &lines)
+{
+    QStringList args;
+    for (const auto &range : lines)
+        args.append(QString("--lines=%1:%2").arg(range.first).arg(range.second));
+    return args;
+}
 
-    return QPair<int, QString>(newCursorPos, formattedCodes);
+int ClangFormatter::mapPosition(int position, const QVector<Replacement> &replacements)
+{
+    int delta = 0;
+    for (const auto &replacement : replacements)
+    {
+        if (position <= replacement.offset)
+            break;
+        if (position >= replacement.offset + replacement.length)
+        {
+            delta += replacement.text.length() - replacement.length;
+            continue;
+        }
+        // inside the replaced part, keep the distance from its start if possible
+        return replacement.offset + delta + qMin(position - replacement.offset, replacement.text.length());
+    }
+    return position + delta;
 }
 } // namespace Extensions
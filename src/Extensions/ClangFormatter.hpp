@@ -17,24 +17,34 @@
 
 /*
  * The Formatter is used to format codes.
- * It runs synchronously, so the event loop is blocked while formatting.
+ * It runs Clang Format asynchronously and asks it for the replacements instead of the whole formatted text.
+ * Only the replaced parts of the document are changed, in a single undo step, and the cursor and the anchor are
+ * mapped through the replacements, so Clang Format only runs once even if there's a selection.
+ * The temporary directory and the style file are reused by all formattings of a Formatter.
+ * It tracks the lines changed in an editor since its last formatting by the change signals of the document, so that
+ * only the changed lines can be formatted, and an editor whose text is the same as after its last formatting is
+ * skipped entirely.
  * The time limit for formatting is 2 seconds.
  */
 
 #ifndef FORMATTER_HPP
 #define FORMATTER_HPP
 
-#include <QPair>
-#include <QString>
+#include <QPointer>
+#include <QProcess>
+#include <QVector>
 
 class MessageLogger;
 class QCodeEditor;
-class QStringList;
+class QTemporaryDir;
+class QTimer;
 
 namespace Extensions
 {
-class ClangFormatter
+class ClangFormatter : public QObject
 {
+    Q_OBJECT
+
   public:
     /**
      * @brief construct a Formatter
@@ -44,6 +54,12 @@ class ClangFormatter
      */
     ClangFormatter(const QString &clangFormatBinary, const QString &clangFormatStyle, MessageLogger *logger);
 
+    /**
+     * @brief destruct a Formatter
+     * @note the running formatting is killed
+     */
+    ~ClangFormatter();
+
     /**
      * @brief format the codes in the given editor
      * @param editor the editor to be formatted
@@ -51,8 +67,72 @@ class ClangFormatter
      * @param lang the language to be formatted
      * @param selectionOnly whether to format the selection only if there is one, doesn't matter if there is no
      *        selection
+     * @param wait whether to wait for the formatting to finish, e.g. the formatted codes are saved right after it
+     * @param changedLinesOnly whether to format the lines changed since the last formatting only, it's only used
+     *        when not formatting the selection, and the editor should be tracked by trackChanges()
+     * @note the running formatting is killed, and the result is dropped if the editor is changed before it finishes
+     */
+    void format(QCodeEditor *editor, const QString &filePath, const QString &lang, bool selectionOnly,
+                bool wait = false, bool changedLinesOnly = false);
+
+    /**
+     * @brief track the lines changed in the editor since the last formatting
+     * @param editor the editor to track, the text in it is considered formatted
+     */
+    void trackChanges(QCodeEditor *editor);
+
+    /**
+     * @brief consider the text in the tracked editor formatted, e.g. it's loaded from a file or formatted elsewhere
+     */
+    void markFormatted();
+
+    /**
+     * @brief check whether the text in the tracked editor is the same as after the last formatting
      */
-    void format(QCodeEditor *editor, const QString &filePath, const QString &lang, bool selectionOnly);
+    bool isFormatted() const;
+
+    /**
+     * @brief get the lines changed in the tracked editor since the last formatting
+     * @returns the 1-based inclusive ranges of the lines, in the format of the --lines option of Clang Format
+     */
+    QVector<QPair<int, int>> changedLines() const;
+
+    // a replacement of Clang Format, in QChars of the text instead of bytes
+    struct Replacement
+    {
+        int offset;   // the start of the replaced part in the original text
+        int length;   // the length of the replaced part in the original text
+        QString text; // the new text of the replaced part
+    };
+
+    /**
+     * @brief format a text without an editor or a message logger, so that it can be called in a worker thread
+     * @param formatBinary the path to the Clang Format binary
+     * @param formatDir the directory to save the text to, the style is read from the .clang-format in it
+     * @param filePath the file path of the text, its suffix tells Clang Format the language
+     * @param text the text to be formatted
+     * @param lines the ranges of the lines to format returned by changedLines(), all lines are formatted if empty
+     * @param replacements the replacements to apply to the text, sorted by their offsets
+     * @param error the error messages if the formatting failed
+     * @returns whether the formatting succeeded
+     * @note the text is saved to formatDir by a name from filePath, so only one formatting of a file should run at a
+     *       time
+     */
+    static bool formatText(const QString &formatBinary, const QString &formatDir, const QString &filePath,
+                           const QString &text, const QVector<QPair<int, int>> &lines,
+                           QVector<Replacement> &replacements, QString &error);
+
+    /**
+     * @brief apply the replacements returned by formatText() to the text
+     */
+    static QString applyReplacements(const QString &text, const QVector<Replacement> &replacements);
+
+    /**
+     * @brief apply the replacements returned by formatText() to the editor in a single undo step
+     * @note the cursor and the anchor are mapped through the replacements, the text in the editor should be the same
+     *       as the text passed to formatText()
+     */
+    static void applyReplacements(QCodeEditor *editor, const QVector<Replacement> &replacements);
 
     /**
      * @brief check whether the given settings are valid
@@ -73,18 +153,35 @@ class ClangFormatter
      */
     void updateStyle(const QString &newStyle);
 
+  private slots:
+    void onFormatFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void onFormatTimeout();
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+
   private:
-    /**
-     * @brief get the format result
-     * @param args the command line arguments passed to Clang Format
-     * @return a QPair, the first element is the new cursor position, the second element is the new text
-     *         if the formatting failed, it will return {-1, QString()}
-     */
-    QPair<int, QString> getFormatResult(const QStringList &args);
+    void killFormatProcess();
+    static bool parseReplacements(const QByteArray &xml, const QByteArray &text, QVector<Replacement> &replacements);
+    static int mapPosition(int position, const QVector<Replacement> &replacements);
+    static QStringList linesArguments(const QVector<QPair<int, int>> &lines);
 
     QString binary;     // the path to the Clang Format binary
     QString style;      // the Clang Format style
     MessageLogger *log; // the message logger to display messages
+
+    QTemporaryDir *tmpDir = nullptr;        // the temporary directory reused by the formattings
+    bool isStyleSaved = false;              // whether the current style is saved to .clang-format in tmpDir
+    QProcess *formatProcess = nullptr;      // the running Clang Format
+    QTimer *killTimer = nullptr;            // kills the format process when it reaches the time limit
+    QPointer<QCodeEditor> formattingEditor; // the editor being formatted
+    int formattingRevision = 0;             // the revision of the document when the formatting is started
+    QByteArray formattingText;              // the UTF-8 text being formatted, the replacements are in its bytes
+    bool isFormattingSelection = false;     // whether only the selection is being formatted
+
+    QPointer<QCodeEditor> trackedEditor;   // the editor whose changed lines are tracked
+    QVector<QPair<int, int>> changedRanges; // the 0-based inclusive ranges of the changed blocks, sorted and disjoint
+    int trackedBlockCount = 0;              // the block count of the tracked document after the last change
+    int trackedRevision = 0;                // the revision of the tracked document after the last change
+    QByteArray formattedHash;               // the MD5 of the text after the last formatting
 };
 
 } // namespace Extensions
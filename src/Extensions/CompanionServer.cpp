@@ -23,9 +23,181 @@
 #include <QJsonObject>
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QTimer>
 
 namespace Extensions
 {
+// the limits of a request, a request from Competitive Companion is far smaller than these
+static const int MAX_HEADER_SIZE = 64 * 1024;
+static const qint64 MAX_BODY_SIZE = 64 * 1024 * 1024;
+// a connection which doesn't finish its request in this time is closed, so that it doesn't block the later problems
+static const int CONNECTION_TIMEOUT = 10000;
+
+HttpRequestParser::Status HttpRequestParser::feed(const QByteArray &data)
+{
+    if (status != Incomplete)
+        return status;
+    buffer += data;
+    status = parse();
+    return status;
+}
+
+QByteArray HttpRequestParser::method() const
+{
+    return requestMethod;
+}
+
+QByteArray HttpRequestParser::header(const QByteArray &name) const
+{
+    return headers.value(name.toLower());
+}
+
+QByteArray HttpRequestParser::body() const
+{
+    return requestBody;
+}
+
+QString HttpRequestParser::errorString() const
+{
+    return error;
+}
+
+bool HttpRequestParser::readLine(QByteArray &line)
+{
+    int end = buffer.indexOf('\n');
+    if (end == -1)
+        return false;
+    line = buffer.left(end);
+    if (line.endsWith('\r'))
+        line.chop(1);
+    buffer.remove(0, end + 1);
+    return true;
+}
+
+HttpRequestParser::Status HttpRequestParser::parse()
+{
+    QByteArray line;
+    while (true)
+    {
+        switch (state)
+        {
+        case RequestLine:
+        case Headers:
+        case Trailers:
+            if (!readLine(line))
+            {
+                if (headerSize + buffer.size() > MAX_HEADER_SIZE)
+                    return fail(TooLarge, "The headers are too large");
+                return Incomplete;
+            }
+            headerSize += line.size() + 2;
+            if (headerSize > MAX_HEADER_SIZE)
+                return fail(TooLarge, "The headers are too large");
+
+            if (state == RequestLine)
+            {
+                // the empty lines before the request line should be ignored
+                if (line.isEmpty())
+                    break;
+                auto parts = line.split(' ');
+                if (parts.size() != 3 || !parts[2].startsWith("HTTP/1."))
+                    return fail(Invalid, "Invalid request line");
+                requestMethod = parts[0];
+                state = Headers;
+            }
+            else if (!line.isEmpty())
+            {
+                int colon = line.indexOf(':');
+                if (colon <= 0)
+                    return fail(Invalid, "Invalid header");
+                // the trailers after a chunked body are ignored
+                if (state == Headers)
+                {
+                    auto name = line.left(colon).trimmed().toLower();
+                    auto value = line.mid(colon + 1).trimmed();
+                    headers[name] = headers.contains(name) ? headers[name] + ", " + value : value;
+                }
+            }
+            else if (state == Trailers)
+            {
+                state = Done;
+            }
+            else if (header("Transfer-Encoding").toLower().contains("chunked"))
+            {
+                state = ChunkSize;
+            }
+            else if (headers.contains("content-length"))
+            {
+                bool ok = false;
+                remaining = header("Content-Length").toLongLong(&ok);
+                if (!ok || remaining < 0)
+                    return fail(Invalid, "Invalid Content-Length");
+                if (remaining > MAX_BODY_SIZE)
+                    return fail(TooLarge, "The body is too large");
+                state = Body;
+            }
+            else
+            {
+                state = Done; // there's no body
+            }
+            break;
+        case ChunkSize:
+        {
+            if (!readLine(line))
+            {
+                if (buffer.size() > MAX_HEADER_SIZE)
+                    return fail(TooLarge, "The chunk size line is too large");
+                return Incomplete;
+            }
+            // the chunk extensions are ignored
+            int semicolon = line.indexOf(';');
+            if (semicolon != -1)
+                line.truncate(semicolon);
+            bool ok = false;
+            remaining = line.trimmed().toLongLong(&ok, 16);
+            if (!ok || remaining < 0)
+                return fail(Invalid, "Invalid chunk size");
+            if (requestBody.size() + remaining > MAX_BODY_SIZE)
+                return fail(TooLarge, "The body is too large");
+            state = remaining == 0 ? Trailers : ChunkData;
+            break;
+        }
+        case Body:
+        case ChunkData:
+        {
+            auto size = qMin(remaining, qint64(buffer.size()));
+            requestBody += buffer.left(int(size));
+            buffer.remove(0, int(size));
+            remaining -= size;
+            if (remaining > 0)
+                return Incomplete;
+            state = state == Body ? Done : ChunkDataEnd;
+            break;
+        }
+        case ChunkDataEnd:
+            if (!readLine(line))
+            {
+                if (buffer.size() > 1)
+                    return fail(Invalid, "Invalid chunk");
+                return Incomplete;
+            }
+            if (!line.isEmpty())
+                return fail(Invalid, "Invalid chunk");
+            state = ChunkSize;
+            break;
+        case Done:
+            return Complete;
+        }
+    }
+}
+
+HttpRequestParser::Status HttpRequestParser::fail(Status result, const QString &reason)
+{
+    error = reason;
+    buffer.clear();
+    return result;
+}
+
 CompanionServer::CompanionServer(int port)
 {
     updatePort(port);
@@ -74,95 +246,165 @@ CompanionServer::~CompanionServer()
 {
     if (log != nullptr)
         log->info("Companion", "Stopped Server");
+    // the open connections are children of this, they are deleted after this
     delete server;
 }
 
 void CompanionServer::onNewConnection()
 {
-    LOG_INFO("New connection has arrived, reading from queue");
-    socket = server->nextPendingConnection();
-    socket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
-    QObject::connect(socket, SIGNAL(readyRead()), this, SLOT(onReadReady()));
-    QObject::connect(socket, SIGNAL(disconnected()), this, SLOT(onTerminateConnection()));
+    // Competitive Companion sends the problems of a contest in a burst, each problem in its own connection
+    while (server->hasPendingConnections())
+    {
+        auto socket = server->nextPendingConnection();
+        // the socket is owned by this, so that the open connections are kept when the port is changed
+        socket->setParent(this);
+        auto &connection = connections[socket];
+        connection.id = nextConnectionID++;
+        LOG_INFO("New connection has arrived " << INFO_OF(connection.id));
+
+        connect(socket, SIGNAL(readyRead()), this, SLOT(onReadReady()));
+        connect(socket, SIGNAL(disconnected()), this, SLOT(onTerminateConnection()));
+        QTimer::singleShot(CONNECTION_TIMEOUT, socket, [this, socket] {
+            if (connections.contains(socket))
+            {
+                LOG_WARN("The request is not finished in time " << INFO_OF(connections[socket].id));
+                finishConnection(socket, "408 Request Timeout", "Request Timeout", false);
+            }
+        });
+    }
 }
 
 void CompanionServer::onReadReady()
 {
-    QString request = socket->readAll();
-
-    LOG_INFO("Connection content is\n" << request);
+    auto socket = qobject_cast<QTcpSocket *>(sender());
+    auto it = connections.find(socket);
+    if (it == connections.end())
+    {
+        // the request is already handled, the rest is ignored
+        socket->readAll();
+        return;
+    }
 
-    if (request.startsWith("POST") && request.contains("Content-Type: application/json"))
+    switch (it->parser.feed(socket->readAll()))
     {
+    case HttpRequestParser::Incomplete:
+        break;
+    case HttpRequestParser::Complete:
+        handleRequest(socket);
+        break;
+    case HttpRequestParser::Invalid:
+        LOG_WARN("Invalid request " << INFO_OF(it->id) << it->parser.errorString());
         if (log != nullptr)
-            log->info("Companion", "Got a POST Request");
-
-        socket->write("HTTP/1.1  OK\r\n"); // \r needs to be before \n
-        socket->write("Content-Type: text/html\r\n");
-        socket->write("Connection: close\r\n");
-        socket->write("Pragma: no-cache\r\n");
-        socket->write("\r\n");
-        socket->write("<!DOCTYPE html>\r\n");
-        socket->write("<html><body><h1>Okay, Accepted"
-                      "</h1></body></html>");
-        socket->write(QByteArray());
-        socket->disconnectFromHost();
-
-        request = request.mid(request.indexOf('{'));
-
-        QJsonParseError error;
-        QJsonDocument doc = QJsonDocument::fromJson(request.toUtf8(), &error);
-        if (error.error == QJsonParseError::NoError)
-        {
-            CompanionData payload;
-
-            payload.name = doc["name"].toString();
-            payload.contest = doc["group"].toString();
-            payload.url = doc["url"].toString();
-            payload.interactive = doc["interactive"].toBool();
-            payload.memoryLimit = doc["memoryLimit"].toInt();
-            payload.timeLimit = doc["timeLimit"].toInt();
-            payload.isInputstdin = doc["input"].toObject()["type"].toString() == "stdin";
-            payload.isOutputstdout = doc["output"].toObject()["type"].toString() == "stdout";
-
-            QJsonArray testArray = doc["tests"].toArray();
-            for (auto tests : testArray)
-            {
-                auto in = tests.toObject()["input"].toString();
-                auto out = tests.toObject()["output"].toString();
-                payload.testcases.push_back({in, out});
-            }
-            emit onRequestArrived(payload);
-        }
-        else
-        {
-            if (log != nullptr)
-                log->error("Companion", "JSONParser reported errors. \n" + error.errorString());
-            else
-                LOG_WARN("JSON Parser reported error " << error.errorString());
-        }
+            log->warn("Companion", "An Invalid Payload was delivered on the listening port");
+        finishConnection(socket, "400 Bad Request", "Bad Request: " + it->parser.errorString().toUtf8(), false);
+        break;
+    case HttpRequestParser::TooLarge:
+        LOG_WARN("Too large request " << INFO_OF(it->id) << it->parser.errorString());
+        if (log != nullptr)
+            log->warn("Companion", "A too large payload was delivered on the listening port");
+        finishConnection(socket, "413 Payload Too Large", "Payload Too Large", false);
+        break;
     }
-    else
+}
+
+void CompanionServer::handleRequest(QTcpSocket *socket)
+{
+    const auto &parser = connections[socket].parser;
+    LOG_INFO("Request is complete " << INFO_OF(connections[socket].id) << INFO_OF(parser.method())
+                                    << INFO_OF(parser.body().size()));
+
+    if (parser.method() != "POST" || !parser.header("Content-Type").toLower().contains("application/json"))
     {
         if (log != nullptr)
             log->warn("Companion", "An Invalid Payload was delivered on the listening port");
         else
             LOG_WARN("Invalid payload delivered on listing port");
-        socket->write("HTTP/1.1  OK\r\n"); // \r needs to be before \n
-        socket->write("Content-Type: text/html\r\n");
-        socket->write("Connection: close\r\n");
-        socket->write("Pragma: no-cache\r\n");
-        socket->write("\r\n");
-        socket->write("<!DOCTYPE html>\r\n");
-        socket->write("<html><body><h1>Rejected!!! Only POST requests with Content-type JSON "
-                      "are allowed "
-                      "here.</h1></body></html>");
-        socket->write(QByteArray());
-        socket->disconnectFromHost();
+        finishConnection(socket, parser.method() != "POST" ? "405 Method Not Allowed" : "415 Unsupported Media Type",
+                         "Rejected!!! Only POST requests with Content-type JSON are allowed here.", false);
+        return;
+    }
+
+    if (log != nullptr)
+        log->info("Companion", "Got a POST Request");
+
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(parser.body(), &error);
+    if (error.error != QJsonParseError::NoError)
+    {
+        if (log != nullptr)
+            log->error("Companion", "JSONParser reported errors. \n" + error.errorString());
+        else
+            LOG_WARN("JSON Parser reported error " << error.errorString());
+        finishConnection(socket, "400 Bad Request", "Bad Request: " + error.errorString().toUtf8(), false);
+        return;
+    }
+
+    CompanionData payload;
+
+    payload.name = doc["name"].toString();
+    payload.contest = doc["group"].toString();
+    payload.url = doc["url"].toString();
+    payload.interactive = doc["interactive"].toBool();
+    payload.memoryLimit = doc["memoryLimit"].toInt();
+    payload.timeLimit = doc["timeLimit"].toInt();
+    payload.isInputstdin = doc["input"].toObject()["type"].toString() == "stdin";
+    payload.isOutputstdout = doc["output"].toObject()["type"].toString() == "stdout";
+
+    QJsonArray testArray = doc["tests"].toArray();
+    for (auto tests : testArray)
+    {
+        auto in = tests.toObject()["input"].toString();
+        auto out = tests.toObject()["output"].toString();
+        payload.testcases.push_back({in, out});
+    }
+
+    finishConnection(socket, "200 OK", "Okay, Accepted", true, payload);
+}
+
+void CompanionServer::sendResponse(QTcpSocket *socket, const QByteArray &status, const QByteArray &message)
+{
+    QByteArray body = "<!DOCTYPE html>\r\n<html><body><h1>" + message + "</h1></body></html>";
+    socket->write("HTTP/1.1 " + status + "\r\n"); // \r needs to be before \n
+    socket->write("Content-Type: text/html\r\n");
+    socket->write("Content-Length: " + QByteArray::number(body.size()) + "\r\n");
+    socket->write("Connection: close\r\n");
+    socket->write("Pragma: no-cache\r\n");
+    socket->write("\r\n");
+    socket->write(body);
+    socket->disconnectFromHost();
+}
+
+void CompanionServer::finishConnection(QTcpSocket *socket, const QByteArray &status, const QByteArray &message,
+                                       bool hasProblem, const CompanionData &data)
+{
+    // the connection is removed first, the socket may be disconnected as soon as the response is sent
+    auto id = connections.take(socket).id;
+    sendResponse(socket, status, message);
+    finishedRequests[id] = qMakePair(hasProblem, data);
+    emitFinishedProblems();
+}
+
+void CompanionServer::emitFinishedProblems()
+{
+    // a problem waits for the problems of the earlier connections, so that the tabs are created in order
+    while (!finishedRequests.isEmpty() && finishedRequests.firstKey() == nextEmittedID)
+    {
+        auto request = finishedRequests.take(nextEmittedID++);
+        if (request.first)
+            emit onRequestArrived(request.second);
     }
 }
+
 void CompanionServer::onTerminateConnection()
 {
+    auto socket = qobject_cast<QTcpSocket *>(sender());
+    if (connections.contains(socket))
+    {
+        auto id = connections.take(socket).id;
+        LOG_WARN("The connection is closed before the request is finished " << INFO_OF(id));
+        finishedRequests[id] = qMakePair(false, CompanionData());
+        emitFinishedProblems();
+    }
     LOG_INFO("Socket scheduled to be Deleted");
     socket->deleteLater();
 }
@@ -18,6 +18,8 @@
 #ifndef COMPANIONSERVER_HPP
 #define COMPANIONSERVER_HPP
 
+#include <QHash>
+#include <QMap>
 #include <QObject>
 #include <QVector>
 
@@ -58,6 +60,56 @@ struct CompanionData
     }
 };
 
+/**
+ * A streaming parser of an HTTP/1.1 request, the data can be fed in any pieces as they arrive.
+ * The body is read by Content-Length or by chunked transfer encoding.
+ */
+class HttpRequestParser
+{
+  public:
+    enum Status
+    {
+        Incomplete, // more data is needed
+        Complete,   // the whole request is read, the data after it is ignored
+        Invalid,    // the request is malformed, see errorString()
+        TooLarge    // the headers or the body exceed the limits
+    };
+
+    Status feed(const QByteArray &data);
+
+    QByteArray method() const;
+    QByteArray header(const QByteArray &name) const;
+    QByteArray body() const;
+    QString errorString() const;
+
+  private:
+    enum State
+    {
+        RequestLine,
+        Headers,
+        Body,
+        ChunkSize,
+        ChunkData,
+        ChunkDataEnd,
+        Trailers,
+        Done
+    };
+
+    bool readLine(QByteArray &line);
+    Status parse();
+    Status fail(Status result, const QString &reason);
+
+    State state = RequestLine;
+    Status status = Incomplete;
+    QByteArray buffer;                     // the data which is not parsed yet
+    int headerSize = 0;                    // the total size of the request line and the headers
+    QByteArray requestMethod;              // e.g. "POST"
+    QHash<QByteArray, QByteArray> headers; // the names are in lower case
+    QByteArray requestBody;                // the decoded body
+    qint64 remaining = 0;                  // the remaining size of the body or the current chunk
+    QString error;                         // the reason of Invalid or TooLarge
+};
+
 class CompanionServer : public QObject
 {
     Q_OBJECT
@@ -78,10 +130,27 @@ class CompanionServer : public QObject
     void onReadReady();
 
   private:
+    // the state of an open connection, a connection sends a single request
+    struct Connection
+    {
+        quint64 id = 0; // the connections are numbered in the order they are accepted
+        HttpRequestParser parser;
+    };
+
+    void handleRequest(QTcpSocket *socket);
+    void sendResponse(QTcpSocket *socket, const QByteArray &status, const QByteArray &message);
+    void finishConnection(QTcpSocket *socket, const QByteArray &status, const QByteArray &message, bool hasProblem,
+                          const CompanionData &data = CompanionData());
+    void emitFinishedProblems();
+
     QTcpServer *server = nullptr;
-    QTcpSocket *socket = nullptr;
     int portNumber = 0;
     MessageLogger *log = nullptr;
+
+    QHash<QTcpSocket *, Connection> connections;                // the connections whose requests are being read
+    QMap<quint64, QPair<bool, CompanionData>> finishedRequests; // the finished requests waiting for the earlier ones
+    quint64 nextConnectionID = 0;                               // the ID of the next accepted connection
+    quint64 nextEmittedID = 0;                                  // the ID of the next request to be emitted
 };
 } // namespace Extensions
 #endif // COMPANIONSERVER_HPP
@@ -17,26 +17,46 @@
 #include "LanguageServer.hpp"
 #include "Core/EventLogger.hpp"
 #include "Core/MessageLogger.hpp"
+#include "Util/FileUtil.hpp"
 #include "Util/Util.hpp"
 #include "generated/SettingsHelper.hpp"
 #include <LSPClient.hpp>
+#include <QDateTime>
 #include <QDir>
 #include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QStandardPaths>
+#include <QTextBlock>
+#include <QUrl>
 
 namespace Extensions
 {
+// too many small changes are sent as the full text, which is cheaper for the server to apply
+static const int MAX_INCREMENTAL_CHANGES = 1000;
+// the least recently activated document is closed when there are too many documents, to limit the server's memory
+static const int MAX_OPEN_DOCUMENTS = 32;
+// the documents in the workspace which are not opened for a long time are removed
+static const int WORKSPACE_DOCUMENT_DAYS = 30;
+// the weight of a new sample in the moving averages of the adaptive delay
+static const double LATENCY_SMOOTHING = 0.2;
+// a longer interval between two edits is a pause in typing, not a part of the typing speed
+static const int MAX_TYPING_INTERVAL = 2000;
+// the adaptive delay is never shorter than this, so that a fast typist doesn't flood the server
+static const int MIN_ADAPTIVE_DELAY = 100;
 
 LanguageServer::LanguageServer(QString lang)
 {
     LOG_INFO(INFO_OF(lang));
     this->language = lang;
-    if (shouldCreateClient())
+    bool shouldCreate = shouldCreateClient();
+    loadWorkspace();
+    if (shouldCreate)
     {
         createClient();
         performConnection();
     }
+    SettingsHelper::onChanged(SettingKey::CppCompileCommand, this, [this] { writeCompileCommands(); });
 }
 
 LanguageServer::~LanguageServer()
@@ -52,63 +72,133 @@ LanguageServer::~LanguageServer()
 
 void LanguageServer::openDocument(QString path, QCodeEditor *editor, MessageLogger *log)
 {
-    if (isDocumentOpen())
+    if (isDocumentOpen(editor))
     {
-        LOG_WARN("openDocument called without closing the previous document. Closing it now");
-        closeDocument();
+        LOG_WARN("The document is already open, activating it instead");
+        updatePath(editor, path);
+        activateDocument(editor);
+        return;
     }
 
-    m_editor = editor;
-    openFile = path;
-    logger = log;
-
-    if (lsp == nullptr)
-        return;
+    if (documents.size() >= MAX_OPEN_DOCUMENTS)
+        closeLeastRecentlyActivated();
 
-    if (!isInitialized)
+    // the document is written to the disk too, so that the server can index it in the background
+    Util::saveFile(path, editor->toPlainText(), "Language Server", false, nullptr, true);
+    if (isClangd() && !compileCommandsPaths.contains(path))
     {
-        initializeLSP(path);
-        isInitialized = true;
+        compileCommandsPaths.push_back(path);
+        writeCompileCommands();
     }
 
-    std::string uri = "file://" + path.toStdString();
-    std::string code = m_editor->toPlainText().toStdString();
-    std::string lang = language.toStdString();
+    Document document;
+    document.path = path;
+    document.textDocument = editor->document();
+    document.logger = log;
+    auto &opened = documents[editor] = document;
+
+    connect(editor->document(), SIGNAL(contentsChange(int, int, int)), this, SLOT(onContentsChange(int, int, int)),
+            Qt::UniqueConnection);
+    connect(editor, SIGNAL(destroyed(QObject *)), this, SLOT(onEditorDestroyed(QObject *)), Qt::UniqueConnection);
 
-    lsp->didOpen(uri, code, lang);
+    sendDidOpen(opened);
+    activateDocument(editor);
 }
 
-void LanguageServer::closeDocument()
+void LanguageServer::activateDocument(QCodeEditor *editor)
 {
-    LOG_WARN_IF(!isDocumentOpen(), "Cannot close the document, No document was open");
-    if (!isDocumentOpen())
+    auto it = documents.find(editor);
+    if (it == documents.end())
         return;
+    it->lastActivated = ++activationCount;
+    currentEditor = editor;
+}
 
-    std::string uri = "file://" + openFile.toStdString();
-    lsp->didClose(uri);
+void LanguageServer::closeDocument(QCodeEditor *editor)
+{
+    auto it = documents.find(editor);
+    LOG_WARN_IF(it == documents.end(), "Cannot close the document, the document is not open");
+    if (it == documents.end())
+        return;
+
+    if (lsp != nullptr)
+        lsp->didClose("file://" + it->path.toStdString());
 
-    openFile = "";
-    logger = nullptr;
-    m_editor = nullptr;
+    disconnect(editor->document(), SIGNAL(contentsChange(int, int, int)), this, SLOT(onContentsChange(int, int, int)));
+    disconnect(editor, SIGNAL(destroyed(QObject *)), this, SLOT(onEditorDestroyed(QObject *)));
+    editor->clearSquiggle();
+
+    documents.erase(it);
+    if (currentEditor == editor)
+        currentEditor = nullptr;
 }
 
 void LanguageServer::requestLinting()
 {
-    if (m_editor == nullptr || !isDocumentOpen())
+    if (lsp == nullptr || syncKind == NoSync)
         return;
 
-    std::vector<TextDocumentContentChangeEvent> changes;
-    TextDocumentContentChangeEvent e;
-    e.text = m_editor->toPlainText().toStdString();
-    changes.push_back(e);
+    // the documents of the other tabs may be changed too, e.g. by formatting on auto save
+    for (auto &document : documents)
+    {
+        if (document.isChanged)
+            sendDidChange(document);
+    }
+}
+
+bool LanguageServer::isDocumentOpen(QCodeEditor *editor) const
+{
+    return documents.contains(editor);
+}
+
+QString LanguageServer::getLanguage() const
+{
+    return language;
+}
+
+QMap<QString, LanguageServer::LatencyStats> LanguageServer::getLatencyStats() const
+{
+    return latencyStats;
+}
+
+int LanguageServer::lintingDelay() const
+{
+    int delay;
+    bool adaptive;
+    if (language == "python")
+    {
+        delay = SettingsHelper::getLSPDelayPython();
+        adaptive = SettingsHelper::isLSPAdaptiveDelayPython();
+    }
+    else if (language == "java")
+    {
+        delay = SettingsHelper::getLSPDelayJava();
+        adaptive = SettingsHelper::isLSPAdaptiveDelayJava();
+    }
+    else
+    {
+        delay = SettingsHelper::getLSPDelayCpp();
+        adaptive = SettingsHelper::isLSPAdaptiveDelayCpp();
+    }
+
+    if (!adaptive || typingInterval == 0)
+        return delay;
 
-    std::string uri = "file://" + openFile.toStdString();
-    lsp->didChange(uri, changes, true);
+    // wait for a pause in typing, and don't send the changes much faster than the server can lint them
+    int adaptiveDelay = qRound(qMax(typingInterval * 2, diagnosticsLatency / 2));
+    return qBound(qMin(MIN_ADAPTIVE_DELAY, delay), adaptiveDelay, delay);
 }
 
-bool LanguageServer::isDocumentOpen() const
+QString LanguageServer::documentPath(const QString &key) const
 {
-    return !openFile.isEmpty() && lsp != nullptr;
+    QString suffix;
+    if (language == "python")
+        suffix = Util::pythonSuffix.first();
+    else if (language == "java")
+        suffix = Util::javaSuffix.first();
+    else
+        suffix = Util::cppSuffix.first();
+    return workspacePath() + "/" + key + "/sol." + suffix;
 }
 
 void LanguageServer::updateSettings()
@@ -121,39 +211,50 @@ void LanguageServer::updateSettings()
         delete lsp;
         lsp = nullptr;
     }
+    syncKind = FullSync;
+    isInitialized = false;
+    pendingRequests.clear();
+    diagnosticsLatency = 0;
 
-    if (m_editor != nullptr)
-        m_editor->clearSquiggle();
+    for (auto it = documents.begin(); it != documents.end(); ++it)
+        it.key()->clearSquiggle();
 
     if (shouldCreateClient())
     {
         createClient();
-
         performConnection();
-        initializeLSP(openFile);
 
         LOG_INFO("Recreated Language server Process");
-        if (m_editor != nullptr)
+
+        // the current document is opened first, so that its diagnostics come first
+        if (documents.contains(currentEditor))
+            sendDidOpen(documents[currentEditor]);
+        for (auto it = documents.begin(); it != documents.end(); ++it)
         {
-            auto tmp_editor = m_editor;
-            auto tmp_path = openFile;
-            auto tmp_log = logger;
-            if (isDocumentOpen())
-                closeDocument();
-            openDocument(tmp_path, tmp_editor, tmp_log);
-            LOG_INFO("Reopened document after restart");
+            if (it.key() != currentEditor)
+                sendDidOpen(it.value());
         }
+        LOG_INFO("Reopened " << documents.size() << " documents after restart");
     }
 }
 
-void LanguageServer::updatePath(QString newPath)
+void LanguageServer::updatePath(QCodeEditor *editor, QString newPath)
 {
-    if (lsp == nullptr || (openFile == newPath))
+    auto it = documents.find(editor);
+    if (it == documents.end() || it->path == newPath)
         return;
-    auto tmp_logger = logger;
-    auto tmp_editor = m_editor;
-    closeDocument();
-    openDocument(newPath, tmp_editor, tmp_logger);
+    if (lsp != nullptr)
+        lsp->didClose("file://" + it->path.toStdString());
+    editor->clearSquiggle();
+    it->path = newPath;
+    // the new path is written and compiled like a newly opened document
+    Util::saveFile(newPath, editor->toPlainText(), "Language Server", false, nullptr, true);
+    if (isClangd() && !compileCommandsPaths.contains(newPath))
+    {
+        compileCommandsPaths.push_back(newPath);
+        writeCompileCommands();
+    }
+    sendDidOpen(it.value());
 }
 
 // Private methods
@@ -187,6 +288,24 @@ void LanguageServer::createClient()
     if (!lspArgJava.isEmpty())
         argListJava = Util::splitArgument(lspArgJava);
 
+    if (isClangd())
+    {
+        // the compile flags are read from the workspace, and the index and the preambles are kept on the disk
+        writeCompileCommands();
+        QStringList defaultArgs = {"--compile-commands-dir=" + workspacePath(), "--background-index",
+                                   "--pch-storage=disk"};
+        for (const auto &arg : defaultArgs)
+        {
+            // the arguments set by the user are not overridden
+            auto option = arg.section('=', 0, 0);
+            bool isSet = false;
+            for (const auto &userArg : argListCpp)
+                isSet = isSet || userArg.startsWith(option);
+            if (!isSet)
+                argListCpp.push_back(arg);
+        }
+    }
+
     if (language == "python")
         lsp = new LSPClient(SettingsHelper::getLSPPathPython(), argListPython);
     else if (language == "java")
@@ -235,15 +354,202 @@ void LanguageServer::initializeLSP(QString filePath)
     QFileInfo info(filePath);
     std::string uri = "file://" + info.absoluteDir().absolutePath().toStdString();
     option<DocumentUri> rootUri(uri);
+    startRequest("initialize");
     lsp->initialize(rootUri);
 }
+
+bool LanguageServer::isClangd() const
+{
+    return language == "cpp" && QFileInfo(SettingsHelper::getLSPPathCpp()).baseName().startsWith("clangd");
+}
+
+QString LanguageServer::workspacePath() const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/lsp/" + language;
+}
+
+void LanguageServer::writeCompileCommands()
+{
+    if (!isClangd())
+        return;
+
+    // the source file is appended to the compile command, like what the compiler does
+    auto arguments = Util::splitArgument(SettingsHelper::getCppCompileCommand().trimmed());
+    QJsonArray commands;
+    for (const auto &path : compileCommandsPaths)
+    {
+        QJsonObject command;
+        command["directory"] = QFileInfo(path).absolutePath();
+        command["file"] = path;
+        command["arguments"] = QJsonArray::fromStringList(arguments + QStringList{path});
+        commands.append(command);
+    }
+    Util::saveFile(workspacePath() + "/compile_commands.json", QJsonDocument(commands).toJson(), "Language Server",
+                   false, nullptr, true);
+}
+
+void LanguageServer::loadWorkspace()
+{
+    // each tab has a directory in the workspace, whose name is stable across sessions
+    QDir workspace(workspacePath());
+    auto expiry = QDateTime::currentDateTime().addDays(-WORKSPACE_DOCUMENT_DAYS);
+    for (const auto &key : workspace.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+    {
+        if (key.startsWith('.')) // the caches of the server, e.g. .cache of clangd
+            continue;
+        auto path = documentPath(key);
+        QFileInfo info(path);
+        if (!info.exists() || info.lastModified() < expiry)
+        {
+            LOG_INFO("Removing the old document " << key);
+            QDir(workspace.filePath(key)).removeRecursively();
+        }
+        else
+        {
+            compileCommandsPaths.push_back(path);
+        }
+    }
+}
+
+void LanguageServer::sendDidOpen(Document &document)
+{
+    if (lsp == nullptr)
+        return;
+
+    if (!isInitialized)
+    {
+        initializeLSP(document.path);
+        isInitialized = true;
+    }
+
+    document.trackedText = document.textDocument->toPlainText();
+    document.version = 0;
+    document.changes.clear();
+    document.changesLength = 0;
+    document.isChanged = false;
+
+    lsp->didOpen("file://" + document.path.toStdString(), document.trackedText.toStdString(),
+                 language.toStdString());
+    document.pendingRoundTrip = "didOpen";
+    document.pendingTimer.start();
+}
+
+void LanguageServer::sendDidChange(Document &document)
+{
+    std::vector<TextDocumentContentChangeEvent> events;
+    if (syncKind == IncrementalSync && document.changes.size() <= MAX_INCREMENTAL_CHANGES &&
+        document.changesLength < document.trackedText.length())
+    {
+        for (const auto &change : document.changes)
+        {
+            Range range;
+            range.start.line = change.startLine;
+            range.start.character = change.startCharacter;
+            range.end.line = change.endLine;
+            range.end.character = change.endCharacter;
+            TextDocumentContentChangeEvent e;
+            e.range = range;
+            e.text = change.text.toStdString();
+            events.push_back(e);
+        }
+    }
+    else
+    {
+        // the full text is taken from the editor, so that it's always in sync after a full sync
+        document.trackedText = document.textDocument->toPlainText();
+        TextDocumentContentChangeEvent e;
+        e.text = document.trackedText.toStdString();
+        events.push_back(e);
+    }
+    document.changes.clear();
+    document.changesLength = 0;
+    document.isChanged = false;
+
+    // didChange() of LSPClient doesn't set the version, but the versions should increase with each change
+    json params = {
+        {"textDocument", {{"uri", "file://" + document.path.toStdString()}, {"version", ++document.version}}},
+        {"contentChanges", events},
+        {"wantDiagnostics", true}};
+    lsp->sendNotification("textDocument/didChange", params);
+    // only the latest change is measured, the server usually drops the diagnostics of the older versions
+    document.pendingRoundTrip = "didChange";
+    document.pendingTimer.start();
+}
+
+void LanguageServer::closeLeastRecentlyActivated()
+{
+    QCodeEditor *editor = nullptr;
+    quint64 lastActivated = 0;
+    for (auto it = documents.begin(); it != documents.end(); ++it)
+    {
+        if (it.key() != currentEditor && (editor == nullptr || it->lastActivated < lastActivated))
+        {
+            editor = it.key();
+            lastActivated = it->lastActivated;
+        }
+    }
+    if (editor != nullptr)
+    {
+        LOG_INFO("Too many open documents, closing " << documents[editor].path);
+        closeDocument(editor);
+    }
+}
+
+QCodeEditor *LanguageServer::editorOf(const QString &uri) const
+{
+    // the server may encode the uri in another way, so the local files are compared
+    auto file = QUrl(uri).toLocalFile();
+    for (auto it = documents.begin(); it != documents.end(); ++it)
+    {
+        if (QUrl("file://" + it->path).toLocalFile() == file)
+            return it.key();
+    }
+    return nullptr;
+}
+
+MessageLogger *LanguageServer::currentLogger() const
+{
+    auto it = documents.find(currentEditor);
+    return it == documents.end() ? nullptr : it->logger;
+}
+
+void LanguageServer::startRequest(const QString &method)
+{
+    QElapsedTimer timer;
+    timer.start();
+    pendingRequests.enqueue(qMakePair(method, timer));
+}
+
+void LanguageServer::recordLatency(const QString &roundTrip, qint64 latency)
+{
+    auto &stats = latencyStats[roundTrip];
+    stats.count++;
+    stats.last = latency;
+    stats.total += latency;
+    stats.max = qMax(stats.max, latency);
+    LOG_INFO(INFO_OF(language) << INFO_OF(roundTrip) << INFO_OF(latency) << INFO_OF(lintingDelay()));
+    emit latencyMeasured();
+}
 // ---------------------------- LSP SLOTS ------------------------
 
 void LanguageServer::onLSPServerNotificationArrived(QString method, QJsonObject param)
 {
-    if (method == "textDocument/publishDiagnostics" && m_editor != nullptr) // Linting
+    if (method == "textDocument/publishDiagnostics") // Linting
     {
-        m_editor->clearSquiggle();
+        // the diagnostics of all open documents arrive here, they are shown in the editor of the document
+        auto editor = editorOf(param["uri"].toString());
+        if (editor == nullptr)
+            return;
+        auto &document = documents[editor];
+        if (!document.pendingRoundTrip.isEmpty())
+        {
+            auto latency = document.pendingTimer.elapsed();
+            if (document.pendingRoundTrip == "didChange")
+                diagnosticsLatency += (latency - diagnosticsLatency) * LATENCY_SMOOTHING;
+            recordLatency(document.pendingRoundTrip + " -> publishDiagnostics", latency);
+            document.pendingRoundTrip.clear();
+        }
+        editor->clearSquiggle();
         QJsonArray doc = QJsonDocument::fromVariant(param.toVariantMap()).object()["diagnostics"].toArray();
         for (auto e : doc)
         {
@@ -261,8 +567,8 @@ void LanguageServer::onLSPServerNotificationArrived(QString method, QJsonObject
             stop.first = end["line"].toInt() + 1;
             stop.second = end["character"].toInt();
 
-            m_editor->squiggle(level, start, stop,
-                               tooltip.remove(" (fix available)")); // We do not provide quick fix so remove this text.
+            editor->squiggle(level, start, stop,
+                             tooltip.remove(" (fix available)")); // We do not provide quick fix so remove this text.
         }
     }
 }
@@ -270,6 +576,93 @@ void LanguageServer::onLSPServerNotificationArrived(QString method, QJsonObject
 void LanguageServer::onLSPServerResponseArrived(QJsonObject method, QJsonObject param)
 {
     LOG_INFO("Response from Server has arrived");
+
+    // LSPClient doesn't tell the method of a response, but there are only a few requests and they are answered in order
+    if (!pendingRequests.isEmpty())
+    {
+        auto request = pendingRequests.dequeue();
+        recordLatency(request.first, request.second.elapsed());
+    }
+
+    // the response of initialize, textDocumentSync is either a TextDocumentSyncKind or TextDocumentSyncOptions
+    if (param.contains("capabilities"))
+    {
+        auto sync = param["capabilities"].toObject()["textDocumentSync"];
+        int kind = sync.isObject() ? sync.toObject()["change"].toInt(FullSync) : sync.toInt(FullSync);
+        syncKind = kind == IncrementalSync ? IncrementalSync : kind == NoSync ? NoSync : FullSync;
+        LOG_INFO(INFO_OF(language) << INFO_OF(syncKind));
+    }
+}
+
+void LanguageServer::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    if (lsp == nullptr)
+        return;
+
+    auto textDocument = qobject_cast<QTextDocument *>(sender());
+    auto it = documents.begin();
+    while (it != documents.end() && it->textDocument != textDocument)
+        ++it;
+    if (it == documents.end())
+        return;
+    auto &document = it.value();
+
+    if (position > document.trackedText.length())
+    {
+        // it's out of sync somehow, fall back to full sync until the next didChange
+        document.trackedText = textDocument->toPlainText();
+        document.changesLength = document.trackedText.length();
+        document.isChanged = true;
+        return;
+    }
+
+    // the counts may include the paragraph separator at the end of the document, which is not in the plain text
+    charsRemoved = qBound(0, charsRemoved, document.trackedText.length() - position);
+    QTextCursor cursor(textDocument);
+    cursor.setPosition(position);
+    cursor.setPosition(qMin(position + charsAdded, textDocument->characterCount() - 1), QTextCursor::KeepAnchor);
+    auto text = cursor.selectedText().replace(QChar::ParagraphSeparator, '\n');
+    auto removedText = document.trackedText.mid(position, charsRemoved);
+
+    // only the formats are changed, e.g. by the highlighter
+    if (removedText == text)
+        return;
+
+    // the text before the change is not changed, so the start position is the same in the old text
+    Change change;
+    auto block = textDocument->findBlock(position);
+    change.startLine = block.blockNumber();
+    change.startCharacter = position - block.position();
+    int lastNewLine = removedText.lastIndexOf('\n');
+    change.endLine = change.startLine + removedText.count('\n');
+    change.endCharacter = lastNewLine == -1 ? change.startCharacter + charsRemoved : charsRemoved - lastNewLine - 1;
+    change.text = text;
+
+    document.trackedText.replace(position, charsRemoved, text);
+    document.changes.push_back(change);
+    document.changesLength += text.length();
+    document.isChanged = true;
+
+    if (typingTimer.isValid() && typingTimer.elapsed() < MAX_TYPING_INTERVAL)
+        typingInterval += (typingTimer.elapsed() - typingInterval) * LATENCY_SMOOTHING;
+    typingTimer.start();
+}
+
+void LanguageServer::onEditorDestroyed(QObject *object)
+{
+    // a tab is closed or turned into a placeholder without closing the document, the editor can't be used any more
+    for (auto it = documents.begin(); it != documents.end(); ++it)
+    {
+        if (it.key() == object)
+        {
+            if (lsp != nullptr)
+                lsp->didClose("file://" + it->path.toStdString());
+            if (currentEditor == it.key())
+                currentEditor = nullptr;
+            documents.erase(it);
+            return;
+        }
+    }
 }
 
 void LanguageServer::onLSPServerRequestArrived(QString method, QJsonObject param, QJsonObject id)
@@ -286,6 +679,7 @@ void LanguageServer::onLSPServerErrorArrived(QJsonObject id, QJsonObject error)
     LOG_ERR("ID is \n" << ID);
     LOG_ERR("ERR is \n" << ERR);
 
+    auto logger = currentLogger();
     if (logger != nullptr)
         logger->error("Langauge Server [" + language + "]",
                       "Language server sent an error. Please check log for details.");
@@ -295,6 +689,7 @@ void LanguageServer::onLSPServerProcessError(QProcess::ProcessError error)
 {
     LOG_WARN_IF(error == QProcess::Crashed, "LSP Process errored out " << INFO_OF(error));
     LOG_ERR_IF(error != QProcess::Crashed, "LSP Process errored out " << INFO_OF(error));
+    auto logger = currentLogger();
     if (logger == nullptr)
         return;
     switch (error)
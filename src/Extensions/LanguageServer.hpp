@@ -19,8 +19,11 @@
 #define LANGUAGE_SERVER_H
 
 #include <QCodeEditor>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QJsonObject>
 #include <QProcess>
+#include <QQueue>
 
 class MessageLogger;
 class LSPClient;
@@ -32,17 +35,33 @@ class LanguageServer : public QObject
     Q_OBJECT
 
   public:
+    // the measured latencies of a kind of round trip, in milliseconds
+    struct LatencyStats
+    {
+        int count = 0;
+        qint64 last = 0, total = 0, max = 0;
+    };
+
     explicit LanguageServer(QString language);
     ~LanguageServer();
 
     void openDocument(QString path, QCodeEditor *editor, MessageLogger *logger);
-    void closeDocument();
+    void activateDocument(QCodeEditor *editor);
+    void closeDocument(QCodeEditor *editor);
     void requestLinting();
 
-    bool isDocumentOpen() const;
+    bool isDocumentOpen(QCodeEditor *editor) const;
+    QString documentPath(const QString &key) const;
+
+    QString getLanguage() const;
+    QMap<QString, LatencyStats> getLatencyStats() const;
+    int lintingDelay() const;
 
     void updateSettings();
-    void updatePath(QString);
+    void updatePath(QCodeEditor *editor, QString path);
+
+  signals:
+    void latencyMeasured();
 
   private slots:
     void onLSPServerNotificationArrived(QString method, QJsonObject param);
@@ -52,21 +71,75 @@ class LanguageServer : public QObject
     void onLSPServerProcessError(QProcess::ProcessError error);
     void onLSPServerProcessFinished(int exitCode, QProcess::ExitStatus status);
     void onLSPServerNewStderr(const QString &content);
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void onEditorDestroyed(QObject *object);
 
   private:
+    // the values of TextDocumentSyncKind
+    enum SyncKind
+    {
+        NoSync = 0,
+        FullSync = 1,
+        IncrementalSync = 2
+    };
+
+    // a TextDocumentContentChangeEvent with a range, the positions are in the text before the change
+    struct Change
+    {
+        int startLine, startCharacter, endLine, endCharacter;
+        QString text;
+    };
+
+    // a document opened in the server, each tab has its own document, and all of them are kept open
+    struct Document
+    {
+        QString path;                          // the uri is "file://" + path
+        QTextDocument *textDocument = nullptr; // the document of the editor, whose changes are tracked
+        MessageLogger *logger = nullptr;       // the logger of the tab
+        int version = 0;                       // the version of the document, increased by every didChange
+        QString trackedText;                   // the text of the document after the tracked changes
+        QVector<Change> changes;               // the changes since the last didChange
+        int changesLength = 0;                 // the total length of the texts of the changes
+        bool isChanged = false;                // whether the document is changed since the last didChange
+        quint64 lastActivated = 0;             // the least recently activated document is closed first
+        QString pendingRoundTrip;              // the round trip waiting for the diagnostics, e.g. "didChange"
+        QElapsedTimer pendingTimer;            // started when the round trip is started
+    };
+
     void performConnection();
     void createClient();
     bool shouldCreateClient();
 
     QCodeEditor::SeverityLevel lspSeverity(int a);
     void initializeLSP(QString url);
+    bool isClangd() const;
+    QString workspacePath() const;
+    void writeCompileCommands();
+    void loadWorkspace();
+    void sendDidOpen(Document &document);
+    void sendDidChange(Document &document);
+    void closeLeastRecentlyActivated();
+    QCodeEditor *editorOf(const QString &uri) const;
+    MessageLogger *currentLogger() const;
+    void startRequest(const QString &method);
+    void recordLatency(const QString &roundTrip, qint64 latency);
 
-    QCodeEditor *m_editor = nullptr;
-    MessageLogger *logger = nullptr;
     LSPClient *lsp = nullptr;
     bool isInitialized = false;
     QString language;
-    QString openFile;
+
+    SyncKind syncKind = FullSync; // how the server wants the changes, it's full sync until the server tells
+
+    QHash<QCodeEditor *, Document> documents; // the open documents of all tabs
+    QCodeEditor *currentEditor = nullptr;     // the editor of the current tab, its logger shows the errors
+    quint64 activationCount = 0;              // the number of activations, used as the time of activations
+    QStringList compileCommandsPaths;         // the files in compile_commands.json of the workspace
+
+    QMap<QString, LatencyStats> latencyStats;               // the stats of each kind of round trip
+    QQueue<QPair<QString, QElapsedTimer>> pendingRequests; // the requests waiting for the responses, in order
+    double diagnosticsLatency = 0;                          // the moving average of didChange -> publishDiagnostics
+    double typingInterval = 0;                              // the moving average of the intervals between edits
+    QElapsedTimer typingTimer;                              // started at the last edit
 };
 } // namespace Extensions
 
@@ -122,26 +122,31 @@ PreferencesWindow::PreferencesWindow(QWidget *parent) : QMainWindow(parent)
 
     addPage("Actions/General", {"Hot Exit/Enable"});
 
-    addPage("Actions/Save", {"Auto Save", "Save Faster", "Auto Format", "Save File On Compilation",
-                             "Save File On Execution", "Save Tests"});
+    addPage("Actions/Save", {"Auto Save", "Save Faster", "Auto Format", "Auto Format Changed Lines Only",
+                             "Save File On Compilation", "Save File On Execution", "Save Tests"});
 
     addPage("Actions/Bind file and problem", {"Restore Old Problem Url", "Open Old File For Old Problem Url"});
 
     addPage("Extensions/Clang Format", {"Clang Format/Path", "Clang Format/Style"}, false);
 
     addPage("Extensions/Language Server/C++ Server",
-            {/*"LSP/Use Autocomplete C++",*/ "LSP/Use Linting C++", "LSP/Delay C++", "LSP/Path C++", "LSP/Args C++"});
-    addPage("Extensions/Language Server/Java Server", {/*"LSP/Use Autocomplete Java",*/ "LSP/Use Linting Java",
-                                                       "LSP/Delay Java", "LSP/Path Java", "LSP/Args Java"});
-    addPage("Extensions/Language Server/Python Server", {/*"LSP/Use Autocomplete Python",*/ "LSP/Use Linting Python",
-                                                         "LSP/Delay Python", "LSP/Path Python", "LSP/Args Python"});
-
-    addPage("Extensions/Competitive Companion", {"Competitive Companion/Enable", "Competitive Companion/Open New Tab",
-                                                 "Competitive Companion/Connection Port"});
+            {/*"LSP/Use Autocomplete C++",*/ "LSP/Use Linting C++", "LSP/Delay C++", "LSP/Adaptive Delay C++",
+             "LSP/Path C++", "LSP/Args C++"});
+    addPage("Extensions/Language Server/Java Server",
+            {/*"LSP/Use Autocomplete Java",*/ "LSP/Use Linting Java", "LSP/Delay Java", "LSP/Adaptive Delay Java",
+             "LSP/Path Java", "LSP/Args Java"});
+    addPage("Extensions/Language Server/Python Server",
+            {/*"LSP/Use Autocomplete Python",*/ "LSP/Use Linting Python", "LSP/Delay Python",
+             "LSP/Adaptive Delay Python", "LSP/Path Python", "LSP/Args Python"});
+
+    addPage("Extensions/Competitive Companion",
+            {"Competitive Companion/Enable", "Competitive Companion/Open New Tab",
+             "Competitive Companion/Batch Contest", "Competitive Companion/Connection Port"});
 
     addPage("Extensions/CF Tool", {"CF/Path"});
 
-    addPage("File Path/Testcases", {"Input File Save Path", "Answer File Save Path", "Testcases Matching Rules"});
+    addPage("File Path/Testcases", {"Input File Save Path", "Answer File Save Path", "Save Testcases In Archive",
+                                    "Testcase Archive Save Path", "Testcases Matching Rules"});
 
     addPage("File Path/Problem URL", {"Default File Paths For Problem URLs"});
 
@@ -151,8 +156,8 @@ PreferencesWindow::PreferencesWindow(QWidget *parent) : QMainWindow(parent)
     addPage("Advanced/Update", {"Check Update", "Beta"});
 
     addPage("Advanced/Limits",
-            {"Time Limit", "Output Length Limit", "Message Length Limit", "HTML Diff Viewer Length Limit",
-             "Open File Length Limit", "Load Test Case File Length Limit"});
+            {"Time Limit", "Output Length Limit", "Message Length Limit", "Open File Length Limit",
+             "Load Test Case File Length Limit"});
 }
 
 void PreferencesWindow::display()
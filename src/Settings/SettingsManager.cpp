@@ -24,10 +24,13 @@
 #include <QRect>
 #include <QSettings>
 #include <QStandardPaths>
+#include <generated/SettingsHelper.hpp>
 #include <generated/SettingsInfo.hpp>
 
 QVariantMap *SettingsManager::cur = nullptr;
 QVariantMap *SettingsManager::def = nullptr;
+SettingValues *SettingsManager::typed = nullptr;
+QHash<QString, int> *SettingsManager::keyIndexes = nullptr;
 
 static QStringList configFileLocation = {"$AC/cp_editor_settings.ini", "$H/.cp_editor_settings.ini",
                                          "$H/cp_editor_settings.ini"};
@@ -53,10 +56,16 @@ void SettingsManager::init()
 
     cur = new QVariantMap();
     def = new QVariantMap();
+    typed = new SettingValues();
+    keyIndexes = new QHash<QString, int>();
 
     // default settings
-    for (const SettingInfo &si : settingInfo)
-        def->insert(si.name, si.def);
+    for (int i = 0; i < SETTING_COUNT; ++i)
+    {
+        def->insert(settingInfo[i].name, settingInfo[i].def);
+        typed->assign(SettingKey(i), settingInfo[i].def);
+        keyIndexes->insert(settingInfo[i].name, i);
+    }
 
     if (!loadPath.isEmpty())
     {
@@ -98,7 +107,7 @@ void SettingsManager::init()
         }
         setting.endGroup();
 
-        // load editor status
+        // load editor status, it's saved by old versions, now the session is saved in Core::SessionStore
         setting.beginGroup("editor_status");
         for (const QString &index : setting.allKeys())
             set(QString("Editor Status/%1").arg(index), setting.value(index));
@@ -135,20 +144,17 @@ void SettingsManager::deinit()
         setting.setValue(saveKey.replace("Snippets/", "snippets/"), get(key));
     }
 
-    // save editor status
-    for (QString key : keyStartsWith("Editor Status/"))
-    {
-        auto saveKey = key;
-        setting.setValue(saveKey.replace("Editor Status/", "editor_status/"), get(key));
-    }
-
     // save file problem binding
     setting.setValue("file_problem_binding", FileProblemBinder::toVariant());
 
     setting.sync();
     delete cur;
     delete def;
+    delete typed;
+    delete keyIndexes;
     cur = def = nullptr;
+    typed = nullptr;
+    keyIndexes = nullptr;
 
     LOG_INFO("Settings saved");
 }
@@ -178,18 +184,27 @@ bool SettingsManager::contains(const QString &key)
 void SettingsManager::set(const QString &key, QVariant value)
 {
     LOG_INFO(INFO_OF(key) << INFO_OF(value.toString()));
+    auto old = cur->value(key, def->value(key));
     cur->insert(key, value);
+    refresh(key, old);
 }
 
 void SettingsManager::remove(QStringList keys)
 {
     for (const QString &key : keys)
+    {
+        auto old = cur->value(key, def->value(key));
         cur->remove(key);
+        refresh(key, old);
+    }
 }
 
 void SettingsManager::reset()
 {
+    auto old = *cur;
     *cur = *def;
+    for (const SettingInfo &si : settingInfo)
+        refresh(si.name, old.value(si.name, def->value(si.name)));
 }
 
 QStringList SettingsManager::keyStartsWith(const QString &head)
@@ -198,3 +213,21 @@ QStringList SettingsManager::keyStartsWith(const QString &head)
     keys.erase(std::remove_if(keys.begin(), keys.end(), [head](QString s) { return !s.startsWith(head); }), keys.end());
     return keys;
 }
+
+SettingsNotifier *SettingsManager::notifier()
+{
+    static SettingsNotifier instance;
+    return &instance;
+}
+
+void SettingsManager::refresh(const QString &key, const QVariant &old)
+{
+    auto it = keyIndexes->find(key);
+    if (it == keyIndexes->end())
+        return; // the dynamic keys, e.g. the snippets, are only stored in the map
+
+    auto value = cur->value(key, def->value(key));
+    typed->assign(SettingKey(*it), value);
+    if (value != old)
+        emit notifier()->settingChanged(*it);
+}
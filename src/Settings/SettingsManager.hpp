@@ -18,7 +18,20 @@
 #ifndef SETTINGSMANAGER_HPP
 #define SETTINGSMANAGER_HPP
 
+#include <QHash>
 #include <QMetaType>
+#include <QObject>
+
+struct SettingValues;
+
+// emits settingChanged when a setting in settings.json is changed, use SettingsHelper::onChanged to connect to a key
+class SettingsNotifier : public QObject
+{
+    Q_OBJECT
+
+  signals:
+    void settingChanged(int key); // the key is a SettingKey
+};
 
 struct SettingsManager
 {
@@ -33,9 +46,21 @@ struct SettingsManager
 
     static QStringList keyStartsWith(const QString &head);
 
+    static SettingsNotifier *notifier();
+
+    // the typed values of the settings in settings.json, use the getters in SettingsHelper instead of this
+    static const SettingValues &values()
+    {
+        return *typed;
+    }
+
   private:
+    static void refresh(const QString &key, const QVariant &old);
+
     static QVariantMap *cur;
     static QVariantMap *def;
+    static SettingValues *typed;            // the values of cur/def in settings.json, indexed by SettingKey
+    static QHash<QString, int> *keyIndexes; // the SettingKey of each name in settings.json
 };
 
 #endif // SETTINGSMANAGER_HPP
\ No newline at end of file
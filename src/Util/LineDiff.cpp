@@ -0,0 +1,515 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+#include "Util/LineDiff.hpp"
+#include <QAtomicInt>
+#include <QHash>
+#include <algorithm>
+#include <cstring>
+
+namespace Util
+{
+namespace
+{
+const int MAX_EDIT_DISTANCE = 1000;       // a gap with a larger edit distance is shown as changed lines
+const qint64 MAX_MYERS_COST = 50000000LL; // limits (the length of a gap) * (the edit distance) in Myers' algorithm
+const int MAX_TOKENS = 500;               // lines with more tokens are compared as a whole
+const int PREFIX_BLOCK = 1024;            // the number of characters compared by each memcmp
+const int MAX_MISMATCH_TOKEN_LENGTH = 32; // longer tokens in a LineMismatch are elided
+
+QStringList splitLines(const QString &text)
+{
+    auto lines = text.split('\n');
+    if (text.endsWith('\n'))
+        lines.pop_back();
+    for (auto &line : lines)
+    {
+        if (line.endsWith('\r'))
+            line.chop(1);
+    }
+    return lines;
+}
+
+// compute the rows of the diff of two sequences of line ids
+class Differ
+{
+  public:
+    Differ(const QVector<int> &a, const QVector<int> &b, int idCount, const QAtomicInt *canceled)
+        : a(a), b(b), countA(idCount, 0), countB(idCount, 0), positionB(idCount, 0), canceled(canceled)
+    {
+    }
+
+    bool run(QVector<DiffRow> &result)
+    {
+        diff(0, a.size(), 0, b.size());
+        flush();
+        if (isCanceled())
+            return false;
+        result.swap(rows);
+        return true;
+    }
+
+  private:
+    bool isCanceled() const
+    {
+        return canceled != nullptr && canceled->loadAcquire() != 0;
+    }
+
+    void equal(int i, int j)
+    {
+        flush();
+        rows.push_back({DiffRow::Equal, i, j});
+    }
+
+    // the deleted and inserted lines between two equal lines are paired as changed lines
+    void flush()
+    {
+        int paired = qMin(deleted.size(), inserted.size());
+        for (int i = 0; i < paired; ++i)
+            rows.push_back({DiffRow::Changed, deleted[i], inserted[i]});
+        for (int i = paired; i < deleted.size(); ++i)
+            rows.push_back({DiffRow::Deleted, deleted[i], -1});
+        for (int i = paired; i < inserted.size(); ++i)
+            rows.push_back({DiffRow::Inserted, -1, inserted[i]});
+        deleted.clear();
+        inserted.clear();
+    }
+
+    void diff(int aLow, int aHigh, int bLow, int bHigh)
+    {
+        if (isCanceled())
+            return;
+
+        // the common prefix and suffix
+        while (aLow < aHigh && bLow < bHigh && a[aLow] == b[bLow])
+            equal(aLow++, bLow++);
+        int suffix = 0;
+        while (aHigh - suffix > aLow && bHigh - suffix > bLow && a[aHigh - suffix - 1] == b[bHigh - suffix - 1])
+            ++suffix;
+        aHigh -= suffix;
+        bHigh -= suffix;
+
+        if (aLow == aHigh || bLow == bHigh)
+        {
+            for (int i = aLow; i < aHigh; ++i)
+                deleted.push_back(i);
+            for (int j = bLow; j < bHigh; ++j)
+                inserted.push_back(j);
+        }
+        else
+        {
+            auto anchors = uniqueCommonLines(aLow, aHigh, bLow, bHigh);
+            if (!anchors.isEmpty())
+            {
+                for (const auto &anchor : anchors)
+                {
+                    diff(aLow, anchor.first, bLow, anchor.second);
+                    equal(anchor.first, anchor.second);
+                    aLow = anchor.first + 1;
+                    bLow = anchor.second + 1;
+                }
+                diff(aLow, aHigh, bLow, bHigh);
+            }
+            else if (!myers(aLow, aHigh, bLow, bHigh))
+            {
+                for (int i = aLow; i < aHigh; ++i)
+                    deleted.push_back(i);
+                for (int j = bLow; j < bHigh; ++j)
+                    inserted.push_back(j);
+            }
+        }
+
+        for (int i = 0; i < suffix; ++i)
+            equal(aHigh + i, bHigh + i);
+    }
+
+    // the longest increasing sequence of the lines which appear exactly once in both ranges
+    QVector<QPair<int, int>> uniqueCommonLines(int aLow, int aHigh, int bLow, int bHigh)
+    {
+        for (int i = aLow; i < aHigh; ++i)
+            ++countA[a[i]];
+        for (int j = bLow; j < bHigh; ++j)
+        {
+            ++countB[b[j]];
+            positionB[b[j]] = j;
+        }
+
+        QVector<QPair<int, int>> candidates;
+        for (int i = aLow; i < aHigh; ++i)
+        {
+            if (countA[a[i]] == 1 && countB[a[i]] == 1)
+                candidates.push_back({i, positionB[a[i]]});
+        }
+
+        // reset the counters touched, so that they can be used again without clearing all of them
+        for (int i = aLow; i < aHigh; ++i)
+            countA[a[i]] = 0;
+        for (int j = bLow; j < bHigh; ++j)
+            countB[b[j]] = 0;
+
+        // patience sorting, the candidates are already sorted by the positions in a
+        QVector<int> tails, previous(candidates.size(), -1);
+        for (int i = 0; i < candidates.size(); ++i)
+        {
+            int low = 0, high = tails.size();
+            while (low < high)
+            {
+                int mid = (low + high) / 2;
+                if (candidates[tails[mid]].second < candidates[i].second)
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+            if (low > 0)
+                previous[i] = tails[low - 1];
+            if (low == tails.size())
+                tails.push_back(i);
+            else
+                tails[low] = i;
+        }
+
+        QVector<QPair<int, int>> result(tails.size());
+        for (int i = tails.isEmpty() ? -1 : tails.back(), k = tails.size() - 1; i != -1; i = previous[i], --k)
+            result[k] = candidates[i];
+        return result;
+    }
+
+    // Myers' O(ND) algorithm, returns false if the edit distance is too large or it's canceled
+    bool myers(int aLow, int aHigh, int bLow, int bHigh)
+    {
+        const int n = aHigh - aLow, m = bHigh - bLow;
+        const int maxD = int(qMin(qint64(qMin(n + m, MAX_EDIT_DISTANCE)), MAX_MYERS_COST / (n + m)));
+        const int offset = maxD + 1;
+        QVector<int> v(2 * maxD + 3, 0);
+        QVector<QVector<int>> trace;
+
+        for (int d = 0; d <= maxD; ++d)
+        {
+            if (isCanceled())
+                return false;
+            trace.push_back(v);
+            for (int k = -d; k <= d; k += 2)
+            {
+                int x;
+                if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1]))
+                    x = v[offset + k + 1];
+                else
+                    x = v[offset + k - 1] + 1;
+                int y = x - k;
+                while (x < n && y < m && a[aLow + x] == b[bLow + y])
+                    ++x, ++y;
+                v[offset + k] = x;
+                // a point out of the grid never reaches (n, m), so only check the exact end point
+                if (x == n && y == m)
+                {
+                    backtrack(trace, offset, aLow, bLow, n, m);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void backtrack(const QVector<QVector<int>> &trace, int offset, int aLow, int bLow, int x, int y)
+    {
+        // (type, i, j) in the reversed order, type is 0 for equal, 1 for deleted, 2 for inserted
+        struct Edit
+        {
+            int type, i, j;
+        };
+        QVector<Edit> edits;
+
+        for (int d = trace.size() - 1; d >= 0; --d)
+        {
+            const auto &v = trace[d];
+            int k = x - y;
+            int previousK = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) ? k + 1 : k - 1;
+            int previousX = v[offset + previousK];
+            int previousY = previousX - previousK;
+            while (x > previousX && y > previousY)
+            {
+                --x, --y;
+                edits.push_back({0, aLow + x, bLow + y});
+            }
+            if (d > 0)
+            {
+                if (x == previousX)
+                    edits.push_back({2, -1, bLow + previousY});
+                else
+                    edits.push_back({1, aLow + previousX, -1});
+            }
+            x = previousX;
+            y = previousY;
+        }
+
+        for (int i = edits.size() - 1; i >= 0; --i)
+        {
+            if (edits[i].type == 0)
+                equal(edits[i].i, edits[i].j);
+            else if (edits[i].type == 1)
+                deleted.push_back(edits[i].i);
+            else
+                inserted.push_back(edits[i].j);
+        }
+    }
+
+    const QVector<int> &a, &b;
+    QVector<int> countA, countB, positionB; // indexed by line ids, used in uniqueCommonLines
+    QVector<DiffRow> rows;
+    QVector<int> deleted, inserted; // the lines waiting to be paired
+    const QAtomicInt *canceled;
+};
+
+// split a line into tokens, each token is (start, length)
+QVector<QPair<int, int>> tokenize(const QString &line)
+{
+    QVector<QPair<int, int>> tokens;
+    for (int i = 0; i < line.length();)
+    {
+        int j = i + 1;
+        if (line[i].isLetterOrNumber())
+        {
+            while (j < line.length() && line[j].isLetterOrNumber())
+                ++j;
+        }
+        else if (line[i].isSpace())
+        {
+            while (j < line.length() && line[j].isSpace())
+                ++j;
+        }
+        tokens.push_back({i, j - i});
+        i = j;
+    }
+    return tokens;
+}
+
+// the length of the common prefix of two buffers
+int commonPrefix(const QChar *a, int n, const QChar *b, int m)
+{
+    const int length = qMin(n, m);
+    int i = 0;
+    // compare by blocks first, memcmp is vectorized by the C library
+    while (i + PREFIX_BLOCK <= length && memcmp(a + i, b + i, PREFIX_BLOCK * sizeof(QChar)) == 0)
+        i += PREFIX_BLOCK;
+    while (i < length && a[i] == b[i])
+        ++i;
+    return i;
+}
+
+// the position of the '\n' at the end of the line starting at pos, or the length of the text
+int lineEnd(const QChar *text, int length, int pos)
+{
+    return int(std::find(text + pos, text + length, QChar('\n')) - text);
+}
+
+// the length of a line without the trailing spaces, '\r' is also a space
+int trimmedLength(const QChar *line, int length)
+{
+    while (length > 0 && line[length - 1].isSpace())
+        --length;
+    return length;
+}
+
+bool isBlank(const QChar *text, int from, int to)
+{
+    return std::all_of(text + from, text + to, [](QChar c) { return c.isSpace(); });
+}
+
+QString elided(const QChar *text, int length)
+{
+    if (length > MAX_MISMATCH_TOKEN_LENGTH)
+        return QString(text, MAX_MISMATCH_TOKEN_LENGTH) + "...";
+    return QString(text, length);
+}
+
+// the first token separated by spaces in text[from, to), empty if there's no such token
+QString firstToken(const QChar *text, int from, int to)
+{
+    while (from < to && text[from].isSpace())
+        ++from;
+    int end = from;
+    while (end < to && !text[end].isSpace())
+        ++end;
+    return elided(text + from, end - from);
+}
+
+// find the first different token of two different lines
+LineMismatch lineMismatch(int line, const QChar *a, int n, const QChar *b, int m)
+{
+    LineMismatch result;
+    result.line = line;
+
+    int i = 0, j = 0;
+    while (i < n || j < m)
+    {
+        while (i < n && a[i].isSpace())
+            ++i;
+        while (j < m && b[j].isSpace())
+            ++j;
+        int ie = i, je = j;
+        while (ie < n && !a[ie].isSpace())
+            ++ie;
+        while (je < m && !b[je].isSpace())
+            ++je;
+        if (ie - i != je - j || memcmp(a + i, b + j, (ie - i) * sizeof(QChar)) != 0)
+        {
+            result.got = elided(a + i, ie - i);
+            result.expected = elided(b + j, je - j);
+            return result;
+        }
+        i = ie;
+        j = je;
+    }
+
+    // the tokens are the same, the lines are only different in the spaces between them
+    result.got = elided(a, n);
+    result.expected = elided(b, m);
+    return result;
+}
+} // namespace
+
+LineDiff diffLines(const QString &output, const QString &expected, const QAtomicInt *canceled)
+{
+    LineDiff result;
+    result.outputLines = splitLines(output);
+    result.expectedLines = splitLines(expected);
+
+    // compare the lines by ids, so that each line is hashed only once
+    QHash<QString, int> ids;
+    QVector<int> a, b;
+    a.reserve(result.outputLines.size());
+    b.reserve(result.expectedLines.size());
+    for (const auto &line : result.outputLines)
+    {
+        a.push_back(ids.insert(line, ids.value(line, ids.size())).value());
+        result.maxLineLength = qMax(result.maxLineLength, line.length());
+    }
+    for (const auto &line : result.expectedLines)
+    {
+        b.push_back(ids.insert(line, ids.value(line, ids.size())).value());
+        result.maxLineLength = qMax(result.maxLineLength, line.length());
+    }
+
+    Differ differ(a, b, ids.size(), canceled);
+    if (!differ.run(result.rows))
+        return LineDiff();
+
+    for (const auto &row : result.rows)
+    {
+        if (row.type != DiffRow::Equal)
+            ++result.differentRows;
+    }
+
+    return result;
+}
+
+QPair<QVector<QPair<int, int>>, QVector<QPair<int, int>>> diffTokens(const QString &output, const QString &expected)
+{
+    auto outputTokens = tokenize(output);
+    auto expectedTokens = tokenize(expected);
+    const int n = outputTokens.size(), m = expectedTokens.size();
+
+    if (n > MAX_TOKENS || m > MAX_TOKENS)
+        return {{{0, output.length()}}, {{0, expected.length()}}};
+
+    auto same = [&](int i, int j) {
+        return output.midRef(outputTokens[i].first, outputTokens[i].second) ==
+               expected.midRef(expectedTokens[j].first, expectedTokens[j].second);
+    };
+
+    // the longest common subsequence of the tokens, lcs[i][j] is for the suffixes starting at i and j
+    QVector<int> lcs((n + 1) * (m + 1), 0);
+    for (int i = n - 1; i >= 0; --i)
+    {
+        for (int j = m - 1; j >= 0; --j)
+        {
+            if (same(i, j))
+                lcs[i * (m + 1) + j] = lcs[(i + 1) * (m + 1) + j + 1] + 1;
+            else
+                lcs[i * (m + 1) + j] = qMax(lcs[(i + 1) * (m + 1) + j], lcs[i * (m + 1) + j + 1]);
+        }
+    }
+
+    QPair<QVector<QPair<int, int>>, QVector<QPair<int, int>>> result;
+    // add a token to the ranges, merge it with the previous range if they are adjacent
+    auto add = [](QVector<QPair<int, int>> &ranges, const QPair<int, int> &token) {
+        if (!ranges.isEmpty() && ranges.back().first + ranges.back().second == token.first)
+            ranges.back().second += token.second;
+        else
+            ranges.push_back(token);
+    };
+
+    int i = 0, j = 0;
+    while (i < n || j < m)
+    {
+        if (i < n && j < m && same(i, j))
+            ++i, ++j;
+        else if (j == m || (i < n && lcs[(i + 1) * (m + 1) + j] >= lcs[i * (m + 1) + j + 1]))
+            add(result.first, outputTokens[i++]);
+        else
+            add(result.second, expectedTokens[j++]);
+    }
+
+    return result;
+}
+
+QVector<LineMismatch> firstMismatches(const QString &output, const QString &expected, int maxCount)
+{
+    QVector<LineMismatch> result;
+    const QChar *a = output.constData(), *b = expected.constData();
+    const int n = output.length(), m = expected.length();
+    int i = 0, j = 0, line = 0;
+
+    while (result.size() < maxCount)
+    {
+        // skip the identical part, and go back to the start of the line which contains the first different character
+        int prefix = commonPrefix(a + i, n - i, b + j, m - j);
+        while (prefix > 0 && a[i + prefix - 1] != '\n')
+            --prefix;
+        line += int(std::count(a + i, a + i + prefix, QChar('\n')));
+        i += prefix;
+        j += prefix;
+
+        if (i == n || j == m)
+        {
+            // the trailing empty lines are ignored
+            if (isBlank(a, i, n) && isBlank(b, j, m))
+                break;
+            LineMismatch mismatch;
+            mismatch.line = line;
+            mismatch.got = firstToken(a, i, n);
+            mismatch.expected = firstToken(b, j, m);
+            mismatch.outputEnded = i == n;
+            mismatch.expectedEnded = j == m;
+            result.push_back(mismatch);
+            break;
+        }
+
+        const int outputEnd = lineEnd(a, n, i), expectedEnd = lineEnd(b, m, j);
+        const int outputLength = trimmedLength(a + i, outputEnd - i);
+        const int expectedLength = trimmedLength(b + j, expectedEnd - j);
+        if (outputLength != expectedLength || memcmp(a + i, b + j, outputLength * sizeof(QChar)) != 0)
+            result.push_back(lineMismatch(line, a + i, outputLength, b + j, expectedLength));
+
+        i = qMin(outputEnd + 1, n);
+        j = qMin(expectedEnd + 1, m);
+        ++line;
+    }
+
+    return result;
+}
+} // namespace Util
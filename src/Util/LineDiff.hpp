@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+#ifndef LINEDIFF_HPP
+#define LINEDIFF_HPP
+
+#include <QPair>
+#include <QStringList>
+#include <QVector>
+
+class QAtomicInt;
+
+namespace Util
+{
+// a row in a side-by-side diff
+struct DiffRow
+{
+    enum Type
+    {
+        Equal,    // the lines are the same
+        Changed,  // the lines are different, the tokens can be compared by diffTokens
+        Deleted,  // there's only an output line
+        Inserted, // there's only an expected line
+    };
+
+    Type type;
+    int outputLine;   // the index of the output line, -1 for Inserted
+    int expectedLine; // the index of the expected line, -1 for Deleted
+};
+
+// the result of diffLines
+struct LineDiff
+{
+    QStringList outputLines, expectedLines;
+    QVector<DiffRow> rows;
+    int maxLineLength = 0; // the length of the longest line
+    int differentRows = 0; // the number of rows which are not Equal
+};
+
+// a line which is different in the output and the expected output, found by firstMismatches
+struct LineMismatch
+{
+    int line;                   // the index of the line
+    QString got;                // the first different token in the output, empty if it's the end of the line
+    QString expected;           // the first different token in the expected output, empty if it's the end of the line
+    bool outputEnded = false;   // whether the output has fewer lines
+    bool expectedEnded = false; // whether the expected output has fewer lines
+};
+
+/**
+ * @brief compute a line-level diff of two texts
+ * @param output the output text, shown on the left
+ * @param expected the expected text, shown on the right
+ * @param canceled the computation stops as soon as possible when it becomes non-zero, it can be nullptr
+ * @returns the rows of the side-by-side diff, the rows are empty if it's canceled
+ * @note It's a patience diff, the gaps between the unique common lines are compared by Myers' algorithm.
+ *       A gap which is too different is shown as changed lines instead of finding the shortest edit script.
+ *       It doesn't touch any global state, so it's safe to call it in a worker thread.
+ */
+LineDiff diffLines(const QString &output, const QString &expected, const QAtomicInt *canceled = nullptr);
+
+/**
+ * @brief find the different tokens of two lines
+ * @param output the output line
+ * @param expected the expected line
+ * @returns the ranges (start, length) of the different parts in the output line and the expected line
+ * @note A token is a run of letters/digits, a run of blanks or a single other character.
+ *       The whole lines are different if they have too many tokens.
+ */
+QPair<QVector<QPair<int, int>>, QVector<QPair<int, int>>> diffTokens(const QString &output, const QString &expected);
+
+/**
+ * @brief find the first lines which are different in the output and the expected output
+ * @param output the output text
+ * @param expected the expected text
+ * @param maxCount the maximum number of mismatches to find
+ * @returns the mismatches in the order of the lines
+ * @note The lines are compared at the same index, without aligning them like diffLines does.
+ *       Like the checker ignoring trailing spaces, the trailing spaces and the trailing empty lines are ignored.
+ *       It takes linear time and constant extra memory, the identical parts are skipped by memcmp.
+ */
+QVector<LineMismatch> firstMismatches(const QString &output, const QString &expected, int maxCount);
+} // namespace Util
+
+#endif // LINEDIFF_HPP
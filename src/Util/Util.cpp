@@ -16,6 +16,7 @@
  */
 
 #include "Util/Util.hpp"
+#include <QCryptographicHash>
 #include <QPalette>
 
 namespace Util
@@ -143,4 +144,10 @@ QStringList splitArgument(QString arg)
     return result;
 }
 
+QByteArray textHash(const QString &text)
+{
+    auto bytes = QByteArray::fromRawData(reinterpret_cast<const char *>(text.constData()), text.length() * 2);
+    return QCryptographicHash::hash(bytes, QCryptographicHash::Md5);
+}
+
 } // namespace Util
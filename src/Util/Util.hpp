@@ -31,6 +31,9 @@ QPalette windowsDarkThemePalette();
 
 QStringList splitArgument(QString);
 
+// the MD5 of the UTF-16 data of a text, used to check whether a text is changed without keeping a copy of it
+QByteArray textHash(const QString &text);
+
 } // namespace Util
 
 #endif // UTIL_HPP
@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+#include "Widgets/DiffView.hpp"
+#include <QFontDatabase>
+#include <QPainter>
+#include <QScrollBar>
+
+namespace Widgets
+{
+// the colors are translucent, so that they work with both light and dark themes
+static const QColor DELETED_LINE_COLOR(255, 0, 0, 40);
+static const QColor DELETED_TOKEN_COLOR(255, 0, 0, 110);
+static const QColor INSERTED_LINE_COLOR(0, 200, 0, 40);
+static const QColor INSERTED_TOKEN_COLOR(0, 200, 0, 110);
+static const QColor MISSING_LINE_COLOR(128, 128, 128, 40);
+static const int MAX_CACHED_ROWS = 10000;
+
+DiffView::DiffView(QWidget *parent) : QAbstractScrollArea(parent)
+{
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    // both scroll bars are in characters, a vertical step is a row and a horizontal step is a column
+    verticalScrollBar()->setSingleStep(1);
+    horizontalScrollBar()->setSingleStep(1);
+}
+
+void DiffView::setDiff(const QSharedPointer<const Util::LineDiff> &newDiff)
+{
+    diff = newDiff;
+    tokenCache.clear();
+    updateScrollBars();
+    verticalScrollBar()->setValue(0);
+    horizontalScrollBar()->setValue(0);
+    viewport()->update();
+}
+
+void DiffView::setDisplayEOLN(bool display)
+{
+    displayEOLN = display;
+    viewport()->update();
+}
+
+void DiffView::scrollToRow(int row)
+{
+    verticalScrollBar()->setValue(row);
+}
+
+void DiffView::scrollToLine(int line)
+{
+    if (diff.isNull())
+        return;
+    // the first row which reaches the line on either side
+    for (int row = 0; row < diff->rows.size(); ++row)
+    {
+        if (diff->rows[row].outputLine >= line || diff->rows[row].expectedLine >= line)
+        {
+            scrollToRow(row);
+            return;
+        }
+    }
+    scrollToRow(diff->rows.size());
+}
+
+int DiffView::firstVisibleRow() const
+{
+    return verticalScrollBar()->value();
+}
+
+void DiffView::paintEvent(QPaintEvent *)
+{
+    QPainter painter(viewport());
+    if (diff.isNull())
+        return;
+
+    const int height = rowHeight();
+    const int halfWidth = viewport()->width() / 2;
+    const int first = verticalScrollBar()->value();
+    const int last = qMin(diff->rows.size(), first + viewport()->height() / height + 2);
+
+    for (int row = first; row < last; ++row)
+    {
+        const auto &diffRow = diff->rows[row];
+        const int y = (row - first) * height;
+        const QRect left(0, y, halfWidth, height), right(halfWidth, y, viewport()->width() - halfWidth, height);
+
+        static const QVector<QPair<int, int>> noTokens;
+
+        switch (diffRow.type)
+        {
+        case Util::DiffRow::Equal:
+            paintLine(painter, left, diffRow.outputLine, diff->outputLines[diffRow.outputLine], QColor(), noTokens,
+                      QColor());
+            paintLine(painter, right, diffRow.expectedLine, diff->expectedLines[diffRow.expectedLine], QColor(),
+                      noTokens, QColor());
+            break;
+        case Util::DiffRow::Changed:
+        {
+            const auto &tokens = tokensOf(row);
+            paintLine(painter, left, diffRow.outputLine, diff->outputLines[diffRow.outputLine], DELETED_LINE_COLOR,
+                      tokens.first, DELETED_TOKEN_COLOR);
+            paintLine(painter, right, diffRow.expectedLine, diff->expectedLines[diffRow.expectedLine],
+                      INSERTED_LINE_COLOR, tokens.second, INSERTED_TOKEN_COLOR);
+            break;
+        }
+        case Util::DiffRow::Deleted:
+            paintLine(painter, left, diffRow.outputLine, diff->outputLines[diffRow.outputLine], DELETED_LINE_COLOR,
+                      noTokens, QColor());
+            painter.fillRect(right, MISSING_LINE_COLOR);
+            break;
+        case Util::DiffRow::Inserted:
+            painter.fillRect(left, MISSING_LINE_COLOR);
+            paintLine(painter, right, diffRow.expectedLine, diff->expectedLines[diffRow.expectedLine],
+                      INSERTED_LINE_COLOR, noTokens, QColor());
+            break;
+        }
+    }
+
+    painter.setPen(palette().color(QPalette::Mid));
+    painter.drawLine(halfWidth, 0, halfWidth, viewport()->height());
+}
+
+void DiffView::paintLine(QPainter &painter, const QRect &rect, int lineNumber, const QString &line,
+                         const QColor &background, const QVector<QPair<int, int>> &tokens,
+                         const QColor &tokenBackground)
+{
+    painter.save();
+    painter.setClipRect(rect);
+
+    if (background.isValid())
+        painter.fillRect(rect, background);
+
+    // the line number in the gutter
+    const int gutter = gutterWidth();
+    const int width = charWidth();
+    painter.setPen(palette().color(QPalette::Disabled, QPalette::Text));
+    painter.drawText(QRect(rect.left(), rect.top(), gutter - width, rect.height()), Qt::AlignRight | Qt::AlignVCenter,
+                     QString::number(lineNumber + 1));
+
+    // only the visible columns are drawn, the font is monospace so a column is always charWidth() wide
+    const int firstColumn = horizontalScrollBar()->value();
+    const int columns = (rect.width() - gutter) / width + 2;
+    const int textLeft = rect.left() + gutter;
+    painter.setClipRect(QRect(textLeft, rect.top(), rect.width() - gutter, rect.height()));
+
+    for (const auto &token : tokens)
+    {
+        int begin = qMax(token.first, firstColumn), end = qMin(token.first + token.second, firstColumn + columns);
+        if (begin < end)
+            painter.fillRect(textLeft + (begin - firstColumn) * width, rect.top(), (end - begin) * width,
+                             rect.height(), tokenBackground);
+    }
+
+    QString visible = line.mid(firstColumn, columns);
+    visible.replace('\t', ' ');
+    painter.setPen(palette().color(QPalette::Text));
+    painter.drawText(textLeft, rect.top() + fontMetrics().ascent(), visible);
+
+    if (displayEOLN && line.length() >= firstColumn && line.length() < firstColumn + columns)
+    {
+        painter.setPen(palette().color(QPalette::Disabled, QPalette::Text));
+        painter.drawText(textLeft + (line.length() - firstColumn) * width, rect.top() + fontMetrics().ascent(),
+                         QString(QChar(0x00B6)));
+    }
+
+    painter.restore();
+}
+
+void DiffView::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void DiffView::scrollContentsBy(int, int)
+{
+    viewport()->update();
+}
+
+void DiffView::updateScrollBars()
+{
+    const int rows = diff.isNull() ? 0 : diff->rows.size();
+    const int visibleRows = qMax(1, viewport()->height() / rowHeight());
+    verticalScrollBar()->setRange(0, qMax(0, rows - visibleRows + 1));
+    verticalScrollBar()->setPageStep(visibleRows);
+
+    const int columns = diff.isNull() ? 0 : diff->maxLineLength + 1; // 1 more column for the EOLN mark
+    horizontalScrollBar()->setRange(0, qMax(0, columns - visibleColumns()));
+    horizontalScrollBar()->setPageStep(visibleColumns());
+}
+
+const QPair<QVector<QPair<int, int>>, QVector<QPair<int, int>>> &DiffView::tokensOf(int row)
+{
+    // compared lazily, so only the rows which are painted are compared
+    auto it = tokenCache.find(row);
+    if (it == tokenCache.end())
+    {
+        if (tokenCache.size() > MAX_CACHED_ROWS)
+            tokenCache.clear();
+        const auto &diffRow = diff->rows[row];
+        it = tokenCache.insert(
+            row, Util::diffTokens(diff->outputLines[diffRow.outputLine], diff->expectedLines[diffRow.expectedLine]));
+    }
+    return it.value();
+}
+
+int DiffView::rowHeight() const
+{
+    return fontMetrics().height();
+}
+
+int DiffView::charWidth() const
+{
+    return qMax(1, fontMetrics().horizontalAdvance('0'));
+}
+
+int DiffView::gutterWidth() const
+{
+    int lines = diff.isNull() ? 1 : qMax(diff->outputLines.size(), diff->expectedLines.size());
+    return (QString::number(lines).length() + 2) * charWidth();
+}
+
+int DiffView::visibleColumns() const
+{
+    return qMax(1, (viewport()->width() / 2 - gutterWidth()) / charWidth());
+}
+} // namespace Widgets
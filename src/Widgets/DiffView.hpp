@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+#ifndef DIFFVIEW_HPP
+#define DIFFVIEW_HPP
+
+#include "Util/LineDiff.hpp"
+#include <QAbstractScrollArea>
+#include <QHash>
+#include <QSharedPointer>
+
+namespace Widgets
+{
+// a side-by-side view of a Util::LineDiff, only the visible rows are painted
+class DiffView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+  public:
+    explicit DiffView(QWidget *parent = nullptr);
+
+    void setDiff(const QSharedPointer<const Util::LineDiff> &diff);
+    void setDisplayEOLN(bool display);
+    void scrollToRow(int row);
+    void scrollToLine(int line);
+    int firstVisibleRow() const;
+
+  protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+  private:
+    void updateScrollBars();
+    void paintLine(QPainter &painter, const QRect &rect, int lineNumber, const QString &line, const QColor &background,
+                   const QVector<QPair<int, int>> &tokens, const QColor &tokenBackground);
+    const QPair<QVector<QPair<int, int>>, QVector<QPair<int, int>>> &tokensOf(int row);
+    int rowHeight() const;
+    int charWidth() const;
+    int gutterWidth() const;
+    int visibleColumns() const;
+
+    QSharedPointer<const Util::LineDiff> diff;
+    QHash<int, QPair<QVector<QPair<int, int>>, QVector<QPair<int, int>>>> tokenCache; // diffTokens of the rows
+    bool displayEOLN = false;
+};
+} // namespace Widgets
+
+#endif // DIFFVIEW_HPP
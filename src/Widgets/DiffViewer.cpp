@@ -17,13 +17,14 @@
 
 #include "Widgets/DiffViewer.hpp"
 #include "Core/EventLogger.hpp"
-#include "Core/MessageLogger.hpp"
-#include "diff_match_patch.h"
+#include "Util/LineDiff.hpp"
+#include "Widgets/DiffView.hpp"
+#include <QAtomicInt>
+#include <QFutureWatcher>
 #include <QHBoxLayout>
 #include <QLabel>
-#include <QScrollBar>
-#include <QTextEdit>
 #include <QVBoxLayout>
+#include <QtConcurrent>
 #include <generated/SettingsHelper.hpp>
 
 namespace Widgets
@@ -31,94 +32,82 @@ namespace Widgets
 DiffViewer::DiffViewer(QWidget *parent) : QMainWindow(parent)
 {
     widget = new QWidget(this);
-    layout = new QHBoxLayout();
+    layout = new QVBoxLayout();
     widget->setLayout(layout);
     setCentralWidget(widget);
     setWindowTitle("Diff Viewer");
     resize(720, 480);
 
-    leftLayout = new QVBoxLayout();
+    labelLayout = new QHBoxLayout();
     outputLabel = new QLabel("Output", widget);
-    leftLayout->addWidget(outputLabel);
-    outputEdit = new QTextEdit(widget);
-    outputEdit->setReadOnly(true);
-    outputEdit->setWordWrapMode(QTextOption::NoWrap);
-    leftLayout->addWidget(outputEdit);
-    layout->addLayout(leftLayout);
-
-    rightLayout = new QVBoxLayout();
     expectedLabel = new QLabel("Expected", widget);
-    rightLayout->addWidget(expectedLabel);
-    expectedEdit = new QTextEdit(widget);
-    expectedEdit->setReadOnly(true);
-    expectedEdit->setWordWrapMode(QTextOption::NoWrap);
-    rightLayout->addWidget(expectedEdit);
-    layout->addLayout(rightLayout);
-
-    connect(expectedEdit->horizontalScrollBar(), SIGNAL(valueChanged(int)), outputEdit->horizontalScrollBar(),
-            SLOT(setValue(int)));
-    connect(outputEdit->horizontalScrollBar(), SIGNAL(valueChanged(int)), expectedEdit->horizontalScrollBar(),
-            SLOT(setValue(int)));
-    connect(expectedEdit->verticalScrollBar(), SIGNAL(valueChanged(int)), outputEdit->verticalScrollBar(),
-            SLOT(setValue(int)));
-    connect(outputEdit->verticalScrollBar(), SIGNAL(valueChanged(int)), expectedEdit->verticalScrollBar(),
-            SLOT(setValue(int)));
+    labelLayout->addWidget(outputLabel);
+    labelLayout->addWidget(expectedLabel);
+    layout->addLayout(labelLayout);
+
+    diffView = new DiffView(widget);
+    layout->addWidget(diffView);
+
+    statusLabel = new QLabel(widget);
+    layout->addWidget(statusLabel);
+
+    diffWatcher = new QFutureWatcher<QSharedPointer<const Util::LineDiff>>(this);
+    connect(diffWatcher, SIGNAL(finished()), this, SLOT(onDiffFinished()));
+}
+
+DiffViewer::~DiffViewer()
+{
+    // the worker only uses its own copies of the texts, so it's enough to tell it to stop
+    if (canceled)
+        canceled->storeRelease(1);
 }
 
 void DiffViewer::setText(const QString &output, const QString &expected)
 {
-    if (output.length() <= SettingsHelper::getHTMLDiffViewerLengthLimit() &&
-        expected.length() <= SettingsHelper::getHTMLDiffViewerLengthLimit())
-    {
-        LOG_INFO("Diff viewer is using HTML Text");
-        diff_match_patch differ;
-        differ.Diff_EditCost = 10;
-        auto diffs = differ.diff_main(output, expected);
-        differ.diff_cleanupEfficiency(diffs);
-
-        QString outputHTML, expectedHTML;
-        for (auto diff : diffs)
-        {
-            QString text = diff.text.toHtmlEscaped().replace(" ", "&nbsp;");
-            if (SettingsHelper::isDisplayEOLNInDiff())
-                text.replace("\n", "&para;<br>");
-            else
-                text.replace("\n", "<br>");
-            switch (diff.operation)
-            {
-            case INSERT:
-                expectedHTML += QString("<ins style=\"background:#8f8;\">") + text + QString("</ins>");
-                break;
-            case DELETE:
-                outputHTML += "<s style=\"background:#f88;\">" + text + "</s>";
-                break;
-            case EQUAL:
-                outputHTML += "<span>" + text + "</span>";
-                expectedHTML += "<span>" + text + "</span>";
-                break;
-            }
-        }
-        QPalette p = outputEdit->palette();
-        p.setColor(QPalette::Base, Qt::white); // for system dark theme
-        p.setColor(QPalette::Text, Qt::black);
-        outputEdit->setPalette(p);
-        outputEdit->setHtml(outputHTML);
-        expectedEdit->setPalette(p);
-        expectedEdit->setHtml(expectedHTML);
-    }
+    LOG_INFO(INFO_OF(output.length()) << INFO_OF(expected.length()));
+
+    // cancel the running diff, its result is dropped when the watcher is set to a new future
+    if (canceled)
+        canceled->storeRelease(1);
+    canceled = QSharedPointer<QAtomicInt>::create(0);
+    pendingLine = -1;
+
+    auto flag = canceled;
+    diffWatcher->setFuture(QtConcurrent::run([output, expected, flag] {
+        return QSharedPointer<const Util::LineDiff>(new Util::LineDiff(Util::diffLines(output, expected, flag.data())));
+    }));
+
+    statusLabel->setText("Comparing...");
+}
+
+void DiffViewer::jumpToLine(int line)
+{
+    LOG_INFO(INFO_OF(line));
+    if (diffWatcher->isFinished())
+        diffView->scrollToLine(line);
     else
+        pendingLine = line;
+}
+
+void DiffViewer::onDiffFinished()
+{
+    if (diffWatcher->isCanceled() || canceled->loadAcquire() != 0)
+        return;
+
+    auto diff = diffWatcher->result();
+    LOG_INFO(INFO_OF(diff->rows.size()) << INFO_OF(diff->differentRows));
+
+    diffView->setDisplayEOLN(SettingsHelper::isDisplayEOLNInDiff());
+    diffView->setDiff(diff);
+    if (pendingLine != -1)
     {
-        LOG_INFO("Diff viewer is using Plain Text");
-        emit toLongForHtml();
-        outputEdit->setPlainText(output);
-        expectedEdit->setPlainText(expected);
+        diffView->scrollToLine(pendingLine);
+        pendingLine = -1;
     }
 
-    auto resetScrollBar = [](QScrollBar *scrollBar) { scrollBar->setValue(scrollBar->minimum()); };
-
-    resetScrollBar(outputEdit->horizontalScrollBar());
-    resetScrollBar(outputEdit->verticalScrollBar());
-    resetScrollBar(expectedEdit->horizontalScrollBar());
-    resetScrollBar(outputEdit->verticalScrollBar());
+    if (diff->differentRows == 0)
+        statusLabel->setText("The output and the expected output are the same");
+    else
+        statusLabel->setText(QString("%1 of %2 lines are different").arg(diff->differentRows).arg(diff->rows.size()));
 }
 } // namespace Widgets
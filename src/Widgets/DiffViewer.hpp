@@ -19,31 +19,45 @@
 #define DIFFVIEWER_HPP
 
 #include <QMainWindow>
+#include <QSharedPointer>
 
+class QAtomicInt;
 class QHBoxLayout;
 class QVBoxLayout;
 class QLabel;
-class QTextEdit;
+template <typename T> class QFutureWatcher;
+
+namespace Util
+{
+struct LineDiff;
+}
 
 namespace Widgets
 {
+class DiffView;
+
 class DiffViewer : public QMainWindow
 {
     Q_OBJECT
 
   public:
     explicit DiffViewer(QWidget *parent = nullptr);
+    ~DiffViewer() override;
     void setText(const QString &output, const QString &expected);
+    void jumpToLine(int line);
 
-  signals:
-    void toLongForHtml();
+  private slots:
+    void onDiffFinished();
 
   private:
-    QHBoxLayout *layout = nullptr;
+    QVBoxLayout *layout = nullptr;
     QWidget *widget = nullptr;
-    QVBoxLayout *leftLayout = nullptr, *rightLayout = nullptr;
-    QLabel *outputLabel = nullptr, *expectedLabel = nullptr;
-    QTextEdit *outputEdit = nullptr, *expectedEdit = nullptr;
+    QHBoxLayout *labelLayout = nullptr;
+    QLabel *outputLabel = nullptr, *expectedLabel = nullptr, *statusLabel = nullptr;
+    DiffView *diffView = nullptr;
+    QFutureWatcher<QSharedPointer<const Util::LineDiff>> *diffWatcher = nullptr;
+    QSharedPointer<QAtomicInt> canceled; // set to cancel the running diff
+    int pendingLine = -1;                // the line to jump to when the diff is finished, -1 for none
 };
 } // namespace Widgets
 #endif // DIFFVIEWER_HPP
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+#include "Widgets/LanguageServerStats.hpp"
+#include "Extensions/LanguageServer.hpp"
+#include <QHeaderView>
+#include <QTreeWidget>
+
+namespace Widgets
+{
+LanguageServerStats::LanguageServerStats(const QList<Extensions::LanguageServer *> &languageServers,
+                                         QWidget *parent)
+    : QMainWindow(parent), servers(languageServers)
+{
+    setWindowTitle("Language Server Statistics");
+    resize(600, 300);
+
+    tree = new QTreeWidget(this);
+    tree->setHeaderLabels({"Round Trip", "Count", "Last (ms)", "Average (ms)", "Max (ms)"});
+    tree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    tree->header()->setStretchLastSection(false);
+    setCentralWidget(tree);
+
+    for (auto server : servers)
+        connect(server, SIGNAL(latencyMeasured()), this, SLOT(refresh()));
+}
+
+void LanguageServerStats::refresh()
+{
+    // the stats change with every edit, they are only shown when the window is visible
+    if (!isVisible())
+        return;
+
+    tree->clear();
+    for (auto server : servers)
+    {
+        auto serverItem = new QTreeWidgetItem(
+            tree, {QString("%1 (linting delay: %2 ms)").arg(server->getLanguage()).arg(server->lintingDelay())});
+        auto stats = server->getLatencyStats();
+        for (auto it = stats.begin(); it != stats.end(); ++it)
+        {
+            new QTreeWidgetItem(serverItem, {it.key(), QString::number(it->count), QString::number(it->last),
+                                             QString::number(it->total / qMax(1, it->count)),
+                                             QString::number(it->max)});
+        }
+    }
+    tree->expandAll();
+}
+
+void LanguageServerStats::showEvent(QShowEvent *event)
+{
+    QMainWindow::showEvent(event);
+    refresh();
+}
+} // namespace Widgets
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2019-2020 Ashar Khan <ashar786khan@gmail.com>
+ *
+ * This file is part of CP Editor.
+ *
+ * CP Editor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * I will not be responsible if CP Editor behaves in unexpected way and
+ * causes your ratings to go down and or lose any important contest.
+ *
+ * Believe Software is "Software" and it isn't immune to bugs.
+ *
+ */
+
+#ifndef LANGUAGESERVERSTATS_HPP
+#define LANGUAGESERVERSTATS_HPP
+
+#include <QMainWindow>
+
+class QTreeWidget;
+
+namespace Extensions
+{
+class LanguageServer;
+}
+
+namespace Widgets
+{
+// the measured latencies of the language servers and their current linting delays
+class LanguageServerStats : public QMainWindow
+{
+    Q_OBJECT
+
+  public:
+    explicit LanguageServerStats(const QList<Extensions::LanguageServer *> &languageServers,
+                                 QWidget *parent = nullptr);
+
+  public slots:
+    void refresh();
+
+  protected:
+    void showEvent(QShowEvent *event) override;
+
+  private:
+    QList<Extensions::LanguageServer *> servers;
+    QTreeWidget *tree = nullptr;
+};
+} // namespace Widgets
+
+#endif // LANGUAGESERVERSTATS_HPP
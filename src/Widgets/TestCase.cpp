@@ -18,6 +18,7 @@
 #include "Widgets/TestCase.hpp"
 #include "Core/EventLogger.hpp"
 #include "Core/MessageLogger.hpp"
+#include "Util/LineDiff.hpp"
 #include "Widgets/DiffViewer.hpp"
 #include "Widgets/TestCaseEdit.hpp"
 #include <QCheckBox>
@@ -31,6 +32,8 @@
 
 namespace Widgets
 {
+static const int MAX_REPORTED_MISMATCHES = 10; // the number of mismatches listed in the tooltip of mismatchLabel
+
 TestCase::TestCase(int index, MessageLogger *logger, QWidget *parent, const QString &in, const QString &exp)
     : QWidget(parent), log(logger)
 {
@@ -46,6 +49,7 @@ TestCase::TestCase(int index, MessageLogger *logger, QWidget *parent, const QStr
     inputLabel = new QLabel("Input");
     outputLabel = new QLabel("Output");
     expectedLabel = new QLabel("Expected");
+    mismatchLabel = new QLabel();
     runButton = new QPushButton("Run");
     diffButton = new QPushButton("**");
     delButton = new QPushButton("Del");
@@ -75,6 +79,7 @@ TestCase::TestCase(int index, MessageLogger *logger, QWidget *parent, const QStr
     inputLayout->addWidget(inputEdit);
     outputLayout->addLayout(outputUpLayout);
     outputLayout->addWidget(outputEdit);
+    outputLayout->addWidget(mismatchLabel);
 
     expectedLayout->addLayout(expectedUpLayout);
     expectedLayout->addWidget(expectedEdit);
@@ -84,12 +89,28 @@ TestCase::TestCase(int index, MessageLogger *logger, QWidget *parent, const QStr
 
     runButton->setToolTip("Test on a single testcase");
     diffButton->setToolTip("Open the Diff Viewer");
+    mismatchLabel->hide();
+    mismatchLabel->setWordWrap(true);
+
+    // the edits have their own context menus, this menu is shown when right clicking on the other parts
+    contextMenu = new QMenu(this);
+    contextMenu->addAction("Run", this, SLOT(onRunButtonClicked()));
+    contextMenu->addAction("Minimize Failing Testcase", [this] {
+        LOG_INFO("Minimize requested for " << INFO_OF(id));
+        emit requestMinimize(id);
+    });
+    contextMenu->addAction("Delete", this, SLOT(onDelButtonClicked()));
+    setContextMenuPolicy(Qt::CustomContextMenu);
 
     connect(showCheckBox, SIGNAL(toggled(bool)), this, SLOT(onShowCheckBoxToggled(bool)));
     connect(runButton, SIGNAL(clicked()), this, SLOT(onRunButtonClicked()));
     connect(diffButton, SIGNAL(clicked()), SLOT(onDiffButtonClicked()));
     connect(delButton, SIGNAL(clicked()), this, SLOT(onDelButtonClicked()));
-    connect(diffViewer, SIGNAL(toLongForHtml()), this, SLOT(onToLongForHtml()));
+    connect(mismatchLabel, SIGNAL(linkActivated(const QString &)), this, SLOT(onMismatchLinkActivated()));
+    connect(this, SIGNAL(customContextMenuRequested(const QPoint &)), this,
+            SLOT(onContextMenuRequested(const QPoint &)));
+    connect(inputEdit, &TestCaseEdit::textChanged, this, [this] { dirty = true; });
+    connect(expectedEdit, &TestCaseEdit::textChanged, this, [this] { dirty = true; });
 }
 
 void TestCase::setInput(const QString &text)
@@ -132,6 +153,7 @@ void TestCase::clearOutput()
     currentVerdict = Core::Checker::UNKNOWN;
     diffButton->setStyleSheet("");
     diffButton->setText("**");
+    updateMismatchLabel();
 }
 
 QString TestCase::input() const
@@ -152,6 +174,8 @@ QString TestCase::expected() const
 void TestCase::setID(int index)
 {
     LOG_INFO("Changed testcase ID to " << index);
+    if (id != index)
+        dirty = true;
     id = index;
     inputLabel->setText("Input #" + QString::number(id + 1));
     outputLabel->setText("Output #" + QString::number(id + 1));
@@ -179,6 +203,8 @@ void TestCase::setVerdict(Core::Checker::Verdict verdict)
         diffButton->setText("WA");
         break;
     }
+
+    updateMismatchLabel();
 }
 
 Core::Checker::Verdict TestCase::verdict() const
@@ -203,6 +229,16 @@ void TestCase::setTestCaseEditFont(const QFont &font)
     expectedEdit->setFont(font);
 }
 
+void TestCase::setDirty(bool value)
+{
+    dirty = value;
+}
+
+bool TestCase::isDirty() const
+{
+    return dirty;
+}
+
 void TestCase::onShowCheckBoxToggled(bool checked)
 {
     if (checked)
@@ -226,6 +262,11 @@ void TestCase::onRunButtonClicked()
     emit requestRun(id);
 }
 
+void TestCase::onContextMenuRequested(const QPoint &pos)
+{
+    contextMenu->popup(mapToGlobal(pos));
+}
+
 void TestCase::onDiffButtonClicked()
 {
     LOG_INFO("Diff button clicked for " << INFO_OF(id));
@@ -234,6 +275,15 @@ void TestCase::onDiffButtonClicked()
     diffViewer->raise();
 }
 
+void TestCase::onMismatchLinkActivated()
+{
+    LOG_INFO("Mismatch link clicked for " << INFO_OF(id) << INFO_OF(firstMismatchLine));
+    diffViewer->setText(output(), expected());
+    diffViewer->jumpToLine(firstMismatchLine);
+    diffViewer->show();
+    diffViewer->raise();
+}
+
 void TestCase::onDelButtonClicked()
 {
     LOG_INFO("Del button clicked for " << INFO_OF(id));
@@ -250,13 +300,47 @@ void TestCase::onDelButtonClicked()
     }
 }
 
-void TestCase::onToLongForHtml()
+void TestCase::updateMismatchLabel()
 {
-    log->warn(
-        "Diff Viewer[" + QString::number(id + 1) + "]",
-        QString("The output/expected contains more than %1 characters, HTML diff viewer is disabled. You can change "
-                "the length limit in Preferences->Advanced->Limits->HTML Diff Viewer Length Limit")
-            .arg(SettingsHelper::getHTMLDiffViewerLengthLimit()));
-}
+    firstMismatchLine = -1;
+    if (currentVerdict != Core::Checker::WA)
+    {
+        mismatchLabel->hide();
+        return;
+    }
+
+    // it only scans the texts until the first few mismatches, so it's fast even if the outputs are huge
+    auto mismatches = Util::firstMismatches(output(), expected(), MAX_REPORTED_MISMATCHES);
+    if (mismatches.isEmpty())
+    {
+        // e.g. the outputs are only different in the trailing spaces, and the checker is strict
+        mismatchLabel->hide();
+        return;
+    }
 
-} // namespace Widgets
\ No newline at end of file
+    auto describe = [](const Util::LineMismatch &mismatch) {
+        auto token = [](const QString &token, bool ended) {
+            if (ended)
+                return QString("end of file");
+            if (token.isEmpty())
+                return QString("end of line");
+            return token;
+        };
+        return QString("line %1: got %2, expected %3")
+            .arg(mismatch.line + 1)
+            .arg(token(mismatch.got, mismatch.outputEnded), token(mismatch.expected, mismatch.expectedEnded));
+    };
+
+    QStringList descriptions;
+    for (const auto &mismatch : mismatches)
+        descriptions.push_back(describe(mismatch));
+    if (mismatches.size() == MAX_REPORTED_MISMATCHES)
+        descriptions.push_back("...");
+
+    firstMismatchLine = mismatches.front().line;
+    mismatchLabel->setText(QString("<a href=\"#\">%1</a>").arg(describe(mismatches.front()).toHtmlEscaped()));
+    mismatchLabel->setToolTip(descriptions.join('\n'));
+    mismatchLabel->show();
+    LOG_INFO(INFO_OF(id) << INFO_OF(mismatches.size()) << INFO_OF(firstMismatchLine));
+}
+} // namespace Widgets
@@ -54,29 +54,38 @@ class TestCase : public QWidget
     void setShow(bool show);
     bool isShow() const;
     void setTestCaseEditFont(const QFont &font);
+    void setDirty(bool dirty);
+    bool isDirty() const;
 
   signals:
     void deleted(TestCase *widget);
     void requestRun(int index);
+    void requestMinimize(int index);
 
   private slots:
     void onShowCheckBoxToggled(bool checked);
     void onRunButtonClicked();
     void onDiffButtonClicked();
     void onDelButtonClicked();
-    void onToLongForHtml();
+    void onContextMenuRequested(const QPoint &pos);
+    void onMismatchLinkActivated();
 
   private:
+    void updateMismatchLabel();
+
     QHBoxLayout *mainLayout = nullptr, *inputUpLayout = nullptr, *outputUpLayout = nullptr, *expectedUpLayout = nullptr;
     QVBoxLayout *inputLayout = nullptr, *outputLayout = nullptr, *expectedLayout = nullptr;
     QCheckBox *showCheckBox = nullptr;
-    QLabel *inputLabel = nullptr, *outputLabel = nullptr, *expectedLabel = nullptr;
+    QLabel *inputLabel = nullptr, *outputLabel = nullptr, *expectedLabel = nullptr, *mismatchLabel = nullptr;
     QPushButton *runButton = nullptr, *diffButton = nullptr, *delButton = nullptr;
+    QMenu *contextMenu = nullptr;
     TestCaseEdit *inputEdit = nullptr, *outputEdit = nullptr, *expectedEdit = nullptr;
     DiffViewer *diffViewer = nullptr;
     MessageLogger *log;
     Core::Checker::Verdict currentVerdict = Core::Checker::UNKNOWN;
-    int id;
+    int id = -1;
+    int firstMismatchLine = -1; // the line of the first mismatch shown in mismatchLabel
+    bool dirty = true; // whether the input/expected or the index is changed since the last save
 };
 } // namespace Widgets
 #endif // TESTCASE_HPP
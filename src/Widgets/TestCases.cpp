@@ -18,20 +18,33 @@
 #include "Widgets/TestCases.hpp"
 #include "Core/EventLogger.hpp"
 #include "Core/MessageLogger.hpp"
+#include "Core/TestCaseArchive.hpp"
 #include "Util/FileUtil.hpp"
+#include "Util/Util.hpp"
 #include "Widgets/TestCase.hpp"
 #include "generated/SettingsHelper.hpp"
+#include <QAtomicInt>
+#include <QCollator>
 #include <QComboBox>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QFutureWatcher>
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QMenu>
 #include <QMessageBox>
+#include <QProgressDialog>
 #include <QPushButton>
+#include <QSaveFile>
 #include <QScrollArea>
 #include <QSet>
+#include <QTimer>
 #include <QVBoxLayout>
+#include <QtConcurrent>
+#include <limits>
 
 namespace Widgets
 {
@@ -77,66 +90,31 @@ TestCases::TestCases(MessageLogger *logger, QWidget *parent) : QWidget(parent),
         QStringList paths = QFileDialog::getOpenFileNames(this, "Choose Testcase Files", "");
         LOG_INFO(paths.join(", "));
         if (paths.size())
-        {
-            QVariantList rules = SettingsHelper::getTestcasesMatchingRules();
-            QSet<QString> remain;
-            for (auto path : paths)
-                remain.insert(QFileInfo(path).fileName());
-            // load pairs
-            for (auto rule : rules)
-            {
-                QRegularExpression inputRegex("^" + rule.toStringList().front() + "$");
-                QString answerReplace(rule.toStringList().back());
-                for (auto path : paths)
-                {
-                    auto inputFile = QFileInfo(path).fileName();
-                    if (!remain.contains(inputFile))
-                        continue;
-                    if (!inputRegex.match(inputFile).hasMatch())
-                        continue;
-                    auto answerFile = inputFile;
-                    answerFile.replace(inputRegex, answerReplace);
-                    if (!remain.contains(answerFile))
-                        continue;
-                    remain.remove(inputFile);
-                    remain.remove(answerFile);
-                    auto answerPath = QFileInfo(path).dir().filePath(answerFile);
-                    auto input = Util::readFile(path, "Load Testcases", log, true);
-                    auto answer = Util::readFile(answerPath, "Load Testcases", log, true);
-                    addTestCase(input, answer);
-                    log->info("Load Testcases",
-                              QString("A pair of testcases [%1] and [%2] is loaded").arg(path).arg(answerPath));
-                }
-            }
-            // load single input
-            for (auto rule : rules)
-            {
-                QRegularExpression inputRegex("^" + rule.toStringList().front() + "$");
-                for (auto path : paths)
-                {
-                    auto inputFile = QFileInfo(path).fileName();
-                    if (!remain.contains(inputFile))
-                        continue;
-                    if (!inputRegex.match(inputFile).hasMatch())
-                        continue;
-                    remain.remove(inputFile);
-                    auto input = Util::readFile(path, "Load Testcases", log, true);
-                    addTestCase(input, QString());
-                    log->info("Load Testcases", QString("An input [%1] is loaded").arg(path));
-                }
-            }
-            if (!remain.isEmpty())
-            {
-                QStringList remainPaths;
-                for (auto path : remain)
-                    remainPaths.push_back(QString("[%1]").arg(path));
-                log->warn(
-                    "Load Testcases",
-                    QString("The following files are not loaded because they are not matched:%1. You can set the "
-                            "matching rules at Preferences->File Path->Testcases->Add Testcases From Files Rules.")
-                        .arg(remainPaths.join(", ")));
-            }
-        }
+            importTestCaseFiles(paths);
+    });
+
+    moreMenu->addAction("Add Pairs of Testcases From Directory", [this] {
+        auto dir = QFileDialog::getExistingDirectory(this, "Choose Testcase Directory", "");
+        LOG_INFO(INFO_OF(dir));
+        if (!dir.isEmpty())
+            importTestCaseDirectory(dir);
+    });
+
+    moreMenu->addAction("Import Testcases From Archive", [this] {
+        auto path = QFileDialog::getOpenFileName(this, "Import Testcases", "", Core::TestCaseArchive::NAME_FILTER);
+        LOG_INFO(INFO_OF(path));
+        if (!path.isEmpty())
+            importArchive(path);
+    });
+
+    moreMenu->addAction("Export Testcases To Archive", [this] {
+        auto path = QFileDialog::getSaveFileName(this, "Export Testcases", "", Core::TestCaseArchive::NAME_FILTER);
+        LOG_INFO(INFO_OF(path));
+        if (path.isEmpty())
+            return;
+        if (QFileInfo(path).suffix().isEmpty())
+            path += "." + Core::TestCaseArchive::FILE_SUFFIX;
+        exportArchive(path);
     });
 
     moreMenu->addAction("Remove Empty", [this] {
@@ -202,9 +180,55 @@ TestCases::TestCases(MessageLogger *logger, QWidget *parent) : QWidget(parent),
                                "nyesno - Compare YES/NOs, case insensitive"});
     checkerComboBox->setCurrentIndex(0);
 
+    loadWatcher = new QFutureWatcher<TestCaseFile>(this);
+    saveWatcher = new QFutureWatcher<QVector<TestCaseFile>>(this);
+    archiveSaveWatcher = new QFutureWatcher<ArchiveSave>(this);
+    importWatcher = new QFutureWatcher<TestCaseFile>(this);
+
     connect(checkerComboBox, SIGNAL(currentIndexChanged(int)), this, SIGNAL(checkerChanged()));
     connect(addButton, SIGNAL(clicked()), this, SLOT(on_addButton_clicked()));
     connect(addCheckerButton, SIGNAL(clicked()), this, SLOT(on_addCheckerButton_clicked()));
+    connect(loadWatcher, SIGNAL(resultReadyAt(int)), this, SLOT(onTestCaseFileLoaded(int)));
+    connect(saveWatcher, SIGNAL(finished()), this, SLOT(onTestCaseFilesSaved()));
+    connect(archiveSaveWatcher, SIGNAL(finished()), this, SLOT(onTestCaseArchiveSaved()));
+    connect(importWatcher, SIGNAL(finished()), this, SLOT(onTestCaseFilesImported()));
+}
+
+TestCases::~TestCases()
+{
+    cancelLoading();
+    importWatcher->cancel();
+    importWatcher->waitForFinished();
+    // make sure the testcases are on the disk before quitting
+    saveWatcher->waitForFinished();
+    archiveSaveWatcher->waitForFinished();
+    if (hasPendingSave && SettingsHelper::isSaveTestcasesInArchive())
+    {
+        // the finished signal won't be handled any more, so do the pending save here
+        hasPendingSave = false;
+        ArchiveSave save;
+        if (collectArchiveSave(pendingSaveFilePath, pendingSaveSafe && !SettingsHelper::isSaveFaster(), save))
+        {
+            LOG_INFO("Saving the pending testcase archive before quitting");
+            save = writeArchive(save);
+            if (!save.error.isNull())
+                LOG_ERR(save.error);
+        }
+    }
+    else if (hasPendingSave)
+    {
+        hasPendingSave = false;
+        QVector<TestCaseFile> files;
+        QStringList removedPaths;
+        collectChangedFiles(pendingSaveFilePath, files, removedPaths);
+        if (!files.isEmpty() || !removedPaths.isEmpty())
+        {
+            LOG_INFO("Saving " << files.count() << " pending testcase files before quitting");
+            for (auto const &file : writeTestCaseFiles(files, removedPaths,
+                                                       pendingSaveSafe && !SettingsHelper::isSaveFaster()))
+                LOG_ERR("Failed to save to [" << file.path << "]");
+        }
+    }
 }
 
 void TestCases::setInput(int index, const QString &input)
@@ -236,6 +260,7 @@ void TestCases::addTestCase(const QString &input, const QString &expected)
         auto testcase = new TestCase(count(), log, this, input, expected);
         connect(testcase, SIGNAL(deleted(TestCase *)), this, SLOT(onChildDeleted(TestCase *)));
         connect(testcase, SIGNAL(requestRun(int)), this, SIGNAL(requestRun(int)));
+        connect(testcase, SIGNAL(requestMinimize(int)), this, SIGNAL(requestMinimize(int)));
         testcases.push_back(testcase);
         scrollAreaLayout->addWidget(testcase);
         updateVerdicts();
@@ -251,8 +276,13 @@ void TestCases::clearOutput()
 
 void TestCases::clear()
 {
+    cancelLoading();
     while (count() > 0)
         onChildDeleted(testcases.front());
+    // the archived testcases are removed with the shown ones, they are removed from the archive in the next save
+    archivedTestCases.clear();
+    savedArchiveHash.clear();
+    updateVerdicts();
 }
 
 QString TestCases::input(int index) const
@@ -297,46 +327,227 @@ void TestCases::loadFromSavedFiles(const QString &filePath)
 {
     clear();
 
-    for (int i = MAX_NUMBER_OF_TESTCASES - 1; i >= 0; --i)
+    if (SettingsHelper::isSaveTestcasesInArchive() && QFile::exists(archiveFilePath(filePath)))
     {
-        auto inputPath = inputFilePath(filePath, i);
-        auto answerPath = answerFilePath(filePath, i);
-        if (QFile::exists(inputPath) || QFile::exists(answerPath))
-        {
-            for (int j = 0; j <= i; ++j)
-            {
-                addTestCase(loadTestCaseFromFile(inputFilePath(filePath, j), QString("Input #%1").arg(j + 1)),
-                            loadTestCaseFromFile(answerFilePath(filePath, j), QString("Expected #%1").arg(j + 1)));
-            }
-            break;
-        }
+        loadFromArchive(filePath);
+        return;
     }
 
+    QMap<int, QString> inputPaths, answerPaths;
+    findSavedFiles(filePath, inputPaths, answerPaths);
+
+    // remember the files on the disk, their hashes are filled in when they are loaded
+    savedFilePath = filePath;
+    savedRules = QStringList{SettingsHelper::getInputFileSavePath(), SettingsHelper::getAnswerFileSavePath()};
+    savedHash.clear();
+    for (auto const &path : inputPaths)
+        savedHash[path] = QByteArray();
+    for (auto const &path : answerPaths)
+        savedHash[path] = QByteArray();
+
+    int number = 0;
+    if (!inputPaths.isEmpty())
+        number = inputPaths.lastKey() + 1;
+    if (!answerPaths.isEmpty())
+        number = qMax(number, answerPaths.lastKey() + 1);
+
+    // create the testcases now, and fill in their contents when the files are loaded in the background
+    for (int i = 0; i < number; ++i)
+        addTestCase();
+    loadingTestCases.clear();
+    for (auto testcase : testcases)
+        loadingTestCases.push_back(testcase);
+
     if (count() == 0)
+    {
         addTestCase();
+        return;
+    }
+
+    QList<TestCaseFile> files;
+    int lengthLimit = SettingsHelper::getLoadTestCaseFileLengthLimit();
+    for (auto it = inputPaths.cbegin(); it != inputPaths.cend(); ++it)
+        files.push_back({it.key(), true, it.value(), lengthLimit, TestCaseFile::Pending, QString()});
+    for (auto it = answerPaths.cbegin(); it != answerPaths.cend(); ++it)
+        files.push_back({it.key(), false, it.value(), lengthLimit, TestCaseFile::Pending, QString()});
+
+    LOG_INFO("Loading " << files.count() << " testcase files in the background");
+    loadWatcher->setFuture(QtConcurrent::mapped(files, &TestCases::readTestCaseFile));
 }
 
 void TestCases::saveToFiles(const QString &filePath, bool safe)
 {
+    if (saveWatcher->isRunning() || archiveSaveWatcher->isRunning() || archiveLoadWatcher)
+    {
+        // save again when the running save is finished, only the latest request matters
+        hasPendingSave = true;
+        pendingSaveFilePath = filePath;
+        pendingSaveSafe = safe;
+        return;
+    }
+
+    if (SettingsHelper::isSaveTestcasesInArchive())
+    {
+        ArchiveSave save;
+        if (!collectArchiveSave(filePath, safe && !SettingsHelper::isSaveFaster(), save))
+            return;
+        LOG_INFO("Saving " << save.inputs.count() << " testcases and " << save.archived.count()
+                           << " archived testcases to [" << save.path << "]");
+        archiveSaveWatcher->setFuture(QtConcurrent::run(&TestCases::writeArchive, save));
+        return;
+    }
+
+    QVector<TestCaseFile> files;
+    QStringList removedPaths;
+    collectChangedFiles(filePath, files, removedPaths);
+
+    if (files.isEmpty() && removedPaths.isEmpty())
+        return;
+
+    LOG_INFO("Saving " << files.count() << " testcase files and removing " << removedPaths.count() << " files");
+    saveWatcher->setFuture(QtConcurrent::run(&TestCases::writeTestCaseFiles, files, removedPaths,
+                                             safe && !SettingsHelper::isSaveFaster()));
+}
+
+void TestCases::collectChangedFiles(const QString &filePath, QVector<TestCaseFile> &files, QStringList &removedPaths)
+{
+    QStringList rules{SettingsHelper::getInputFileSavePath(), SettingsHelper::getAnswerFileSavePath()};
+    if (filePath != savedFilePath || rules != savedRules)
+    {
+        // find the files saved before, they are removed or overwritten in this save
+        QMap<int, QString> inputPaths, answerPaths;
+        findSavedFiles(filePath, inputPaths, answerPaths);
+        savedFilePath = filePath;
+        savedRules = rules;
+        savedHash.clear();
+        for (auto const &path : inputPaths)
+            savedHash[path] = QByteArray();
+        for (auto const &path : answerPaths)
+            savedHash[path] = QByteArray();
+        for (auto t : testcases)
+            t->setDirty(true);
+    }
+
+    QSet<QString> currentPaths;
+
+    auto addFile = [&](int index, bool isInput, const QString &content) {
+        auto path = isInput ? inputFilePath(filePath, index) : answerFilePath(filePath, index);
+        currentPaths.insert(path);
+        // empty testcases are not saved, but the old files are kept
+        if (content.isEmpty())
+            return;
+        if (!testcases[index]->isDirty() && !savedHash.value(path).isEmpty())
+            return;
+        auto hash = Util::textHash(content);
+        if (savedHash.value(path) == hash)
+            return;
+        savedHash[path] = hash;
+        files.push_back({index, isInput, path, 0, TestCaseFile::Pending, content});
+    };
+
     for (int i = 0; i < count(); ++i)
     {
-        if (!input(i).isEmpty())
-            Util::saveFile(inputFilePath(filePath, i), input(i), QString("Save Input #%1").arg(i + 1), safe, log, true);
-        if (!expected(i).isEmpty())
-            Util::saveFile(answerFilePath(filePath, i), expected(i), QString("Save Expected #%1").arg(i + 1), safe, log,
-                           true);
+        addFile(i, true, input(i));
+        addFile(i, false, expected(i));
+        testcases[i]->setDirty(false);
     }
-    for (int i = count(); i < MAX_NUMBER_OF_TESTCASES; ++i)
+
+    for (auto it = savedHash.begin(); it != savedHash.end();)
     {
-        auto inputPath = inputFilePath(filePath, i);
-        auto answerPath = answerFilePath(filePath, i);
-        if (QFile::exists(inputPath))
-            QFile::remove(inputPath);
-        if (QFile::exists(answerPath))
-            QFile::remove(answerPath);
+        if (currentPaths.contains(it.key()))
+        {
+            ++it;
+        }
+        else
+        {
+            removedPaths.push_back(it.key());
+            it = savedHash.erase(it);
+        }
     }
 }
 
+void TestCases::loadFromArchive(const QString &filePath)
+{
+    // the archive is read in a worker thread, the testcases are added when it's finished
+    auto path = archiveFilePath(filePath);
+    auto watcher = new QFutureWatcher<ArchiveContent>(this);
+    archiveLoadWatcher = watcher;
+    connect(watcher, &QFutureWatcher<ArchiveContent>::finished, this, [this, watcher, path] {
+        auto content = watcher->result();
+        watcher->deleteLater();
+        // it's canceled by clear() or another load
+        if (watcher != archiveLoadWatcher)
+            return;
+        archiveLoadWatcher = nullptr;
+
+        for (auto const &error : content.errors)
+            log->error("Load Testcases", error);
+
+        // the testcases added by the user while loading are kept before the loaded ones
+        bool isUntouched = count() == 0;
+        QVector<int> archived = content.kept;
+        for (int i = 0; i < content.inputs.count(); ++i)
+        {
+            if (count() < MAX_NUMBER_OF_TESTCASES)
+                addTestCase(content.inputs[i], content.answers[i]);
+            else
+                archived.push_back(content.indexes[i]);
+        }
+        std::sort(archived.begin(), archived.end());
+        for (int index : archived)
+            archivedTestCases.push_back({path, index});
+        if (count() == 0)
+            addTestCase();
+
+        savedArchivePath = path;
+        if (isUntouched && archived.count() == content.kept.count())
+            savedArchiveHash = archiveHash(inputs(), expecteds());
+        updateVerdicts();
+
+        LOG_INFO(INFO_OF(content.total) << INFO_OF(archivedTestCases.count()));
+
+        if (hasPendingSave)
+        {
+            hasPendingSave = false;
+            saveToFiles(pendingSaveFilePath, pendingSaveSafe);
+        }
+    });
+    LOG_INFO("Loading the testcase archive [" << path << "] in the background");
+    watcher->setFuture(QtConcurrent::run(&TestCases::readArchive, path, MAX_NUMBER_OF_TESTCASES,
+                                         SettingsHelper::getLoadTestCaseFileLengthLimit()));
+}
+
+bool TestCases::collectArchiveSave(const QString &filePath, bool safe, ArchiveSave &save)
+{
+    save.path = archiveFilePath(filePath);
+    save.inputs = inputs();
+    save.answers = expecteds();
+    save.archived = archivedTestCases;
+    save.safe = safe;
+    // it's not known what are after the shown testcases in the archive, e.g. restored from the hot exit session
+    save.keepRest = savedArchivePath.isEmpty();
+
+    auto hash = archiveHash(save.inputs, save.answers);
+    bool isArchived = std::all_of(archivedTestCases.cbegin(), archivedTestCases.cend(),
+                                  [&save](const Core::TestCaseArchive::Reference &reference) {
+                                      return reference.archivePath == save.path;
+                                  });
+    if (save.path == savedArchivePath && hash == savedArchiveHash && isArchived)
+        return false;
+
+    // empty testcases don't make an archive, but an existing archive is updated
+    bool isEmpty = save.archived.isEmpty() && std::all_of(save.inputs.cbegin(), save.inputs.cend(),
+                                                          [](const QString &input) { return input.isEmpty(); }) &&
+                   std::all_of(save.answers.cbegin(), save.answers.cend(),
+                               [](const QString &answer) { return answer.isEmpty(); });
+    if (isEmpty && !QFile::exists(save.path))
+        return false;
+
+    savingArchiveHash = hash;
+    savingArchived = archivedTestCases;
+    return true;
+}
+
 QString TestCases::loadTestCaseFromFile(const QString &path, const QString &head)
 {
     auto content = Util::readFile(path, QString("Load %1").arg(head), log);
@@ -401,7 +612,12 @@ QString TestCases::checkerText() const
 
 Core::Checker::CheckerType TestCases::checkerType() const
 {
-    switch (checkerIndex())
+    return checkerTypeOf(checkerIndex());
+}
+
+Core::Checker::CheckerType TestCases::checkerTypeOf(int index)
+{
+    switch (index)
     {
     case 0:
         return Core::Checker::IgnoreTrailingSpaces;
@@ -467,6 +683,637 @@ void TestCases::onChildDeleted(TestCase *widget)
     updateVerdicts();
 }
 
+void TestCases::onTestCaseFileLoaded(int resultIndex)
+{
+    if (loadWatcher->isCanceled())
+        return;
+
+    auto file = loadWatcher->resultAt(resultIndex);
+
+    switch (file.status)
+    {
+    case TestCaseFile::Loaded:
+        if (savedHash.contains(file.path))
+            savedHash[file.path] = Util::textHash(file.content);
+        // the testcases may be deleted or renumbered by the user while loading, and the modified ones are kept
+        if (auto testcase = loadingTestCases.value(file.index))
+        {
+            if (file.isInput)
+            {
+                if (testcase->input().isEmpty())
+                    testcase->setInput(file.content);
+            }
+            else
+            {
+                if (testcase->expected().isEmpty())
+                    testcase->setExpected(file.content);
+            }
+        }
+        break;
+    case TestCaseFile::TooLong:
+    case TestCaseFile::Failed:
+        logTestCaseFileError(file);
+        break;
+    case TestCaseFile::Pending:
+    case TestCaseFile::Saved:
+        break;
+    }
+}
+
+void TestCases::logTestCaseFileError(const TestCaseFile &file)
+{
+    if (file.status == TestCaseFile::TooLong)
+    {
+        log->error("Testcases",
+                   QString("The testcase file [%1] contains more than %2 characters, so it's not loaded. You can "
+                           "change the length limit in Preferences->Advanced->Limits->Load Test Case File Length Limit")
+                       .arg(file.path)
+                       .arg(file.lengthLimit));
+    }
+    else if (file.status == TestCaseFile::Failed)
+    {
+        log->error(QString("Load %1 #%2").arg(file.isInput ? "Input" : "Expected").arg(file.index + 1),
+                   QString("Failed to open [%1]. Do I have read permission?").arg(file.path));
+        LOG_ERR(QString("Failed to open [%1]").arg(file.path));
+    }
+}
+
+void TestCases::onTestCaseFilesSaved()
+{
+    auto failed = saveWatcher->result();
+    for (auto const &file : failed)
+    {
+        // save it again next time
+        savedHash.remove(file.path);
+        log->error(QString("Save %1 #%2").arg(file.isInput ? "Input" : "Expected").arg(file.index + 1),
+                   "Failed to save to [" + file.path + "]. Do I have write permission?");
+        LOG_ERR("Failed to save to [" << file.path << "]");
+    }
+
+    if (hasPendingSave)
+    {
+        hasPendingSave = false;
+        saveToFiles(pendingSaveFilePath, pendingSaveSafe);
+    }
+}
+
+void TestCases::onTestCaseArchiveSaved()
+{
+    auto save = archiveSaveWatcher->result();
+    if (save.error.isNull())
+    {
+        // the archived testcases are in the saved archive now, except the ones archived while saving
+        if (archivedTestCases.mid(0, savingArchived.count()) == savingArchived)
+        {
+            QVector<Core::TestCaseArchive::Reference> archived;
+            for (int i = 0; i < save.archivedCount; ++i)
+                archived.push_back({save.path, save.shownCount + i});
+            archivedTestCases = archived + archivedTestCases.mid(savingArchived.count());
+        }
+        savedArchivePath = save.path;
+        savedArchiveHash = savingArchiveHash;
+        updateVerdicts();
+    }
+    else
+    {
+        // save it again next time
+        savedArchiveHash.clear();
+        log->error("Save Testcases", save.error + ". Do I have write permission?");
+        LOG_ERR(save.error);
+    }
+
+    if (hasPendingSave)
+    {
+        hasPendingSave = false;
+        saveToFiles(pendingSaveFilePath, pendingSaveSafe);
+    }
+}
+
+TestCases::ArchiveSave TestCases::writeArchive(ArchiveSave save)
+{
+    // This is called in a worker thread, so don't touch the widgets or the loggers here
+    if (save.keepRest)
+    {
+        // an archive which can't be read is replaced
+        Core::TestCaseArchive old(save.path);
+        if (QFile::exists(save.path) && old.open())
+        {
+            for (int i = save.inputs.count(); i < old.count(); ++i)
+                save.archived.push_back({save.path, i});
+        }
+    }
+
+    QDir().mkpath(QFileInfo(save.path).absolutePath());
+    save.shownCount = save.inputs.count();
+    save.archivedCount = save.archived.count();
+    QString error;
+    if (!Core::TestCaseArchive::write(save.path, save.inputs, save.answers, save.archived, save.safe, &error))
+        save.error = error.isEmpty() ? QString("Failed to save to [%1]").arg(save.path) : error;
+
+    // the contents are not needed by the main thread
+    save.inputs.clear();
+    save.answers.clear();
+    save.archived.clear();
+    return save;
+}
+
+QByteArray TestCases::archiveHash(const QStringList &inputs, const QStringList &answers)
+{
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    for (int i = 0; i < inputs.count(); ++i)
+    {
+        hash.addData(Util::textHash(inputs[i]));
+        hash.addData(Util::textHash(answers[i]));
+    }
+    return hash.result();
+}
+
+void TestCases::importArchive(const QString &path)
+{
+    // the archive is decompressed in a worker thread, the testcases are added when it's finished
+    // if the testcases are saved in an archive, the ones which can't be shown are archived instead of dropped
+    bool isArchiving = SettingsHelper::isSaveTestcasesInArchive();
+    auto watcher = new QFutureWatcher<ArchiveContent>(this);
+    connect(watcher, &QFutureWatcher<ArchiveContent>::finished, this, [this, watcher, path, isArchiving] {
+        auto content = watcher->result();
+        watcher->deleteLater();
+        for (auto const &error : content.errors)
+            log->error("Import Testcases", error);
+        int loaded = 0;
+        QVector<int> archived = content.kept;
+        for (int i = 0; i < content.inputs.count(); ++i)
+        {
+            if (count() < MAX_NUMBER_OF_TESTCASES)
+            {
+                addTestCase(content.inputs[i], content.answers[i]);
+                ++loaded;
+            }
+            else
+            {
+                archived.push_back(content.indexes[i]);
+            }
+        }
+        if (isArchiving)
+        {
+            std::sort(archived.begin(), archived.end());
+            for (int index : archived)
+                archivedTestCases.push_back({path, index});
+            updateVerdicts();
+        }
+        if (content.total > 0)
+        {
+            auto message = QString("%1 of %2 testcases in [%3] are imported").arg(loaded).arg(content.total).arg(path);
+            if (isArchiving && !archived.isEmpty())
+                message += QString(", and %1 testcases are archived").arg(archived.count());
+            log->info("Import Testcases", message);
+        }
+    });
+    watcher->setFuture(QtConcurrent::run(&TestCases::readArchive, path, MAX_NUMBER_OF_TESTCASES - count(),
+                                         isArchiving ? SettingsHelper::getLoadTestCaseFileLengthLimit()
+                                                     : std::numeric_limits<int>::max()));
+}
+
+void TestCases::exportArchive(const QString &path)
+{
+    // the testcases are taken here, and they are compressed and written in a worker thread
+    auto watcher = new QFutureWatcher<QString>(this);
+    int total = count() + archivedTestCases.count();
+    connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher, path, total] {
+        auto error = watcher->result();
+        watcher->deleteLater();
+        if (error.isNull())
+            log->info("Export Testcases", QString("%1 testcases are exported to [%2]").arg(total).arg(path));
+        else
+            log->error("Export Testcases", error);
+    });
+    auto inputList = inputs(), answerList = expecteds();
+    auto archived = archivedTestCases;
+    bool safe = !SettingsHelper::isSaveFaster();
+    watcher->setFuture(QtConcurrent::run([path, inputList, answerList, archived, safe] {
+        // a null string means that it's exported successfully
+        QString error;
+        if (Core::TestCaseArchive::write(path, inputList, answerList, archived, safe, &error))
+            return QString();
+        return error;
+    }));
+}
+
+TestCases::ArchiveContent TestCases::readArchive(const QString &path, int limit, int lengthLimit)
+{
+    // This is called in a worker thread, so don't touch the widgets or the message logger here
+    ArchiveContent content;
+    Core::TestCaseArchive archive(path);
+    if (!archive.open())
+    {
+        content.errors.push_back(archive.errorString());
+        return content;
+    }
+    content.total = archive.count();
+    for (int i = 0; i < archive.count(); ++i)
+    {
+        // the sizes are in the index, so the kept testcases are not decompressed
+        if (content.inputs.count() >= limit || archive.size(i, true) > lengthLimit ||
+            archive.size(i, false) > lengthLimit)
+        {
+            content.kept.push_back(i);
+            continue;
+        }
+        auto input = archive.read(i, true);
+        auto answer = archive.read(i, false);
+        if (input.isNull() || answer.isNull())
+        {
+            content.errors.push_back(archive.errorString());
+            continue;
+        }
+        content.inputs.push_back(QString::fromUtf8(input));
+        content.answers.push_back(QString::fromUtf8(answer));
+        content.indexes.push_back(i);
+    }
+    return content;
+}
+
+void TestCases::importTestCaseDirectory(const QString &dir)
+{
+    if (importWatcher->isRunning() || isListingDirectory)
+    {
+        log->warn("Load Testcases", "Another import is running, please wait for it to finish");
+        return;
+    }
+
+    // the directory is walked in a worker thread, so that a large directory doesn't freeze the UI,
+    // and the files are imported when it's finished
+    auto canceled = QSharedPointer<QAtomicInt>::create(0);
+    auto progress = new QProgressDialog("Looking for testcase files...", "Cancel", 0, 0, this);
+    progress->setWindowTitle("Load Testcases");
+    progress->setWindowModality(Qt::WindowModal);
+    QTimer::singleShot(500, progress, SLOT(show()));
+    connect(progress, &QProgressDialog::canceled, [canceled] { canceled->storeRelease(1); });
+
+    isListingDirectory = true;
+    auto watcher = new QFutureWatcher<QStringList>(this);
+    connect(watcher, &QFutureWatcher<QStringList>::finished, this, [this, watcher, progress, canceled] {
+        isListingDirectory = false;
+        watcher->deleteLater();
+        progress->deleteLater();
+        if (canceled->loadAcquire())
+        {
+            LOG_INFO("Import canceled");
+            log->info("Load Testcases", "Loading testcases is canceled");
+            return;
+        }
+        importTestCaseFiles(watcher->result());
+    });
+    watcher->setFuture(QtConcurrent::run([dir, canceled] {
+        QStringList paths;
+        QDirIterator it(dir, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext() && !canceled->loadAcquire())
+            paths.push_back(it.next());
+        return paths;
+    }));
+}
+
+void TestCases::importTestCaseFiles(const QStringList &paths)
+{
+    if (importWatcher->isRunning())
+    {
+        log->warn("Load Testcases", "Another import is running, please wait for it to finish");
+        return;
+    }
+
+    // compile the matching rules only once
+    QVector<QPair<QRegularExpression, QString>> rules;
+    for (const auto &rule : SettingsHelper::getTestcasesMatchingRules())
+    {
+        auto list = rule.toStringList();
+        rules.push_back({QRegularExpression("^" + list.front() + "$"), list.back()});
+    }
+
+    // group the files by their directories, so that an answer is only matched in the directory of its input
+    QCollator collator;
+    collator.setNumericMode(true);
+    QMap<QString, QStringList> fileNames;
+    QSet<QString> remain;
+    for (const auto &path : paths)
+    {
+        QFileInfo info(path);
+        fileNames[info.absolutePath()].push_back(info.fileName());
+        remain.insert(info.absoluteFilePath());
+    }
+    for (auto &names : fileNames)
+        std::sort(names.begin(), names.end(), collator);
+
+    QVector<TestCaseFile> files;
+    int lengthLimit = SettingsHelper::getLoadTestCaseFileLengthLimit();
+    importPairCount = 0;
+
+    // load pairs
+    for (const auto &rule : rules)
+    {
+        for (auto it = fileNames.constBegin(); it != fileNames.constEnd(); ++it)
+        {
+            QDir dir(it.key());
+            for (const auto &inputFile : it.value())
+            {
+                auto inputPath = dir.filePath(inputFile);
+                if (!remain.contains(inputPath) || !rule.first.match(inputFile).hasMatch())
+                    continue;
+                auto answerFile = inputFile;
+                answerFile.replace(rule.first, rule.second);
+                auto answerPath = dir.filePath(answerFile);
+                if (answerPath == inputPath || !remain.contains(answerPath))
+                    continue;
+                remain.remove(inputPath);
+                remain.remove(answerPath);
+                files.push_back({importPairCount, true, inputPath, lengthLimit, TestCaseFile::Pending, QString()});
+                files.push_back({importPairCount, false, answerPath, lengthLimit, TestCaseFile::Pending, QString()});
+                ++importPairCount;
+            }
+        }
+    }
+
+    // load single input
+    for (const auto &rule : rules)
+    {
+        for (auto it = fileNames.constBegin(); it != fileNames.constEnd(); ++it)
+        {
+            QDir dir(it.key());
+            for (const auto &inputFile : it.value())
+            {
+                auto inputPath = dir.filePath(inputFile);
+                if (!remain.contains(inputPath) || !rule.first.match(inputFile).hasMatch())
+                    continue;
+                remain.remove(inputPath);
+                files.push_back({importPairCount, true, inputPath, lengthLimit, TestCaseFile::Pending, QString()});
+                ++importPairCount;
+            }
+        }
+    }
+
+    if (!remain.isEmpty())
+    {
+        QStringList remainPaths;
+        for (const auto &path : remain)
+        {
+            if (remainPaths.size() == 10)
+            {
+                remainPaths.push_back(QString("and %1 more").arg(remain.size() - 10));
+                break;
+            }
+            remainPaths.push_back(QString("[%1]").arg(path));
+        }
+        log->warn("Load Testcases",
+                  QString("The following files are not loaded because they are not matched:%1. You can set the "
+                          "matching rules at Preferences->File Path->Testcases->Add Testcases From Files Rules.")
+                      .arg(remainPaths.join(", ")));
+    }
+
+    if (files.isEmpty())
+        return;
+
+    LOG_INFO(INFO_OF(importPairCount) << INFO_OF(files.size()));
+
+    // read the files in the thread pool, the testcases are added when all of them are read
+    importProgress = new QProgressDialog("Loading testcases...", "Cancel", 0, files.size(), this);
+    importProgress->setWindowTitle("Load Testcases");
+    importProgress->setWindowModality(Qt::WindowModal);
+    importProgress->setMinimumDuration(500);
+    importProgress->setAutoClose(false);
+    importProgress->setAutoReset(false);
+    connect(importWatcher, SIGNAL(progressValueChanged(int)), importProgress, SLOT(setValue(int)));
+    connect(importProgress, SIGNAL(canceled()), importWatcher, SLOT(cancel()));
+
+    importWatcher->setFuture(QtConcurrent::mapped(files, &TestCases::readTestCaseFile));
+}
+
+void TestCases::onTestCaseFilesImported()
+{
+    importProgress->deleteLater();
+    importProgress = nullptr;
+
+    if (importWatcher->isCanceled())
+    {
+        LOG_INFO("Import canceled");
+        log->info("Load Testcases", "Loading testcases is canceled");
+        importWatcher->setFuture(QFuture<TestCaseFile>());
+        return;
+    }
+
+    QStringList importedInputs, importedAnswers;
+    QVector<bool> loaded(importPairCount, true);
+    for (int i = 0; i < importPairCount; ++i)
+    {
+        importedInputs.push_back(QString());
+        importedAnswers.push_back(QString());
+    }
+
+    for (const auto &file : importWatcher->future().results())
+    {
+        if (file.status != TestCaseFile::Loaded)
+        {
+            logTestCaseFileError(file);
+            loaded[file.index] = false;
+        }
+        else if (file.isInput)
+        {
+            importedInputs[file.index] = file.content;
+        }
+        else
+        {
+            importedAnswers[file.index] = file.content;
+        }
+    }
+    importWatcher->setFuture(QFuture<TestCaseFile>());
+
+    // skip the pairs which are identical to an existing or a previously imported testcase
+    QSet<QByteArray> hashes;
+    for (int i = 0; i < count(); ++i)
+        hashes.insert(Util::textHash(input(i) + QChar(0) + expected(i)));
+
+    int added = 0, duplicated = 0, overflowed = 0;
+    for (int i = 0; i < importPairCount; ++i)
+    {
+        if (!loaded[i])
+            continue;
+        auto hash = Util::textHash(importedInputs[i] + QChar(0) + importedAnswers[i]);
+        if (hashes.contains(hash))
+        {
+            ++duplicated;
+            continue;
+        }
+        if (count() >= MAX_NUMBER_OF_TESTCASES)
+        {
+            ++overflowed;
+            continue;
+        }
+        hashes.insert(hash);
+        addTestCase(importedInputs[i], importedAnswers[i]);
+        ++added;
+    }
+
+    LOG_INFO(INFO_OF(added) << INFO_OF(duplicated) << INFO_OF(overflowed));
+
+    QString message = QString("%1 testcases are loaded").arg(added);
+    if (duplicated > 0)
+        message += QString(", %1 duplicated testcases are skipped").arg(duplicated);
+    if (overflowed > 0)
+        message += QString(", %1 testcases are not loaded because there can be at most %2 testcases")
+                       .arg(overflowed)
+                       .arg(MAX_NUMBER_OF_TESTCASES);
+    log->info("Load Testcases", message);
+}
+
+void TestCases::cancelLoading()
+{
+    if (loadWatcher->isRunning())
+    {
+        LOG_INFO("Cancel loading testcase files");
+        loadWatcher->cancel();
+        loadWatcher->waitForFinished();
+    }
+    // drop the results which are not delivered yet
+    loadWatcher->setFuture(QFuture<TestCaseFile>());
+    loadingTestCases.clear();
+    // the running load of the archive is finished in the background, and its result is ignored
+    archiveLoadWatcher = nullptr;
+}
+
+TestCases::TestCaseFile TestCases::readTestCaseFile(TestCaseFile file)
+{
+    // This is called in a worker thread, so don't touch the widgets or the loggers here
+    QFile f(file.path);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        file.status = TestCaseFile::Failed;
+        return file;
+    }
+    file.content = f.readAll();
+    if (file.content.length() > file.lengthLimit)
+    {
+        file.content.clear();
+        file.status = TestCaseFile::TooLong;
+    }
+    else
+    {
+        file.status = TestCaseFile::Loaded;
+    }
+    return file;
+}
+
+QVector<TestCases::TestCaseFile> TestCases::writeTestCaseFiles(QVector<TestCaseFile> files,
+                                                               const QStringList &removedPaths, bool safe)
+{
+    // This is called in a worker thread, so don't touch the widgets or the loggers here
+    QVector<TestCaseFile> failed;
+
+    for (auto &file : files)
+    {
+        QDir().mkpath(QFileInfo(file.path).absolutePath());
+        bool ok = false;
+        if (safe)
+        {
+            QSaveFile f(file.path);
+            ok = f.open(QIODevice::WriteOnly | QIODevice::Text) && f.write(file.content.toUtf8()) != -1 && f.commit();
+        }
+        else
+        {
+            QFile f(file.path);
+            ok = f.open(QIODevice::WriteOnly | QIODevice::Text) && f.write(file.content.toUtf8()) != -1;
+        }
+        file.content.clear();
+        file.status = ok ? TestCaseFile::Saved : TestCaseFile::Failed;
+        if (!ok)
+            failed.push_back(file);
+    }
+
+    for (auto const &path : removedPaths)
+        QFile::remove(path);
+
+    return failed;
+}
+
+void TestCases::findSavedFiles(const QString &filePath, QMap<int, QString> &inputPaths,
+                               QMap<int, QString> &answerPaths)
+{
+    // find the saved files by listing their directories once, or probe every path if the directories depend on the
+    // indexes of the testcases
+    QMap<QString, QStringList> entryCache;
+    if (!findTestCaseFiles(SettingsHelper::getInputFileSavePath(), filePath, inputPaths, entryCache) ||
+        !findTestCaseFiles(SettingsHelper::getAnswerFileSavePath(), filePath, answerPaths, entryCache))
+    {
+        LOG_INFO("Probing the testcase files one by one");
+        inputPaths.clear();
+        answerPaths.clear();
+        for (int i = 0; i < MAX_NUMBER_OF_TESTCASES; ++i)
+        {
+            auto inputPath = inputFilePath(filePath, i);
+            auto answerPath = answerFilePath(filePath, i);
+            if (QFile::exists(inputPath))
+                inputPaths[i] = inputPath;
+            if (QFile::exists(answerPath))
+                answerPaths[i] = answerPath;
+        }
+    }
+}
+
+bool TestCases::findTestCaseFiles(const QString &rule, const QString &filePath, QMap<int, QString> &result,
+                                  QMap<QString, QStringList> &entryCache)
+{
+    // replace the indexes by characters which never appear in a path, and turn them into a regex of the file name
+    const QChar zeroIndex(1), oneIndex(2);
+    auto markedRule = rule;
+    markedRule.replace("${0-index}", QString(zeroIndex)).replace("${1-index}", QString(oneIndex));
+    QFileInfo markedInfo(testCaseFilePath(markedRule, filePath, 0));
+    auto dirPath = markedInfo.path();
+    auto fileName = markedInfo.fileName();
+
+    if (dirPath.contains(zeroIndex) || dirPath.contains(oneIndex))
+        return false;
+
+    QString pattern = "^";
+    QString literal;
+    int offset = -1;
+    for (auto c : fileName)
+    {
+        if (c == zeroIndex || c == oneIndex)
+        {
+            pattern += QRegularExpression::escape(literal) + "(\\d+)";
+            literal.clear();
+            if (offset == -1)
+                offset = c == zeroIndex ? 0 : 1;
+        }
+        else
+        {
+            literal += c;
+        }
+    }
+    pattern += QRegularExpression::escape(literal) + "$";
+
+    // the same file for all testcases, it can't be told from a listing
+    if (offset == -1)
+        return false;
+
+    if (!entryCache.contains(dirPath))
+        entryCache[dirPath] = QDir(dirPath).entryList(QDir::Files | QDir::Hidden);
+
+    QRegularExpression regex(pattern);
+    for (auto const &entry : entryCache[dirPath])
+    {
+        auto match = regex.match(entry);
+        if (!match.hasMatch())
+            continue;
+        bool ok = false;
+        int index = match.captured(1).toInt(&ok) - offset;
+        if (!ok || index < 0 || index >= MAX_NUMBER_OF_TESTCASES)
+            continue;
+        // make sure it's exactly the file name given by the rule, e.g. "01" is not "1"
+        auto path = testCaseFilePath(rule, filePath, index);
+        if (QFileInfo(path).fileName() == entry)
+            result[index] = path;
+    }
+
+    return true;
+}
+
 void TestCases::updateVerdicts()
 {
     int ac = 0, wa = 0;
@@ -484,8 +1331,11 @@ void TestCases::updateVerdicts()
             break;
         }
     }
+    auto total = QString::number(count());
+    if (!archivedTestCases.isEmpty())
+        total += QString(" (+%1 archived)").arg(archivedTestCases.count());
     verdicts->setText("<span style=\"color:red\">" + QString::number(wa) + "</span> / <span style=\"color:green\">" +
-                      QString::number(ac) + "</span> / " + QString::number(count()));
+                      QString::number(ac) + "</span> / " + total);
 }
 
 QString TestCases::inputFilePath(const QString &filePath, int index)
@@ -498,6 +1348,11 @@ QString TestCases::answerFilePath(const QString &filePath, int index)
     return testCaseFilePath(SettingsHelper::getAnswerFileSavePath(), filePath, index);
 }
 
+QString TestCases::archiveFilePath(const QString &filePath)
+{
+    return testCaseFilePath(SettingsHelper::getTestcaseArchiveSavePath(), filePath, 0);
+}
+
 QString TestCases::testCaseFilePath(QString rule, const QString &filePath, int index)
 {
     QFileInfo fileInfo(filePath);
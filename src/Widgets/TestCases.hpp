@@ -19,13 +19,19 @@
 #define TESTCASES_HPP
 
 #include "Core/Checker.hpp"
+#include "Core/TestCaseArchive.hpp"
+#include <QHash>
+#include <QMap>
+#include <QPointer>
 #include <QWidget>
 
 class MessageLogger;
 class QComboBox;
+template <typename T> class QFutureWatcher;
 class QHBoxLayout;
 class QLabel;
 class QMenu;
+class QProgressDialog;
 class QPushButton;
 class QScrollArea;
 class QVBoxLayout;
@@ -40,6 +46,7 @@ class TestCases : public QWidget
 
   public:
     explicit TestCases(MessageLogger *logger, QWidget *parent = nullptr);
+    ~TestCases() override;
 
     QString input(int index) const;
     QString output(int index) const;
@@ -68,6 +75,7 @@ class TestCases : public QWidget
     QStringList customCheckers() const;
     QString checkerText() const;
     Core::Checker::CheckerType checkerType() const;
+    static Core::Checker::CheckerType checkerTypeOf(int index);
 
     void setShow(int index, bool show);
     bool isShow(int index) const;
@@ -77,21 +85,81 @@ class TestCases : public QWidget
 
     QString loadTestCaseFromFile(const QString &path, const QString &head);
 
+    static QString inputFilePath(const QString &filePath, int index);
+    static QString answerFilePath(const QString &filePath, int index);
+    static QString archiveFilePath(const QString &filePath);
+
     void setTestCaseEditFont(const QFont &font);
 
+    // a testcase file to be loaded or saved in the background, and the result of it
+    struct TestCaseFile
+    {
+        enum Status
+        {
+            Pending, // not loaded or saved yet
+            Loaded,  // loaded successfully
+            Saved,   // saved successfully
+            TooLong, // longer than the Load Test Case File Length Limit
+            Failed   // failed to open or write the file
+        };
+
+        int index;
+        bool isInput;
+        QString path;
+        int lengthLimit;
+        Status status;
+        QString content;
+    };
+
+    // read a testcase file in a worker thread, used by loadFromSavedFiles() and the benchmarks
+    static TestCaseFile readTestCaseFile(TestCaseFile file);
+    // find the testcase files saved with a source file by the save path rules, by the indexes of the testcases
+    static void findSavedFiles(const QString &filePath, QMap<int, QString> &inputPaths,
+                               QMap<int, QString> &answerPaths);
+
   public slots:
     void setVerdict(int index, Core::Checker::Verdict verdict);
 
   signals:
     void checkerChanged();
     void requestRun(int index);
+    void requestMinimize(int index);
 
   private slots:
     void on_addButton_clicked();
     void on_addCheckerButton_clicked();
     void onChildDeleted(TestCase *widget);
+    void onTestCaseFileLoaded(int resultIndex);
+    void onTestCaseFilesSaved();
+    void onTestCaseArchiveSaved();
+    void onTestCaseFilesImported();
 
   private:
+    // the testcases read from a TestCaseArchive in the background
+    struct ArchiveContent
+    {
+        QStringList inputs;   // the inputs read successfully
+        QStringList answers;  // the answers of the inputs
+        QVector<int> indexes; // the indexes of the inputs in the archive
+        QVector<int> kept;    // the indexes of the testcases which are not read, because of the limits
+        int total = 0;        // the number of testcases in the archive
+        QStringList errors;   // the reasons of the failures
+    };
+
+    // the testcases to be saved in an archive in the background, and the result of it
+    struct ArchiveSave
+    {
+        QString path;                                       // the path to the archive
+        QStringList inputs;                                 // the inputs of the testcases shown in the editor
+        QStringList answers;                                // the answers of the testcases shown in the editor
+        QVector<Core::TestCaseArchive::Reference> archived; // the testcases in archives, written after the shown ones
+        bool keepRest = false;                              // whether to keep the rest of the old archive at path
+        bool safe = true;                                   // whether to write to a temporary file first
+        int shownCount = 0;                                 // the number of shown testcases written
+        int archivedCount = 0;                              // the number of testcases written after the shown ones
+        QString error;                                      // the reason of the failure, null on success
+    };
+
     static const int MAX_NUMBER_OF_TESTCASES = 100;
     QVBoxLayout *mainLayout = nullptr, *scrollAreaLayout = nullptr;
     QHBoxLayout *titleLayout = nullptr, *checkerLayout = nullptr;
@@ -104,11 +172,46 @@ class TestCases : public QWidget
     QList<TestCase *> testcases;
     MessageLogger *log;
     bool choosingChecker = false;
+    QFutureWatcher<TestCaseFile> *loadWatcher = nullptr;
+    QVector<QPointer<TestCase>> loadingTestCases; // the testcases being loaded, by the indexes of their files
+    QFutureWatcher<QVector<TestCaseFile>> *saveWatcher = nullptr;
+    QString savedFilePath;                // the source file path which the testcase files belong to
+    QStringList savedRules;               // the save path rules used to find the testcase files
+    QHash<QString, QByteArray> savedHash; // the hashes of the testcase files on the disk, empty if it's unknown
+    bool hasPendingSave = false;          // whether to save again after the running save is finished
+    bool pendingSaveSafe = false;
+    QString pendingSaveFilePath;
+    QVector<Core::TestCaseArchive::Reference> archivedTestCases; // the testcases kept in archives but not shown
+    QFutureWatcher<ArchiveContent> *archiveLoadWatcher = nullptr; // the running load of the archive, if any
+    QFutureWatcher<ArchiveSave> *archiveSaveWatcher = nullptr;
+    QString savedArchivePath;     // the archive where the testcases are saved, empty if it's unknown
+    QByteArray savedArchiveHash;  // the hash of the shown testcases in savedArchivePath, empty if it's unknown
+    QByteArray savingArchiveHash; // the hash of the shown testcases being saved
+    QVector<Core::TestCaseArchive::Reference> savingArchived; // archivedTestCases when the running save started
+    QFutureWatcher<TestCaseFile> *importWatcher = nullptr;
+    QProgressDialog *importProgress = nullptr;
+    int importPairCount = 0; // the number of testcases being imported, the index of a TestCaseFile is in [0, this)
+    // whether a directory is being walked before importing its files
+    bool isListingDirectory = false;
 
     void updateVerdicts();
-    QString inputFilePath(const QString &filePath, int index);
-    QString answerFilePath(const QString &filePath, int index);
-    QString testCaseFilePath(QString rule, const QString &filePath, int index);
+    void cancelLoading();
+    void importTestCaseDirectory(const QString &dir);
+    void importTestCaseFiles(const QStringList &paths);
+    void logTestCaseFileError(const TestCaseFile &file);
+    void importArchive(const QString &path);
+    void exportArchive(const QString &path);
+    static ArchiveContent readArchive(const QString &path, int limit, int lengthLimit);
+    void loadFromArchive(const QString &filePath);
+    bool collectArchiveSave(const QString &filePath, bool safe, ArchiveSave &save);
+    static ArchiveSave writeArchive(ArchiveSave save);
+    static QByteArray archiveHash(const QStringList &inputs, const QStringList &answers);
+    static QVector<TestCaseFile> writeTestCaseFiles(QVector<TestCaseFile> files, const QStringList &removedPaths,
+                                                    bool safe);
+    void collectChangedFiles(const QString &filePath, QVector<TestCaseFile> &files, QStringList &removedPaths);
+    static bool findTestCaseFiles(const QString &rule, const QString &filePath, QMap<int, QString> &result,
+                                  QMap<QString, QStringList> &entryCache);
+    static QString testCaseFilePath(QString rule, const QString &filePath, int index);
 };
 } // namespace Widgets
 #endif // TESTCASES_HPP
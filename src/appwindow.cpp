@@ -17,8 +17,12 @@
 
 #include "appwindow.hpp"
 #include "../ui/ui_appwindow.h"
+#include "Core/Checker.hpp"
 #include "Core/EventLogger.hpp"
 #include "Core/MessageLogger.hpp"
+#include "Core/SaveService.hpp"
+#include "Core/SessionStore.hpp"
+#include "Core/StartupTrace.hpp"
 #include "Extensions/CFTool.hpp"
 #include "Extensions/CompanionServer.hpp"
 #include "Extensions/EditorTheme.hpp"
@@ -27,11 +31,16 @@
 #include "Settings/PreferencesWindow.hpp"
 #include "Telemetry/UpdateNotifier.hpp"
 #include "Util/FileUtil.hpp"
+#include "Widgets/LanguageServerStats.hpp"
+#include "Widgets/TestCases.hpp"
 #include "mainwindow.hpp"
+#include <QAtomicInt>
 #include <QClipboard>
+#include <QCryptographicHash>
 #include <QDesktopServices>
 #include <QDragEnterEvent>
 #include <QFileDialog>
+#include <QFutureWatcher>
 #include <QInputDialog>
 #include <QJsonDocument>
 #include <QMessageBox>
@@ -39,9 +48,11 @@
 #include <QProgressDialog>
 #include <QShortcut>
 #include <QSplitter>
+#include <QStandardPaths>
 #include <QTabBar>
 #include <QTimer>
 #include <QUrl>
+#include <QtConcurrent>
 #include <findreplacedialog.h>
 #include <generated/SettingsHelper.hpp>
 #include <generated/version.hpp>
@@ -52,6 +63,12 @@
 #include <QStyleFactory>
 #endif
 
+// an unchanged tab which is not used for this long is turned into a placeholder to save memory
+static const qint64 PLACEHOLDER_IDLE_TIME = 10 * 60 * 1000;
+
+// Competitive Companion sends the problems of a contest one by one, a burst ends when nothing arrives for this long
+static const int COMPANION_BURST_INTERVAL = 1000;
+
 AppWindow::AppWindow(bool noHotExit, QWidget *parent) : QMainWindow(parent), ui(new Ui::AppWindow)
 {
     LOG_INFO(BOOL_INFO_OF(noHotExit))
@@ -59,6 +76,7 @@ AppWindow::AppWindow(bool noHotExit, QWidget *parent) : QMainWindow(parent), ui(
     setAcceptDrops(true);
     allocate();
     setConnections();
+    Core::StartupTrace::mark("Allocate window");
 
 #ifdef Q_OS_WIN
     QSettings settings("HKEY_CURRENT_USER\\Software\\Microsoft\\Windows\\CurrentVersion\\Themes\\Personalize",
@@ -75,9 +93,6 @@ AppWindow::AppWindow(bool noHotExit, QWidget *parent) : QMainWindow(parent), ui(
     QApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);
     setWindowIcon(QIcon(":/icon.png"));
 
-    if (SettingsHelper::isCheckUpdate())
-        updater->checkUpdate();
-
 #ifdef Q_OS_WIN
     // setWindowOpacity(0.99) when opacity should be 100 is a workaround for a strange issue on Windows
     // The behavior: If the opacity is 100, and the window is maximized, it will resize to smaller than maximized
@@ -91,7 +106,9 @@ AppWindow::AppWindow(bool noHotExit, QWidget *parent) : QMainWindow(parent), ui(
 
     applySettings();
     onSettingsApplied("");
+    Core::StartupTrace::mark("Apply settings");
 
+    bool restored = false;
     do
     {
         if (noHotExit || (!SettingsHelper::isForceClose() && !SettingsHelper::isHotExitEnable()))
@@ -109,37 +126,21 @@ AppWindow::AppWindow(bool noHotExit, QWidget *parent) : QMainWindow(parent), ui(
                 break;
         }
 
-        int length = SettingsHelper::getHotExitTabCount();
-
-        QProgressDialog progress(this);
-        progress.setWindowModality(Qt::WindowModal);
-        progress.setWindowTitle("Restoring Last Session");
-        progress.setMaximum(length);
-        progress.setValue(0);
-
-        auto oldSize = size();
-        setUpdatesEnabled(false);
-
-        for (int i = 0; i < length; ++i)
-        {
-            if (progress.wasCanceled())
-                break;
-            auto status = MainWindow::EditorStatus(SettingsManager::get(QString("Editor Status/%1").arg(i)).toMap());
-            progress.setValue(i);
-            openTab("");
-            currentWindow()->loadStatus(status);
-            progress.setLabelText(currentWindow()->getTabTitle(true, false));
-        }
-
-        progress.setValue(length);
+        restoreSession(!sessionStore->hasSession());
+        restored = true;
+    } while (false);
 
-        setUpdatesEnabled(true);
-        resize(oldSize);
+    if (!restored)
+        sessionStore->clear();
+    // the hot exit status of an old version is only restored once, it's saved in the session store from now on
+    SettingsManager::remove(SettingsManager::keyStartsWith("Editor Status/"));
+    SettingsHelper::setHotExitTabCount(0);
+    SettingsHelper::setHotExitCurrentIndex(-1);
 
-        int currentIndex = SettingsHelper::getHotExitCurrentIndex();
-        if (currentIndex >= 0 && currentIndex < ui->tabWidget->count())
-            ui->tabWidget->setCurrentIndex(currentIndex);
-    } while (false);
+    // started after restoring, so that the tabs which are not restored yet are not removed from the session
+    sessionTimer->start();
+    placeholderTimer->start();
+    Core::StartupTrace::mark("Restore session");
 }
 
 AppWindow::AppWindow(int depth, bool cpp, bool java, bool python, bool noHotExit, const QStringList &paths,
@@ -147,8 +148,10 @@ AppWindow::AppWindow(int depth, bool cpp, bool java, bool python, bool noHotExit
     : AppWindow(noHotExit, parent)
 {
     openPaths(paths, cpp, java, python, depth);
-    if (ui->tabWidget->count() == 0)
+    // an empty tab is opened after the folders are walked if no file is found
+    if (ui->tabWidget->count() == 0 && runningFolderWalks == 0)
         openTab("");
+    Core::StartupTrace::mark("Open files");
 
 #ifdef Q_OS_WIN
     // This is necessary because of setWindowOpacity(0.99) earlier
@@ -170,6 +173,7 @@ AppWindow::AppWindow(bool cpp, bool java, bool python, bool noHotExit, int numbe
     openContest(path, lang, number);
     if (ui->tabWidget->count() == 0)
         openTab("");
+    Core::StartupTrace::mark("Open contest");
 
 #ifdef Q_OS_WIN
     // This is necessary because of setWindowOpacity(0.99) earlier
@@ -192,6 +196,11 @@ AppWindow::~AppWindow()
     delete ui;
     delete preferencesWindow;
     delete autoSaveTimer;
+    delete saveService;
+    delete sessionTimer;
+    delete sessionStore;
+    delete placeholderTimer;
+    delete companionTimer;
     delete lspTimerCpp;
     delete lspTimerJava;
     delete lspTimerPython;
@@ -216,6 +225,19 @@ void AppWindow::closeEvent(QCloseEvent *event)
         event->ignore();
 }
 
+void AppWindow::showEvent(QShowEvent *event)
+{
+    QMainWindow::showEvent(event);
+    if (!isDeferredInitialized)
+    {
+        // queued, so that the window is painted before the deferred subsystems are initialized
+        QTimer::singleShot(0, this, [this] {
+            Core::StartupTrace::mark("Start event loop");
+            initDeferred();
+        });
+    }
+}
+
 void AppWindow::dragEnterEvent(QDragEnterEvent *event)
 {
     if (event->mimeData()->hasUrls())
@@ -243,16 +265,16 @@ void AppWindow::setConnections()
     connect(ui->tabWidget->tabBar(), SIGNAL(customContextMenuRequested(const QPoint &)), this,
             SLOT(onTabContextMenuRequested(const QPoint &)));
     connect(autoSaveTimer, SIGNAL(timeout()), this, SLOT(onSaveTimerElapsed()));
+    connect(saveService, SIGNAL(finished(const Core::SaveResult &)), this,
+            SLOT(onAutoSaved(const Core::SaveResult &)));
+    connect(sessionTimer, SIGNAL(timeout()), this, SLOT(onSessionTimerElapsed()));
+    connect(placeholderTimer, SIGNAL(timeout()), this, SLOT(onPlaceholderTimerElapsed()));
+    connect(companionTimer, SIGNAL(timeout()), this, SLOT(onCompanionTimerElapsed()));
 
     connect(lspTimerCpp, SIGNAL(timeout()), this, SLOT(onLSPTimerElapsedCpp()));
     connect(lspTimerJava, SIGNAL(timeout()), this, SLOT(onLSPTimerElapsedJava()));
     connect(lspTimerPython, SIGNAL(timeout()), this, SLOT(onLSPTimerElapsedPython()));
 
-    connect(preferencesWindow, SIGNAL(settingsApplied(const QString &)), this,
-            SLOT(onSettingsApplied(const QString &)));
-
-    connect(server, &Extensions::CompanionServer::onRequestArrived, this, &AppWindow::onIncomingCompanionRequest);
-
     connect(trayIcon, SIGNAL(activated(QSystemTrayIcon::ActivationReason)), this,
             SLOT(onTrayIconActivated(QSystemTrayIcon::ActivationReason)));
     connect(trayIcon, SIGNAL(messageClicked()), this, SLOT(showOnTop()));
@@ -261,26 +283,28 @@ void AppWindow::setConnections()
 void AppWindow::allocate()
 {
     SettingsManager::init();
+    Core::StartupTrace::mark("Load settings");
     autoSaveTimer = new QTimer();
+    saveService = new Core::SaveService();
+    sessionStore =
+        new Core::SessionStore(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/session");
+    sessionTimer = new QTimer();
+    placeholderTimer = new QTimer();
+    companionTimer = new QTimer();
     lspTimerCpp = new QTimer();
     lspTimerJava = new QTimer();
     lspTimerPython = new QTimer();
-    updater = new Telemetry::UpdateNotifier(SettingsHelper::isBeta());
-    preferencesWindow = new PreferencesWindow(this);
+    autoSaveTimer->setInterval(3000);
+    autoSaveTimer->setSingleShot(false);
 
-    server = new Extensions::CompanionServer(SettingsHelper::getCompetitiveCompanionConnectionPort());
+    sessionTimer->setInterval(5000);
+    sessionTimer->setSingleShot(false);
 
-    cppServer = new Extensions::LanguageServer("cpp"); // These are language code set by Language server protocol
-    javaServer = new Extensions::LanguageServer("java");
-    pythonServer = new Extensions::LanguageServer("python");
+    placeholderTimer->setInterval(60 * 1000);
+    placeholderTimer->setSingleShot(false);
 
-    findReplaceDialog = new FindReplaceDialog(this);
-    findReplaceDialog->setModal(false);
-    findReplaceDialog->setWindowFlags(Qt::Window | Qt::WindowMinimizeButtonHint | Qt::WindowMaximizeButtonHint |
-                                      Qt::WindowCloseButtonHint);
-
-    autoSaveTimer->setInterval(3000);
-    autoSaveTimer->setSingleShot(false);
+    companionTimer->setInterval(COMPANION_BURST_INTERVAL);
+    companionTimer->setSingleShot(true);
 
     lspTimerCpp->setInterval(SettingsHelper::getLSPDelayCpp());
     lspTimerJava->setInterval(SettingsHelper::getLSPDelayJava());
@@ -300,6 +324,50 @@ void AppWindow::allocate()
     trayIcon->show();
 }
 
+void AppWindow::initDeferred()
+{
+    // the subsystems which are not needed to show the window, they are created after the window is shown or when
+    // they are used for the first time, whichever is earlier
+    if (isDeferredInitialized)
+        return;
+    isDeferredInitialized = true;
+    LOG_INFO("Initializing the deferred subsystems");
+
+    preferencesWindow = new PreferencesWindow(this);
+    connect(preferencesWindow, SIGNAL(settingsApplied(const QString &)), this,
+            SLOT(onSettingsApplied(const QString &)));
+
+    findReplaceDialog = new FindReplaceDialog(this);
+    findReplaceDialog->setModal(false);
+    findReplaceDialog->setWindowFlags(Qt::Window | Qt::WindowMinimizeButtonHint | Qt::WindowMaximizeButtonHint |
+                                      Qt::WindowCloseButtonHint);
+
+    server = new Extensions::CompanionServer(SettingsHelper::isCompetitiveCompanionEnable()
+                                                 ? SettingsHelper::getCompetitiveCompanionConnectionPort()
+                                                 : 0);
+    connect(server, &Extensions::CompanionServer::onRequestArrived, this, &AppWindow::onIncomingCompanionRequest);
+
+    // the language servers are started in their constructors if they are enabled
+    cppServer = new Extensions::LanguageServer("cpp"); // These are language code set by Language server protocol
+    javaServer = new Extensions::LanguageServer("java");
+    pythonServer = new Extensions::LanguageServer("python");
+
+    updater = new Telemetry::UpdateNotifier(SettingsHelper::isBeta());
+    if (SettingsHelper::isCheckUpdate())
+        updater->checkUpdate();
+
+    // attach the subsystems to the current tab like onTabChanged() does
+    auto tmp = currentWindow();
+    if (tmp != nullptr)
+    {
+        findReplaceDialog->setTextEdit(tmp->getEditor());
+        server->setMessageLogger(activeLogger);
+        reAttachLanguageServer(tmp);
+    }
+
+    Core::StartupTrace::finish("Initialize deferred subsystems");
+}
+
 void AppWindow::applySettings()
 {
     LOG_INFO("Applying settings to Application from Settings");
@@ -376,8 +444,12 @@ bool AppWindow::closeTab(int index)
     auto tmp = windowAt(index);
     if (tmp->closeConfirm())
     {
+        sessionStore->remove(sessionIDs.take(tmp));
+        sessionChangedWindows.remove(tmp);
         ui->tabWidget->removeTab(index);
         onEditorFileChanged();
+        if (isDeferredInitialized && tmp->isMaterialized())
+            closeLanguageServerDocuments(tmp->getEditor());
         delete tmp;
         return true;
     }
@@ -392,9 +464,9 @@ void AppWindow::saveSettings()
     // findReplaceDialog->writeSettings(*SettingsHelper::settings()); FIX IT!!!
 }
 
-void AppWindow::openTab(const QString &path)
+int AppWindow::openTab(const QString &path, bool activate)
 {
-    LOG_INFO("OpenTab Path is " << path);
+    LOG_INFO("OpenTab Path is " << path << BOOL_INFO_OF(activate));
     if (QFile::exists(path))
     {
         auto fileInfo = QFileInfo(path);
@@ -403,17 +475,18 @@ void AppWindow::openTab(const QString &path)
             auto tmp = qobject_cast<MainWindow *>(ui->tabWidget->widget(t));
             if (fileInfo == QFileInfo(tmp->getFilePath()))
             {
-                ui->tabWidget->setCurrentIndex(t);
-                return;
+                if (activate)
+                    ui->tabWidget->setCurrentIndex(t);
+                return t;
             }
         }
     }
 
-    auto fsp = new MainWindow(path, getNewUntitledIndex(), this);
+    // a tab which is not activated is a placeholder, it's materialized when it becomes the current tab
+    auto fsp = new MainWindow(path, getNewUntitledIndex(), this, !activate);
+    sessionIDs[fsp] = Core::SessionStore::newTab();
     connect(fsp, SIGNAL(confirmTriggered(MainWindow *)), this, SLOT(on_confirmTriggered(MainWindow *)));
     connect(fsp, SIGNAL(editorFileChanged()), this, SLOT(onEditorFileChanged()));
-    connect(fsp, SIGNAL(editorTmpPathChanged(MainWindow *, const QString &)), this,
-            SLOT(onEditorTmpPathChanged(MainWindow *, const QString &)));
     connect(fsp, SIGNAL(editorLanguageChanged(MainWindow *)), this, SLOT(onEditorLanguageChanged(MainWindow *)));
     connect(fsp, SIGNAL(editorTextChanged(MainWindow *)), this, SLOT(onEditorTextChanged(MainWindow *)));
     connect(fsp, SIGNAL(requestToastMessage(const QString &, const QString &)), trayIcon,
@@ -431,11 +504,20 @@ void AppWindow::openTab(const QString &path)
     else if (Util::pythonSuffix.contains(suffix))
         lang = "Python";
 
-    ui->tabWidget->setCurrentIndex(ui->tabWidget->addTab(fsp, fsp->getTabTitle(false, true)));
+    int index = ui->tabWidget->addTab(fsp, fsp->getTabTitle(false, true));
+    if (!activate)
+    {
+        // the titles are updated by the caller after opening all tabs
+        fsp->setLanguage(lang);
+        return index;
+    }
+
+    ui->tabWidget->setCurrentIndex(index);
     fsp->setLanguage(lang);
 
     currentWindow()->getEditor()->setFocus();
     onEditorFileChanged();
+    return index;
 }
 
 void AppWindow::openTabs(const QStringList &paths)
@@ -452,37 +534,81 @@ void AppWindow::openTabs(const QStringList &paths)
     auto oldSize = size();
     setUpdatesEnabled(false);
 
+    int lastIndex = -1;
     for (int i = 0; i < length; ++i)
     {
         if (progress.wasCanceled())
             break;
         progress.setValue(i);
-        openTab(paths[i]);
-        progress.setLabelText(currentWindow()->getTabTitle(true, false));
+        lastIndex = openTab(paths[i], false);
+        progress.setLabelText(windowAt(lastIndex)->getTabTitle(true, false));
     }
 
     setUpdatesEnabled(true);
     resize(oldSize);
 
     progress.setValue(length);
+
+    // only the last opened tab is materialized
+    if (lastIndex != -1)
+    {
+        ui->tabWidget->setCurrentIndex(lastIndex);
+        currentWindow()->getEditor()->setFocus();
+    }
+    onEditorFileChanged();
 }
 
 void AppWindow::openPaths(const QStringList &paths, bool cpp, bool java, bool python, int depth)
 {
     LOG_INFO("Open Path with arguments " << BOOL_INFO_OF(cpp) << BOOL_INFO_OF(java) << BOOL_INFO_OF(python)
                                          << INFO_OF(depth) << INFO_OF(paths.join(" ")));
-    QStringList res;
+
+    bool hasFolder = false;
     for (auto &path : paths)
+        hasFolder = hasFolder || QDir(path).exists();
+    if (!hasFolder)
     {
-        if (QDir(path).exists())
-            res.append(openFolder(path, cpp, java, python, depth));
-        else
-            res.append(path);
+        openTabs(paths);
+        return;
     }
-    openTabs(res);
+
+    // the folders are walked in a worker thread, so that a large folder doesn't freeze the UI,
+    // and the tabs are opened when it's finished
+    auto canceled = QSharedPointer<QAtomicInt>::create(0);
+    auto progress = new QProgressDialog("Looking for source files...", "Cancel", 0, 0, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setWindowTitle("Opening Folders");
+    QTimer::singleShot(500, progress, SLOT(show()));
+    connect(progress, &QProgressDialog::canceled, [canceled] { canceled->storeRelease(1); });
+
+    ++runningFolderWalks;
+    auto watcher = new QFutureWatcher<QStringList>(this);
+    connect(watcher, &QFutureWatcher<QStringList>::finished, this, [this, watcher, progress, canceled] {
+        --runningFolderWalks;
+        watcher->deleteLater();
+        progress->deleteLater();
+        if (canceled->loadAcquire())
+            LOG_INFO("Opening folders is canceled");
+        else
+            openTabs(watcher->result());
+        if (ui->tabWidget->count() == 0)
+            openTab("");
+    });
+    watcher->setFuture(QtConcurrent::run([paths, cpp, java, python, depth, canceled] {
+        QStringList res;
+        for (auto &path : paths)
+        {
+            if (QDir(path).exists())
+                res.append(openFolder(path, cpp, java, python, depth, canceled.data()));
+            else
+                res.append(path);
+        }
+        return res;
+    }));
 }
 
-QStringList AppWindow::openFolder(const QString &path, bool cpp, bool java, bool python, int depth)
+QStringList AppWindow::openFolder(const QString &path, bool cpp, bool java, bool python, int depth,
+                                  const QAtomicInt *canceled)
 {
     LOG_INFO("Open folder with arguments " << BOOL_INFO_OF(cpp) << BOOL_INFO_OF(java) << BOOL_INFO_OF(python)
                                            << INFO_OF(depth) << INFO_OF(path));
@@ -490,12 +616,14 @@ QStringList AppWindow::openFolder(const QString &path, bool cpp, bool java, bool
     QStringList res;
     for (auto &entry : entries)
     {
+        if (canceled->loadAcquire())
+            break;
         if (entry.isDir())
         {
             if (depth > 0)
-                res.append(openFolder(entry.canonicalFilePath(), cpp, java, python, depth - 1));
+                res.append(openFolder(entry.canonicalFilePath(), cpp, java, python, depth - 1, canceled));
             else if (depth == -1)
-                res.append(openFolder(entry.canonicalFilePath(), cpp, java, python, -1));
+                res.append(openFolder(entry.canonicalFilePath(), cpp, java, python, -1, canceled));
         }
         else if ((cpp && Util::cppSuffix.contains(entry.suffix())) ||
                  (java && Util::javaSuffix.contains(entry.suffix())) ||
@@ -533,32 +661,241 @@ void AppWindow::openContest(const QString &path, const QString &lang, int number
     openTabs(tabs);
 }
 
-void AppWindow::saveEditorStatus()
+void AppWindow::applyCompanion(const Extensions::CompanionData &data)
+{
+    for (int i = 0; i < ui->tabWidget->count(); ++i)
+    {
+        if (windowAt(i)->getProblemURL() == data.url)
+        {
+            ui->tabWidget->setCurrentIndex(i);
+            return;
+        }
+    }
+
+    if (SettingsHelper::isOpenOldFileForOldProblemUrl() && FileProblemBinder::containsProblem(data.url))
+        openTab(FileProblemBinder::getFileForProblem(data.url));
+    else if (SettingsHelper::isCompetitiveCompanionOpenNewTab() || currentWindow() == nullptr)
+        openTab("");
+
+    currentWindow()->applyCompanion(data);
+}
+
+void AppWindow::openCompanionContest(const QVector<Extensions::CompanionData> &problems)
+{
+    LOG_INFO(INFO_OF(problems.size()));
+
+    auto lang = SettingsHelper::getDefaultLanguage();
+    auto templateCode = Util::readFile(SettingsManager::get(QString("%1/Template Path").arg(lang)).toString());
+    if (templateCode.isNull())
+        templateCode = "";
+    QString suffix = lang == "Python" ? "py" : lang == "Java" ? "java" : "cpp";
+
+    // the paths are decided here, because the settings are not read in the worker thread
+    QVector<Extensions::CompanionData> newProblems;
+    QStringList paths;
+    QVector<QPair<QString, QString>> files;
+    QSet<QString> urls;
+    for (int i = 0; i < ui->tabWidget->count(); ++i)
+        urls.insert(windowAt(i)->getProblemURL());
+
+    for (const auto &data : problems)
+    {
+        if (urls.contains(data.url))
+            continue; // the problem is already opened
+        urls.insert(data.url);
+
+        QString path;
+        if (SettingsHelper::isOpenOldFileForOldProblemUrl() && FileProblemBinder::containsProblem(data.url))
+        {
+            path = FileProblemBinder::getFileForProblem(data.url);
+        }
+        else
+        {
+            // the file is created from the template only if the user has chosen where it's saved
+            path = MainWindow::defaultFilePathForProblemURL(data.url);
+            if (path.isEmpty() || QFileInfo(path).isRelative())
+                path.clear();
+            else if (!QFile::exists(path += "." + suffix))
+            {
+                files.push_back({path, MainWindow::companionMeta(data, lang) + "\n\n" + templateCode});
+                if (SettingsHelper::isSaveTests())
+                {
+                    for (int j = 0; j < data.testcases.size(); ++j)
+                    {
+                        files.push_back({Widgets::TestCases::inputFilePath(path, j), data.testcases[j].input});
+                        files.push_back({Widgets::TestCases::answerFilePath(path, j), data.testcases[j].output});
+                    }
+                }
+            }
+        }
+
+        newProblems.push_back(data);
+        paths.push_back(path);
+    }
+
+    if (newProblems.isEmpty())
+        return;
+
+    // the files are written in a worker thread, the tabs are opened when they are on the disk
+    auto watcher = new QFutureWatcher<QStringList>(this);
+    connect(watcher, &QFutureWatcher<QStringList>::finished, this, [this, watcher, newProblems, paths] {
+        auto failedPaths = watcher->result();
+        watcher->deleteLater();
+        auto openedPaths = paths;
+        for (auto &path : openedPaths)
+        {
+            if (failedPaths.contains(path))
+                path.clear(); // it's opened as an untitled tab instead
+        }
+        openCompanionTabs(newProblems, openedPaths);
+    });
+    watcher->setFuture(QtConcurrent::run(&AppWindow::writeCompanionFiles, files));
+}
+
+void AppWindow::openCompanionTabs(const QVector<Extensions::CompanionData> &problems, const QStringList &paths)
+{
+    LOG_INFO(INFO_OF(problems.size()));
+
+    // the new tabs use the checker of the current tab, unless it's a custom checker
+    int checkerIndex = 0;
+    if (currentWindow() != nullptr && currentWindow()->isMaterialized())
+        checkerIndex = currentWindow()->toStatus().checkerIndex;
+    if (Widgets::TestCases::checkerTypeOf(checkerIndex) == Core::Checker::Custom)
+        checkerIndex = 0;
+
+    auto oldSize = size();
+    setUpdatesEnabled(false);
+
+    // all tabs are placeholders, only the first problem is materialized
+    int firstIndex = -1;
+    for (int i = 0; i < problems.size(); ++i)
+    {
+        int index = openTab(paths[i], false);
+        windowAt(index)->applyCompanion(problems[i], checkerIndex);
+        if (firstIndex == -1)
+            firstIndex = index;
+    }
+
+    setUpdatesEnabled(true);
+    resize(oldSize);
+
+    if (firstIndex != -1)
+    {
+        ui->tabWidget->setCurrentIndex(firstIndex);
+        currentWindow()->getEditor()->setFocus();
+    }
+    onEditorFileChanged();
+
+    // the checker is compiled in the background, so the new tabs don't wait for it when they are run
+    Core::Checker::prebuild(Widgets::TestCases::checkerTypeOf(checkerIndex),
+                            SettingsManager::get("C++/Compile Command").toString());
+}
+
+QStringList AppWindow::writeCompanionFiles(const QVector<QPair<QString, QString>> &files)
+{
+    QStringList failedPaths;
+    for (const auto &file : files)
+    {
+        if (!Util::saveFile(file.first, file.second, "Competitive Companion", false, nullptr, true))
+            failedPaths.push_back(file.first);
+    }
+    return failedPaths;
+}
+
+void AppWindow::restoreSession(bool legacy)
+{
+    LOG_INFO(BOOL_INFO_OF(legacy));
+
+    QStringList tabs;
+    QList<QVariantMap> summaries;
+    int currentIndex = -1;
+    if (legacy)
+    {
+        // the status saved in the settings file by an old version
+        for (int i = 0; i < SettingsHelper::getHotExitTabCount(); ++i)
+            tabs.push_back(QString("Editor Status/%1").arg(i));
+        currentIndex = SettingsHelper::getHotExitCurrentIndex();
+    }
+    else
+    {
+        tabs = sessionStore->tabs(currentIndex, &summaries);
+    }
+
+    int length = tabs.length();
+
+    QProgressDialog progress(this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setWindowTitle("Restoring Last Session");
+    progress.setMaximum(length);
+    progress.setValue(0);
+
+    auto oldSize = size();
+    setUpdatesEnabled(false);
+
+    for (int i = 0; i < length; ++i)
+    {
+        if (progress.wasCanceled())
+            break;
+        progress.setValue(i);
+        // only the current tab is materialized, the others keep the summary until they are activated
+        auto window = windowAt(openTab("", false));
+        if (legacy)
+        {
+            window->loadStatus(MainWindow::EditorStatus(SettingsManager::get(tabs[i]).toMap()));
+        }
+        else
+        {
+            sessionIDs[window] = tabs[i]; // keep appending to the same journal
+            window->loadSession(sessionStore, tabs[i], summaries[i]); // the journal is read when it's materialized
+        }
+        progress.setLabelText(window->getTabTitle(true, false));
+    }
+
+    progress.setValue(length);
+
+    setUpdatesEnabled(true);
+    resize(oldSize);
+
+    if (currentIndex >= 0 && currentIndex < ui->tabWidget->count())
+        ui->tabWidget->setCurrentIndex(currentIndex);
+    onEditorFileChanged();
+}
+
+void AppWindow::updateSession(bool all)
 {
-    SettingsManager::remove(SettingsManager::keyStartsWith("Editor Status/"));
     if (ui->tabWidget->count() == 1 && windowAt(0)->isUntitled() && !windowAt(0)->isTextChanged() &&
         windowAt(0)->getProblemURL().isEmpty())
     {
-        SettingsHelper::setHotExitTabCount(0);
-        SettingsHelper::setHotExitCurrentIndex(-1);
+        sessionStore->setTabs(QStringList(), QList<QVariantMap>(), -1);
+        sessionChangedWindows.clear();
+        return;
     }
-    else
+
+    // only the changed values are appended to the journals, so it's cheap if nothing is changed
+    QStringList ids;
+    QList<QVariantMap> summaries;
+    for (int i = 0; i < ui->tabWidget->count(); ++i)
     {
-        SettingsHelper::setHotExitTabCount(ui->tabWidget->count());
-        SettingsHelper::setHotExitCurrentIndex(ui->tabWidget->currentIndex());
-        for (int i = 0; i < ui->tabWidget->count(); ++i)
-            SettingsManager::set(QString("Editor Status/%1").arg(i), windowAt(i)->toStatus().toMap());
+        auto window = windowAt(i);
+        // the journal of a tab which is not loaded yet is already up to date
+        if (window->isSessionLoaded() && (all || window == currentWindow() || sessionChangedWindows.contains(window)))
+            sessionStore->update(sessionIDs[window], window->toStatus().toMap());
+        ids.push_back(sessionIDs[window]);
+        summaries.push_back(window->sessionSummary());
     }
+    sessionChangedWindows.clear();
+
+    sessionStore->setTabs(ids, summaries, ui->tabWidget->currentIndex());
 }
 
 bool AppWindow::quit()
 {
-    if (preferencesWindow->isVisible() && !preferencesWindow->close())
+    if (preferencesWindow != nullptr && preferencesWindow->isVisible() && !preferencesWindow->close())
         return false;
     if (SettingsHelper::isHotExitEnable() || SettingsHelper::isForceClose())
     {
         LOG_INFO("quit() with hotexit");
-        saveEditorStatus();
+        updateSession(true);
     }
     else
     {
@@ -759,6 +1096,7 @@ void AppWindow::on_actionRestore_Settings_triggered()
 void AppWindow::on_actionSettings_triggered()
 {
     LOG_INFO("Launching settings window");
+    initDeferred();
     preferencesWindow->display();
 }
 
@@ -817,16 +1155,13 @@ void AppWindow::onTabChanged(int index)
     if (index == -1)
     {
         activeLogger = nullptr;
-        server->setMessageLogger(nullptr);
-        findReplaceDialog->setTextEdit(nullptr);
         setWindowTitle("CP Editor: An editor specially designed for competitive programming");
 
-        if (cppServer->isDocumentOpen())
-            cppServer->closeDocument();
-        if (pythonServer->isDocumentOpen())
-            pythonServer->closeDocument();
-        if (javaServer->isDocumentOpen())
-            javaServer->closeDocument();
+        if (!isDeferredInitialized)
+            return;
+
+        server->setMessageLogger(nullptr);
+        findReplaceDialog->setTextEdit(nullptr);
 
         return;
     }
@@ -835,15 +1170,18 @@ void AppWindow::onTabChanged(int index)
     disconnect(activeRightSplitterMoveConnection);
 
     auto tmp = windowAt(index);
-
-    reAttachLanguageServer(tmp);
-
-    findReplaceDialog->setTextEdit(tmp->getEditor());
+    tmp->materialize();
 
     setWindowTitle(tmp->getCompleteTitle() + " - CP Editor");
 
     activeLogger = tmp->getLogger();
-    server->setMessageLogger(activeLogger);
+
+    if (isDeferredInitialized)
+    {
+        reAttachLanguageServer(tmp);
+        findReplaceDialog->setTextEdit(tmp->getEditor());
+        server->setMessageLogger(activeLogger);
+    }
 
     if (ui->actionEditor_Mode->isChecked())
         on_actionEditor_Mode_triggered();
@@ -900,10 +1238,27 @@ void AppWindow::onEditorFileChanged()
 
         setWindowTitle(currentWindow()->getCompleteTitle() + " - CP Editor");
     }
+
+    // the document path of a language server depends on the file path, e.g. when an untitled tab is saved
+    if (isDeferredInitialized)
+    {
+        for (int t = 0; t < ui->tabWidget->count(); ++t)
+        {
+            auto window = windowAt(t);
+            if (!window->isMaterialized())
+                continue;
+            for (auto server : {cppServer, javaServer, pythonServer})
+            {
+                if (server->isDocumentOpen(window->getEditor()))
+                    server->updatePath(window->getEditor(), server->documentPath(languageServerKey(window)));
+            }
+        }
+    }
 }
 
 void AppWindow::onEditorTextChanged(MainWindow *window)
 {
+    sessionChangedWindows.insert(window);
     int index = ui->tabWidget->indexOf(window);
     if (index != -1)
     {
@@ -915,31 +1270,31 @@ void AppWindow::onEditorTextChanged(MainWindow *window)
             title += " *";
         ui->tabWidget->setTabText(index, title);
 
+        if (!isDeferredInitialized)
+            return;
+
+        // the delay may be adapted to the typing speed and the latency of the server
         if (window->getLanguage() == "C++")
+        {
+            lspTimerCpp->setInterval(cppServer->lintingDelay());
             lspTimerCpp->start();
+        }
         else if (window->getLanguage() == "Java")
+        {
+            lspTimerJava->setInterval(javaServer->lintingDelay());
             lspTimerJava->start();
+        }
         else
+        {
+            lspTimerPython->setInterval(pythonServer->lintingDelay());
             lspTimerPython->start();
-    }
-}
-
-void AppWindow::onEditorTmpPathChanged(MainWindow *window, const QString &path)
-{
-    if (currentWindow() == window)
-    {
-        if (window->getLanguage() == "C++" && cppServer->isDocumentOpen())
-            cppServer->updatePath(path);
-        else if (window->getLanguage() == "Java" && javaServer->isDocumentOpen())
-            javaServer->updatePath(path);
-        else if (window->getLanguage() == "Python" && pythonServer->isDocumentOpen())
-            pythonServer->updatePath(path);
+        }
     }
 }
 
 void AppWindow::onEditorLanguageChanged(MainWindow *window)
 {
-    if (currentWindow() == window)
+    if (isDeferredInitialized && currentWindow() == window)
         reAttachLanguageServer(window);
 }
 
@@ -950,18 +1305,45 @@ void AppWindow::onSaveTimerElapsed()
         auto tmp = windowAt(t);
         if (!tmp->isUntitled())
         {
-            tmp->save(false, "Auto Save", false);
+            tmp->autoSave(saveService);
         }
     }
 }
 
+void AppWindow::onAutoSaved(const Core::SaveResult &result)
+{
+    for (int t = 0; t < ui->tabWidget->count(); t++)
+    {
+        auto tmp = windowAt(t);
+        if (tmp->getFilePath() == result.filePath)
+            tmp->onAutoSaved(result);
+    }
+}
+
+void AppWindow::onSessionTimerElapsed()
+{
+    // the session is also updated when quitting, this is for the case that the application is killed
+    if (SettingsHelper::isHotExitEnable())
+        updateSession(false);
+}
+
+void AppWindow::onPlaceholderTimerElapsed()
+{
+    for (int t = 0; t < ui->tabWidget->count(); ++t)
+    {
+        auto tmp = windowAt(t);
+        if (t != ui->tabWidget->currentIndex() && tmp->isMaterialized() && tmp->idleTime() > PLACEHOLDER_IDLE_TIME)
+            tmp->dematerialize(); // the language servers close the documents of the deleted editor
+    }
+}
+
 void AppWindow::onLSPTimerElapsedCpp()
 {
     auto tab = currentWindow();
     if (tab == nullptr)
         return;
 
-    if (SettingsHelper::isLSPUseLintingCpp() && tab->getLanguage() == "C++")
+    if (cppServer != nullptr && SettingsHelper::isLSPUseLintingCpp() && tab->getLanguage() == "C++")
         cppServer->requestLinting();
 
     lspTimerCpp->stop();
@@ -973,7 +1355,7 @@ void AppWindow::onLSPTimerElapsedJava()
     if (tab == nullptr)
         return;
 
-    if (SettingsHelper::isLSPUseLintingJava() && tab->getLanguage() == "Java")
+    if (javaServer != nullptr && SettingsHelper::isLSPUseLintingJava() && tab->getLanguage() == "Java")
         javaServer->requestLinting();
 
     lspTimerJava->stop();
@@ -985,7 +1367,7 @@ void AppWindow::onLSPTimerElapsedPython()
     if (tab == nullptr)
         return;
 
-    if (SettingsHelper::isLSPUseLintingPython() && tab->getLanguage() == "Python")
+    if (pythonServer != nullptr && SettingsHelper::isLSPUseLintingPython() && tab->getLanguage() == "Python")
         pythonServer->requestLinting();
 
     lspTimerPython->stop();
@@ -1001,13 +1383,13 @@ void AppWindow::onSettingsApplied(const QString &pagePath)
         onEditorTextChanged(windowAt(i));
     }
 
-    if (pagePath.isEmpty() || pagePath == "Advanced/Update")
+    if (updater != nullptr && (pagePath.isEmpty() || pagePath == "Advanced/Update"))
         updater->setBeta(SettingsHelper::isBeta());
 
     if (pagePath.isEmpty() || pagePath == "Key Bindings")
         maybeSetHotkeys();
 
-    if (pagePath.isEmpty() || pagePath == "Extensions/Competitive Companion")
+    if (server != nullptr && (pagePath.isEmpty() || pagePath == "Extensions/Competitive Companion"))
     {
         if (SettingsHelper::isCompetitiveCompanionEnable())
             server->updatePort(SettingsHelper::getCompetitiveCompanionConnectionPort());
@@ -1028,19 +1410,22 @@ void AppWindow::onSettingsApplied(const QString &pagePath)
 
     if (pagePath.isEmpty() || pagePath == "Extensions/Language Server/C++ Server")
     {
-        cppServer->updateSettings();
+        if (cppServer != nullptr)
+            cppServer->updateSettings();
         lspTimerCpp->setInterval(SettingsHelper::getLSPDelayCpp());
     }
 
     if (pagePath.isEmpty() || pagePath == "Extensions/Language Server/Java Server")
     {
-        javaServer->updateSettings();
+        if (javaServer != nullptr)
+            javaServer->updateSettings();
         lspTimerJava->setInterval(SettingsHelper::getLSPDelayJava());
     }
 
     if (pagePath.isEmpty() || pagePath == "Extensions/Language Server/Python Server")
     {
-        pythonServer->updateSettings();
+        if (pythonServer != nullptr)
+            pythonServer->updateSettings();
         lspTimerPython->setInterval(SettingsHelper::getLSPDelayPython());
     }
 }
@@ -1049,21 +1434,27 @@ void AppWindow::onIncomingCompanionRequest(const Extensions::CompanionData &data
 {
     LOG_INFO("Request from competitive companion arrived");
 
-    for (int i = 0; i < ui->tabWidget->count(); ++i)
+    if (SettingsHelper::isCompetitiveCompanionBatchContest() && SettingsHelper::isCompetitiveCompanionOpenNewTab())
     {
-        if (windowAt(i)->getProblemURL() == data.url)
-        {
-            ui->tabWidget->setCurrentIndex(i);
-            return;
-        }
+        // the problems of a contest are opened together when the burst ends
+        companionQueue.push_back(data);
+        companionTimer->start();
+        return;
     }
 
-    if (SettingsHelper::isOpenOldFileForOldProblemUrl() && FileProblemBinder::containsProblem(data.url))
-        openTab(FileProblemBinder::getFileForProblem(data.url));
-    else if (SettingsHelper::isCompetitiveCompanionOpenNewTab() || currentWindow() == nullptr)
-        openTab("");
+    applyCompanion(data);
+}
 
-    currentWindow()->applyCompanion(data);
+void AppWindow::onCompanionTimerElapsed()
+{
+    QVector<Extensions::CompanionData> problems;
+    problems.swap(companionQueue);
+    LOG_INFO(INFO_OF(problems.size()));
+
+    if (problems.size() == 1)
+        applyCompanion(problems.front());
+    else if (!problems.isEmpty())
+        openCompanionContest(problems);
 }
 
 void AppWindow::onViewModeToggle()
@@ -1102,6 +1493,7 @@ void AppWindow::onRightSplitterMoved(int _, int __)
 void AppWindow::on_actionCheck_for_updates_triggered()
 {
     LOG_INFO("Checking update non-silent mode");
+    initDeferred();
     // Non-silent means if a update is not available, still the dialog is shown that no update available.
     updater->checkUpdate(true);
 }
@@ -1127,6 +1519,7 @@ void AppWindow::on_actionRun_triggered()
 void AppWindow::on_action_find_replace_triggered()
 {
     auto tmp = currentWindow();
+    initDeferred();
     if (tmp != nullptr)
         findReplaceDialog->showDialog(tmp->getEditor()->textCursor().selectedText());
 }
@@ -1489,35 +1882,65 @@ MainWindow *AppWindow::currentWindow()
 
 void AppWindow::reAttachLanguageServer(MainWindow *window)
 {
-    window->getEditor()->clearSquiggle();
     lspTimerCpp->stop();
     lspTimerJava->stop();
     lspTimerPython->stop();
 
-    if (cppServer->isDocumentOpen())
-        cppServer->closeDocument();
-    if (javaServer->isDocumentOpen())
-        javaServer->closeDocument();
-    if (pythonServer->isDocumentOpen())
-        pythonServer->closeDocument();
-
+    auto editor = window->getEditor();
+    Extensions::LanguageServer *server = nullptr;
+    QTimer *timer = nullptr;
     if (window->getLanguage() == "C++")
     {
-        cppServer->openDocument(window->tmpPath(), window->getEditor(), window->getLogger());
-        cppServer->requestLinting();
-        lspTimerCpp->start();
+        server = cppServer;
+        timer = lspTimerCpp;
     }
     else if (window->getLanguage() == "Java")
     {
-        javaServer->openDocument(window->tmpPath(), window->getEditor(), window->getLogger());
-        javaServer->requestLinting();
-        lspTimerJava->start();
+        server = javaServer;
+        timer = lspTimerJava;
     }
     else if (window->getLanguage() == "Python")
     {
-        pythonServer->openDocument(window->tmpPath(), window->getEditor(), window->getLogger());
-        pythonServer->requestLinting();
-        lspTimerPython->start();
+        server = pythonServer;
+        timer = lspTimerPython;
+    }
+
+    // the document is open in another server if the language is changed
+    for (auto other : {cppServer, javaServer, pythonServer})
+    {
+        if (other != server && other->isDocumentOpen(editor))
+            other->closeDocument(editor);
+    }
+
+    if (server == nullptr)
+        return;
+
+    // the documents are kept open after switching tabs, so the diagnostics of an open document are already there
+    if (server->isDocumentOpen(editor))
+    {
+        server->updatePath(editor, server->documentPath(languageServerKey(window)));
+        server->activateDocument(editor);
+    }
+    else
+        server->openDocument(server->documentPath(languageServerKey(window)), editor, window->getLogger());
+    server->requestLinting();
+    timer->start();
+}
+
+QString AppWindow::languageServerKey(MainWindow *window) const
+{
+    // the key is stable across sessions, so that the caches of the servers can be reused
+    if (window->isUntitled())
+        return sessionIDs.value(window);
+    return QCryptographicHash::hash(window->getFilePath().toUtf8(), QCryptographicHash::Md5).toHex();
+}
+
+void AppWindow::closeLanguageServerDocuments(QCodeEditor *editor)
+{
+    for (auto server : {cppServer, javaServer, pythonServer})
+    {
+        if (server->isDocumentOpen(editor))
+            server->closeDocument(editor);
     }
 }
 
@@ -1544,6 +1967,15 @@ void AppWindow::on_actionClear_Logs_triggered()
     }
 }
 
+void AppWindow::on_actionLanguage_Server_Statistics_triggered()
+{
+    initDeferred();
+    if (languageServerStats == nullptr)
+        languageServerStats = new Widgets::LanguageServerStats({cppServer, javaServer, pythonServer}, this);
+    languageServerStats->show();
+    languageServerStats->raise();
+}
+
 void AppWindow::showOnTop()
 {
     setWindowState((windowState() & ~Qt::WindowMinimized) | Qt::WindowActive);
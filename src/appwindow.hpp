@@ -18,13 +18,17 @@
 #ifndef APPWINDOW_HPP
 #define APPWINDOW_HPP
 
+#include <QHash>
 #include <QMainWindow>
+#include <QSet>
 #include <QSystemTrayIcon>
 
 class FindReplaceDialog;
 class MainWindow;
 class MessageLogger;
 class PreferencesWindow;
+class QAtomicInt;
+class QCodeEditor;
 class QMenu;
 class QShortcut;
 class QSplitter;
@@ -35,6 +39,13 @@ namespace Ui
 class AppWindow;
 }
 
+namespace Core
+{
+class SaveService;
+struct SaveResult;
+class SessionStore;
+} // namespace Core
+
 namespace Extensions
 {
 class CompanionServer;
@@ -47,6 +58,11 @@ namespace Telemetry
 class UpdateNotifier;
 }
 
+namespace Widgets
+{
+class LanguageServerStats;
+}
+
 class AppWindow : public QMainWindow
 {
     Q_OBJECT
@@ -60,6 +76,7 @@ class AppWindow : public QMainWindow
     ~AppWindow() override;
 
     void closeEvent(QCloseEvent *event) override;
+    void showEvent(QShowEvent *event) override;
     void dropEvent(QDropEvent *event) override;
     void dragEnterEvent(QDragEnterEvent *event) override;
 
@@ -111,8 +128,6 @@ class AppWindow : public QMainWindow
 
     void onEditorTextChanged(MainWindow *window);
 
-    void onEditorTmpPathChanged(MainWindow *window, const QString &path);
-
     void onEditorLanguageChanged(MainWindow *window);
 
     void onTabCloseRequested(int);
@@ -121,6 +136,12 @@ class AppWindow : public QMainWindow
 
     void onSaveTimerElapsed();
 
+    void onAutoSaved(const Core::SaveResult &result);
+
+    void onSessionTimerElapsed();
+
+    void onPlaceholderTimerElapsed();
+
     void onLSPTimerElapsedCpp();
 
     void onLSPTimerElapsedPython();
@@ -135,6 +156,8 @@ class AppWindow : public QMainWindow
 
     void onIncomingCompanionRequest(const Extensions::CompanionData &);
 
+    void onCompanionTimerElapsed();
+
     void onViewModeToggle();
 
     void on_actionCompile_triggered();
@@ -183,6 +206,8 @@ class AppWindow : public QMainWindow
 
     void on_actionClear_Logs_triggered();
 
+    void on_actionLanguage_Server_Statistics_triggered();
+
     void onTrayIconActivated(QSystemTrayIcon::ActivationReason reason);
 
     void onCompileOrRunTriggered();
@@ -191,6 +216,15 @@ class AppWindow : public QMainWindow
     Ui::AppWindow *ui;
     MessageLogger *activeLogger = nullptr;
     QTimer *autoSaveTimer = nullptr;
+    Core::SaveService *saveService = nullptr; // formats and writes the files of auto save in the background
+
+    Core::SessionStore *sessionStore = nullptr;
+    QTimer *sessionTimer = nullptr;
+    QHash<MainWindow *, QString> sessionIDs;   // the ID of each tab in the session store
+    QSet<MainWindow *> sessionChangedWindows; // the tabs whose code is changed since the last session update
+
+    QTimer *placeholderTimer = nullptr; // turns the tabs which are unused for a long time into placeholders
+    int runningFolderWalks = 0;         // the number of openPaths() whose folders are being walked in the background
 
     QTimer *lspTimerCpp = nullptr;
     QTimer *lspTimerPython = nullptr;
@@ -200,7 +234,9 @@ class AppWindow : public QMainWindow
     QMetaObject::Connection activeRightSplitterMoveConnection;
     Telemetry::UpdateNotifier *updater = nullptr;
     PreferencesWindow *preferencesWindow = nullptr;
-    Extensions::CompanionServer *server;
+    Extensions::CompanionServer *server = nullptr;
+    QTimer *companionTimer = nullptr;                  // ends a burst of problems sent by Competitive Companion
+    QVector<Extensions::CompanionData> companionQueue; // the problems received in the current burst
     FindReplaceDialog *findReplaceDialog = nullptr;
     QSystemTrayIcon *trayIcon = nullptr;
     QMenu *trayIconMenu = nullptr;
@@ -209,23 +245,35 @@ class AppWindow : public QMainWindow
     Extensions::LanguageServer *cppServer = nullptr;
     Extensions::LanguageServer *javaServer = nullptr;
     Extensions::LanguageServer *pythonServer = nullptr;
+    Widgets::LanguageServerStats *languageServerStats = nullptr; // created when it's shown for the first time
+
+    bool isDeferredInitialized = false; // whether the subsystems which are not needed to show the window are created
 
     void setConnections();
     void allocate();
+    void initDeferred();
     void applySettings();
     void saveSettings();
     QVector<QShortcut *> hotkeyObjects;
     void maybeSetHotkeys();
     bool closeTab(int index);
-    void openTab(const QString &path);
+    int openTab(const QString &path, bool activate = true);
     void openTabs(const QStringList &paths);
     void openPaths(const QStringList &paths, bool cpp = true, bool java = true, bool python = true, int depth = -1);
-    QStringList openFolder(const QString &path, bool cpp, bool java, bool python, int depth);
+    static QStringList openFolder(const QString &path, bool cpp, bool java, bool python, int depth,
+                                  const QAtomicInt *canceled);
     void openContest(const QString &path, const QString &lang, int number);
-    void saveEditorStatus();
+    void applyCompanion(const Extensions::CompanionData &data);
+    void openCompanionContest(const QVector<Extensions::CompanionData> &problems);
+    void openCompanionTabs(const QVector<Extensions::CompanionData> &problems, const QStringList &paths);
+    static QStringList writeCompanionFiles(const QVector<QPair<QString, QString>> &files);
+    void restoreSession(bool legacy);
+    void updateSession(bool all);
     bool quit();
     int getNewUntitledIndex();
     void reAttachLanguageServer(MainWindow *window);
+    void closeLanguageServerDocuments(QCodeEditor *editor);
+    QString languageServerKey(MainWindow *window) const;
 
     MainWindow *currentWindow();
     MainWindow *windowAt(int index);
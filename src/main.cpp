@@ -16,27 +16,182 @@
  */
 
 #include "Core/EventLogger.hpp"
+#include "Core/Judge.hpp"
+#include "Core/StartupTrace.hpp"
+#include "Settings/SettingsManager.hpp"
 #include "SignalHandler.hpp"
+#include "Util/FileUtil.hpp"
 #include "appwindow.hpp"
 #include "mainwindow.hpp"
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QCoreApplication>
 #include <QDialog>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QProgressDialog>
 #include <QTextStream>
+#include <QThread>
+#include <QTimer>
 #include <generated/version.hpp>
 #include <iostream>
 #include <singleapplication.h>
 
 #define TOJSON(x) json[#x] = x
 
+// the exit status of the judge mode
+enum JudgeExitCode
+{
+    JUDGE_ACCEPTED = 0,          // all testcases are accepted
+    JUDGE_ERROR = 1,             // invalid arguments, or the source file or the testcases can't be read
+    JUDGE_COMPILATION_ERROR = 2, // the solution failed to compile
+    JUDGE_REJECTED = 3           // some testcases are not accepted
+};
+
+static int judgeMain(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("CP Editor"); // the same settings as the GUI
+    QCoreApplication::setApplicationVersion(APP_VERSION "+g" GIT_COMMIT_HASH);
+
+    QTextStream cerr(stderr, QIODevice::WriteOnly);
+    QTextStream cout(stdout, QIODevice::WriteOnly);
+
+    QString programName(argv[0]);
+
+    QCommandLineParser parser;
+    parser.addVersionOption();
+    parser.addHelpOption();
+    parser.setApplicationDescription(
+        programName +
+        " --judge <source> [--tests <dir|archive>] [--checker <name|path>] [--jobs <N>] [--json <file>]\n\n" +
+        "Compile the source file, run it on the testcases in parallel and check the outputs, without opening any "
+        "window. The compile commands, the run commands and the time limit are the same as in the editor.\n\n"
+        "Exit status: 0 if all testcases are accepted, 1 on invalid arguments, 2 on a compilation error, 3 if some "
+        "testcases are not accepted.");
+    parser.addOptions(
+        {{"judge", "Judge the solution <source>.", "source"},
+         {"tests", "Pair the input files and the answer files in <dir> by the testcases matching rules, or use the "
+                   "testcases in a testcase archive. The testcases saved with the source file are used if it's not "
+                   "specified.", "dir|archive"},
+         {"checker", "The checker, one of ignore-trailing-spaces, strict, ncmp, rcmp4, rcmp6, rcmp9, wcmp, nyesno, "
+                     "or the path to a testlib checker. (default: ignore-trailing-spaces)", "name|path",
+          "ignore-trailing-spaces"},
+         {"jobs", "Run at most <N> testcases at the same time. (default: the number of CPU threads)", "N"},
+         {"json", "Write the results in JSON to <file>, \"-\" for stdout instead of the table.", "file"},
+         {"verbose", "Dump all logs to stderr of the application. (use only for debug purpose)"}});
+    parser.setSingleDashWordOptionMode(QCommandLineParser::ParseAsLongOptions);
+    parser.process(app);
+
+    Core::Log::init(0, parser.isSet("verbose"));
+    SettingsManager::init(); // never deinit, the judge shouldn't change the settings
+
+    auto usageError = [&cerr, &programName](const QString &message) {
+        cerr << message << "\n\n"
+             << "See " + programName + " --judge --help for more infomation.\n\n";
+        return JUDGE_ERROR;
+    };
+
+    QString source = QFileInfo(parser.value("judge")).absoluteFilePath();
+    if (!QFileInfo(source).isFile())
+        return usageError("The source file " + source + " doesn't exist.");
+
+    QString lang;
+    auto suffix = QFileInfo(source).suffix();
+    if (Util::cppSuffix.contains(suffix))
+        lang = "C++";
+    else if (Util::javaSuffix.contains(suffix))
+        lang = "Java";
+    else if (Util::pythonSuffix.contains(suffix))
+        lang = "Python";
+    else
+        return usageError("Unknown language of " + source + ".");
+
+    const QStringList checkerNames = {"ignore-trailing-spaces", "strict", "ncmp", "rcmp4",
+                                      "rcmp6", "rcmp9", "wcmp", "nyesno"}; // in the order of Checker::CheckerType
+    auto checkerName = parser.value("checker");
+    auto checkerType = Core::Checker::Custom;
+    QString checkerPath;
+    if (checkerNames.contains(checkerName.toLower()))
+        checkerType = Core::Checker::CheckerType(checkerNames.indexOf(checkerName.toLower()));
+    else if (QFileInfo(checkerName).isFile())
+        checkerPath = QFileInfo(checkerName).absoluteFilePath();
+    else
+        return usageError("Invalid checker: " + checkerName);
+
+    int jobs = QThread::idealThreadCount();
+    if (parser.isSet("jobs"))
+    {
+        bool ok = false;
+        jobs = parser.value("jobs").toInt(&ok);
+        if (!ok || jobs <= 0)
+            return usageError("The number of jobs should be a positive integer.");
+    }
+
+    QString testsDir;
+    if (parser.isSet("tests"))
+    {
+        testsDir = QFileInfo(parser.value("tests")).absoluteFilePath();
+        if (!QFileInfo::exists(testsDir))
+            return usageError("The testcase directory or archive " + testsDir + " doesn't exist.");
+    }
+
+    auto tests = Core::Judge::findTestCases(source, testsDir);
+    if (tests.isEmpty())
+    {
+        cerr << "No testcases are found.\n";
+        return JUDGE_ERROR;
+    }
+
+    LOG_INFO(INFO_OF(source) << INFO_OF(lang) << INFO_OF(checkerName) << INFO_OF(jobs) << INFO_OF(tests.size()));
+
+    Core::Judge judge(source, lang, checkerType, checkerPath, jobs);
+    // queued, because finished() may be emitted before the event loop starts
+    QObject::connect(&judge, &Core::Judge::finished, &app, &QCoreApplication::quit, Qt::QueuedConnection);
+    QTimer::singleShot(0, &judge, [&judge, &tests] { judge.start(tests); });
+    app.exec();
+
+    auto json = parser.value("json");
+    if (json == "-")
+    {
+        cout << QJsonDocument(judge.toJson()).toJson();
+    }
+    else
+    {
+        cout << judge.toTable();
+        if (!json.isEmpty() &&
+            !Util::saveFile(QFileInfo(json).absoluteFilePath(), QJsonDocument(judge.toJson()).toJson(), "Judge", false))
+            cerr << "Failed to write the results to " << json << "\n";
+    }
+
+    switch (judge.verdict())
+    {
+    case Core::Judge::AC:
+        return JUDGE_ACCEPTED;
+    case Core::Judge::CE:
+        return JUDGE_COMPILATION_ERROR;
+    default:
+        return JUDGE_REJECTED;
+    }
+}
+
 int main(int argc, char *argv[])
 {
+    // the judge mode doesn't create any widget, so it's decided before the GUI application is created
+    // QCommandLineParser also accepts the value after "=", and the arguments after "--" are positional arguments
+    for (int i = 1; i < argc && qstrcmp(argv[i], "--") != 0; ++i)
+    {
+        if (qstrcmp(argv[i], "--judge") == 0 || qstrcmp(argv[i], "-judge") == 0 ||
+            qstrncmp(argv[i], "--judge=", 8) == 0 || qstrncmp(argv[i], "-judge=", 7) == 0)
+            return judgeMain(argc, argv);
+    }
+
+    Core::StartupTrace::start();
+
     SingleApplication app(argc, argv, true);
     SingleApplication::setApplicationName("CP Editor");
     SingleApplication::setApplicationVersion(APP_VERSION "+g" GIT_COMMIT_HASH);
@@ -121,7 +276,14 @@ int main(int argc, char *argv[])
          {"java", "Open Java files in given directories. / Use Java for open contests."},
          {"python", "Open Python files in given directories. / Use Python for open contests."},
          {"verbose", "Dump all logs to stderr of the application. (use only for debug purpose)"},
-         {"no-hot-exit", "Do not load hot exit in this session. You won't be able to load the last session again."}});
+         {"log-level", "Only write the logs of at least <level>, one of info, warn, error and wtf. (default: info)",
+          "level", "info"},
+         {"binary-log", "Write the event log in a compact binary format, which can be read by --decode-log."},
+         {"decode-log", "Print the binary event log <file> as text and exit.", "file"},
+         {"startup-trace", "Write the time of each phase of the startup to <file> in JSON.", "file"},
+         {"no-hot-exit", "Do not load hot exit in this session. You won't be able to load the last session again."},
+         {"judge", "Judge <source> on its testcases without opening any window. See --judge --help for the options.",
+          "source"}});
     parser.setOptionsAfterPositionalArgumentsMode(QCommandLineParser::ParseAsOptions);
     parser.setSingleDashWordOptionMode(QCommandLineParser::ParseAsLongOptions);
     parser.process(app);
@@ -135,10 +297,36 @@ int main(int argc, char *argv[])
     bool noHotExit = parser.isSet("no-hot-exit");
     bool shouldDumpTostderr = parser.isSet("verbose");
 
+    if (parser.isSet("decode-log"))
+    {
+        QFile logFile(parser.value("decode-log"));
+        QTextStream cout(stdout, QIODevice::WriteOnly);
+        if (!logFile.open(QIODevice::ReadOnly) || !Core::Log::decode(&logFile, cout))
+        {
+            cerr << "Failed to decode " << logFile.fileName() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    const QStringList logLevels = {"info", "warn", "error", "wtf"};
+    int logLevel = logLevels.indexOf(parser.value("log-level").toLower());
+    if (logLevel == -1)
+    {
+        cerr << "Invalid log level: " << parser.value("log-level") << "\n\n"
+             << "See " + programName + " --help for more infomation.\n\n";
+        return 1;
+    }
+    Core::Log::setLevel(Core::Log::Level(Core::Log::INFO + logLevel));
+
     auto instance = app.instanceId();
-    Core::Log::init(instance, shouldDumpTostderr);
+    Core::Log::init(instance, shouldDumpTostderr, parser.isSet("binary-log"));
     LOG_INFO(INFO_OF(instance));
 
+    if (parser.isSet("startup-trace"))
+        Core::StartupTrace::setOutputPath(QDir::current().absoluteFilePath(parser.value("startup-trace")));
+    Core::StartupTrace::mark("Parse command line");
+
     auto args = parser.positionalArguments();
 
     if (contest)
@@ -205,6 +393,7 @@ int main(int argc, char *argv[])
         QObject::connect(&app, &SingleApplication::receivedMessage, &w, &AppWindow::onReceivedMessage);
         LOG_INFO("Showing the application window and beginning the event loop");
         w.show();
+        Core::StartupTrace::mark("Show window");
         return app.exec();
     }
     else
@@ -258,6 +447,7 @@ int main(int argc, char *argv[])
         LOG_INFO("Showing the application window and beginning the event loop");
 
         w.show();
+        Core::StartupTrace::mark("Show window");
         return app.exec();
     }
 }
@@ -21,7 +21,10 @@
 #include "Core/Compiler.hpp"
 #include "Core/EventLogger.hpp"
 #include "Core/MessageLogger.hpp"
+#include "Core/Minimizer.hpp"
 #include "Core/Runner.hpp"
+#include "Core/SaveService.hpp"
+#include "Core/SessionStore.hpp"
 #include "Extensions/CFTool.hpp"
 #include "Extensions/ClangFormatter.hpp"
 #include "Extensions/CompanionServer.hpp"
@@ -29,6 +32,7 @@
 #include "Telemetry/UpdateNotifier.hpp"
 #include "Util/FileUtil.hpp"
 #include "Util/QCodeEditorUtil.hpp"
+#include "Util/Util.hpp"
 #include "Widgets/TestCases.hpp"
 #include <QCodeEditor>
 #include <QFileDialog>
@@ -52,21 +56,19 @@
 
 // ***************************** RAII  ****************************
 
-MainWindow::MainWindow(const QString &fileOpen, int index, QWidget *parent)
+MainWindow::MainWindow(const QString &fileOpen, int index, QWidget *parent, bool placeholder)
     : QMainWindow(parent), ui(new Ui::MainWindow), untitledIndex(index), fileWatcher(new QFileSystemWatcher(this))
 {
-    LOG_INFO(INFO_OF(fileOpen) << INFO_OF(index));
+    LOG_INFO(INFO_OF(fileOpen) << INFO_OF(index) << BOOL_INFO_OF(placeholder));
 
-    ui->setupUi(this);
-    setupCore();
-    setTestCases();
-    setEditor();
     connect(fileWatcher, SIGNAL(fileChanged(const QString &)), this, SLOT(onFileWatcherChanged(const QString &)));
-    applySettings("", true);
-    loadFile(fileOpen);
-    if (testcases->count() == 0)
-        testcases->addTestCase();
-    QTimer::singleShot(0, [this] { setLanguage(language); }); // See issue #187 for more information
+    filePath = QFile::exists(fileOpen) ? QFileInfo(fileOpen).canonicalFilePath() : fileOpen;
+    if (!isUntitled() && SettingsHelper::isRestoreOldProblemUrl() && FileProblemBinder::containsFile(filePath))
+        problemURL = FileProblemBinder::getProblemForFile(filePath);
+    lastUsed.start();
+
+    if (!placeholder)
+        materialize();
 }
 
 MainWindow::~MainWindow()
@@ -86,6 +88,100 @@ MainWindow::~MainWindow()
     delete log;
 }
 
+void MainWindow::materialize()
+{
+    lastUsed.restart();
+    if (materialized)
+        return;
+
+    // read the journal while it's still a placeholder, so that the status is pending like a restored one
+    loadPendingSession();
+
+    LOG_INFO(INFO_OF(filePath) << BOOL_INFO_OF(hasPendingStatus));
+    materialized = true;
+
+    ui->setupUi(this);
+    setupCore();
+    setTestCases();
+    setEditor();
+    formatter->trackChanges(editor);
+    applySettings("", true);
+
+    if (hasPendingStatus)
+    {
+        hasPendingStatus = false;
+        loadStatus(pendingStatus);
+        pendingStatus = EditorStatus();
+    }
+    else
+    {
+        // loaded like a new tab, so that the text is not inserted into the empty document as an edit
+        QString path;
+        path.swap(filePath);
+        loadFile(path);
+    }
+
+    if (testcases->count() == 0)
+        testcases->addTestCase();
+    if (submitToCodeforces == nullptr && problemURL.contains("codeforces.com"))
+        setCFToolUI();
+    updateWatcher();
+    QTimer::singleShot(0, this, [this] { setLanguage(language); }); // See issue #187 for more information
+}
+
+bool MainWindow::dematerialize()
+{
+    // a detached program or a minimization may run for a long time, and it's not killed
+    if (!materialized || isTextChanged() || detachedRunner != nullptr || minimizer != nullptr)
+        return false;
+
+    LOG_INFO(INFO_OF(filePath));
+
+    // the text is unchanged, so it's loaded from the file or the template again, which may be changed meanwhile
+    pendingStatus = toStatus();
+    pendingStatus.editorText = QString();
+    hasPendingStatus = true;
+    pendingTextChanged = false;
+
+    killProcesses();
+    if (!fileWatcher->files().isEmpty())
+        fileWatcher->removePaths(fileWatcher->files());
+
+    // the editor, the testcases and the submit button are in the central widget
+    delete takeCentralWidget();
+    delete ui;
+    ui = new Ui::MainWindow;
+    editor = nullptr;
+    testcases = nullptr;
+    submitToCodeforces = nullptr;
+
+    delete cftool;
+    cftool = nullptr;
+    delete checker;
+    checker = nullptr;
+    delete formatter;
+    formatter = nullptr;
+    delete log;
+    log = nullptr;
+    delete tmpDir;
+    tmpDir = nullptr;
+
+    cleanTextHash.clear();
+    cleanTextLength = -1;
+    materialized = false;
+    return true;
+}
+
+bool MainWindow::isMaterialized() const
+{
+    return materialized;
+}
+
+qint64 MainWindow::idleTime() const
+{
+    return lastUsed.elapsed();
+}
+
 // ************************* RAII HELPER *****************************
 
 void MainWindow::setTestCases()
@@ -94,6 +190,7 @@ void MainWindow::setTestCases()
     ui->test_cases_layout->addWidget(testcases);
     connect(testcases, SIGNAL(checkerChanged()), this, SLOT(updateChecker()));
     connect(testcases, SIGNAL(requestRun(int)), this, SLOT(runTestCase(int)));
+    connect(testcases, SIGNAL(requestMinimize(int)), this, SLOT(minimizeTestCase(int)));
 }
 
 void MainWindow::setEditor()
@@ -105,6 +202,8 @@ void MainWindow::setEditor()
     ui->verticalLayout_8->addWidget(editor);
 
     connect(editor, SIGNAL(textChanged()), this, SLOT(onTextChanged()));
+    // the modification state can be changed without changing the text, e.g. when saving
+    connect(editor->document(), SIGNAL(modificationChanged(bool)), this, SLOT(onTextChanged()));
 
     // cursorPositionChanged() does not imply selectionChanged() if you press Left with
     // a selection (and the cursor is at the begin of the selection)
@@ -212,6 +311,106 @@ void MainWindow::runTestCase(int index)
     run(index);
 }
 
+void MainWindow::minimizeTestCase(int index)
+{
+    LOG_INFO(INFO_OF(index));
+
+    if (!QStringList({"C++", "Java", "Python"}).contains(language))
+    {
+        log->warn("Minimizer", "Wrong language, please set the language");
+        return;
+    }
+
+    auto input = testcases->input(index);
+    if (input.trimmed().isEmpty())
+    {
+        log->warn("Minimizer", "The input is empty, nothing to minimize");
+        return;
+    }
+
+    QMessageBox question(QMessageBox::Question, "Minimize Failing Testcase",
+                         "A smaller input is considered failing if the program crashes or reaches the time limit on "
+                         "it, or, if a reference solution is chosen, the checker rejects the output of the program "
+                         "against the output of the reference solution.\nPlease compile the program before "
+                         "minimizing.",
+                         QMessageBox::Cancel, this);
+    auto referenceButton = question.addButton("Choose Reference Solution", QMessageBox::AcceptRole);
+    auto crashButton = question.addButton("Crash or Timeout Only", QMessageBox::AcceptRole);
+    question.exec();
+
+    QString referencePath, referenceLang;
+    if (question.clickedButton() == referenceButton)
+    {
+        referencePath = QFileDialog::getOpenFileName(this, "Choose Reference Solution", QFileInfo(filePath).path(),
+                                                     Util::fileNameFilter(true, true, true));
+        if (referencePath.isEmpty())
+            return;
+        auto suffix = QFileInfo(referencePath).suffix();
+        if (Util::cppSuffix.contains(suffix))
+            referenceLang = "C++";
+        else if (Util::javaSuffix.contains(suffix))
+            referenceLang = "Java";
+        else if (Util::pythonSuffix.contains(suffix))
+            referenceLang = "Python";
+        else
+        {
+            log->warn("Minimizer", "Unknown language of the reference solution " + referencePath);
+            return;
+        }
+    }
+    else if (question.clickedButton() != crashButton)
+    {
+        return;
+    }
+
+    killProcesses();
+
+    auto path = tmpPath();
+    if (path.isEmpty())
+        return;
+
+    minimizer = new Core::Minimizer(
+        {path, filePath, language, SettingsManager::get(QString("%1/Run Command").arg(language)).toString(),
+         SettingsManager::get(QString("%1/Run Arguments").arg(language)).toString()},
+        testcases->checkerType(), testcases->checkerText(),
+        SettingsManager::get(QString("C++/Compile Command")).toString(), SettingsHelper::getTimeLimit(), this);
+
+    if (!referencePath.isEmpty())
+    {
+        minimizer->setReference(referencePath, referenceLang,
+                                SettingsManager::get(QString("%1/Compile Command").arg(referenceLang)).toString(),
+                                SettingsManager::get(QString("%1/Run Command").arg(referenceLang)).toString(),
+                                SettingsManager::get(QString("%1/Run Arguments").arg(referenceLang)).toString());
+    }
+
+    connect(minimizer, &Core::Minimizer::minimizationProgress, this,
+            [this](const QString &message) { log->info("Minimizer", message); });
+    // the Minimizer is not needed after it's finished, so that the tab can be turned into a placeholder again
+    auto current = minimizer;
+    auto release = [this, current] {
+        if (minimizer == current)
+        {
+            minimizer = nullptr;
+            current->deleteLater();
+        }
+    };
+    connect(minimizer, &Core::Minimizer::minimizationFinished, this,
+            [this, release](const QString &minimized, const QString &expected) {
+                testcases->addTestCase(minimized, expected);
+                log->info("Minimizer", QString("The input is minimized to %1 characters and added as a new testcase")
+                                           .arg(minimized.length()));
+                release();
+            });
+    connect(minimizer, &Core::Minimizer::minimizationFailed, this, [this, release](const QString &error) {
+        log->error("Minimizer", error);
+        release();
+    });
+
+    log->info("Minimizer",
+              QString("Minimizing testcase #%1, it's stopped when compiling or running").arg(index + 1));
+    minimizer->start(input);
+}
+
 void MainWindow::loadTests()
 {
     if (!isUntitled() && SettingsHelper::isSaveTests())
@@ -312,8 +511,9 @@ QString MainWindow::getTabTitle(bool complete, bool star, int removeLength)
     return tabTitle;
 }
 
-QCodeEditor *MainWindow::getEditor() const
+QCodeEditor *MainWindow::getEditor()
 {
+    materialize();
     return editor;
 }
 
@@ -322,9 +522,12 @@ bool MainWindow::isUntitled() const
     return filePath.isEmpty();
 }
 
-void MainWindow::setFilePath(const QString &path)
+void MainWindow::setFilePath(const QString &newPath)
 {
-    LOG_INFO(INFO_OF(path));
+    LOG_INFO(INFO_OF(newPath));
+    auto path = newPath;
+    if (QFile::exists(path))
+        path = QFileInfo(path).canonicalFilePath();
     if (filePath == path)
         return;
     filePath = path;
@@ -340,7 +543,7 @@ void MainWindow::setProblemURL(const QString &url)
         return;
     problemURL = url;
     FileProblemBinder::set(filePath, url);
-    if (problemURL.contains("codeforces.com"))
+    if (materialized && problemURL.contains("codeforces.com"))
         setCFToolUI();
     emit editorFileChanged();
 }
@@ -400,6 +603,23 @@ QMap<QString, QVariant> MainWindow::EditorStatus::toMap() const
 
 MainWindow::EditorStatus MainWindow::toStatus() const
 {
+    if (!materialized)
+    {
+        if (hasPendingStatus)
+            return pendingStatus;
+        // the null text means that the file is opened when the status is loaded
+        EditorStatus status;
+        status.isLanguageSet = isLanguageSet;
+        status.filePath = filePath;
+        status.problemURL = problemURL;
+        status.language = language;
+        status.untitledIndex = untitledIndex;
+        status.checkerIndex = 0;
+        status.editorCursor = status.editorAnchor = 0;
+        status.horizontalScrollBarValue = status.verticalScrollbarValue = 0;
+        return status;
+    }
+
     EditorStatus status;
 
     status.isLanguageSet = isLanguageSet;
@@ -425,41 +645,156 @@ MainWindow::EditorStatus MainWindow::toStatus() const
 void MainWindow::loadStatus(const EditorStatus &status)
 {
     LOG_INFO("Requesting loadStatus");
+    if (!materialized)
+    {
+        pendingStatus = status;
+        hasPendingStatus = true;
+        problemURL = status.problemURL;
+        if (status.isLanguageSet)
+            setLanguage(status.language);
+        untitledIndex = status.untitledIndex;
+        filePath = status.filePath;
+        if (status.editorText.isNull())
+        {
+            pendingTextChanged = false;
+        }
+        else
+        {
+            // compared like reloadCleanText() does, so that the tab title is right before it's materialized
+            auto cleanText =
+                isUntitled()
+                    ? Util::readFile(SettingsManager::get(QString("%1/Template Path").arg(language)).toString())
+                    : Util::readFile(filePath);
+            if (isUntitled() && cleanText.isNull())
+                cleanText = "";
+            pendingTextChanged = cleanText.isNull() || cleanText != status.editorText;
+        }
+        emit editorFileChanged();
+        return;
+    }
+
     setProblemURL(status.problemURL);
     if (status.isLanguageSet)
         setLanguage(status.language);
     untitledIndex = status.untitledIndex;
     testcases->addCustomCheckers(status.customCheckers);
     testcases->setCheckerIndex(status.checkerIndex);
-    setFilePath(status.filePath);
-    savedText = status.savedText;
-    editor->setPlainText(status.editorText);
+    if (status.editorText.isNull())
+    {
+        // the status of a tab which is not changed since it was opened
+        filePath.clear();
+        loadFile(status.filePath);
+    }
+    else
+    {
+        setFilePath(status.filePath);
+        savedText = status.savedText;
+        editor->setPlainText(status.editorText);
+        formatter->markFormatted();
+        reloadCleanText();
+    }
     auto cursor = editor->textCursor();
-    cursor.setPosition(status.editorAnchor);
-    cursor.setPosition(status.editorCursor, QTextCursor::KeepAnchor);
+    int length = editor->document()->characterCount() - 1;
+    cursor.setPosition(qMin(status.editorAnchor, length));
+    cursor.setPosition(qMin(status.editorCursor, length), QTextCursor::KeepAnchor);
     editor->setTextCursor(cursor);
     editor->horizontalScrollBar()->setValue(status.horizontalScrollBarValue);
     editor->verticalScrollBar()->setValue(status.verticalScrollbarValue);
-    testcases->loadStatus(status.input, status.expected);
+    if (!status.editorText.isNull() || !status.input.isEmpty())
+        testcases->loadStatus(status.input, status.expected);
     for (int i = 0; i < status.testcasesIsShow.count() && i < testcases->count(); ++i)
         testcases->setShow(i, status.testcasesIsShow[i].toBool());
 }
 
-void MainWindow::applyCompanion(const Extensions::CompanionData &data)
+QVariantMap MainWindow::sessionSummary()
 {
-    LOG_INFO("Requesting apply from companion");
-    if (isUntitled() && !isTextChanged())
+    // a few small values, e.g. the file path for the tab title, so that a tab can be shown before its journal is read
+    QVariantMap summary;
+    summary["filePath"] = filePath;
+    summary["problemURL"] = problemURL;
+    summary["language"] = language;
+    summary["isLanguageSet"] = isLanguageSet;
+    summary["untitledIndex"] = untitledIndex;
+    summary["isTextChanged"] = isTextChanged();
+    return summary;
+}
+
+void MainWindow::loadSession(Core::SessionStore *store, const QString &id, const QVariantMap &summary)
+{
+    LOG_INFO(INFO_OF(id) << BOOL_INFO_OF(materialized));
+    if (materialized)
     {
-        QString meta = data.toMetaString();
-        meta.prepend("\n");
-        meta.append("Powered by CP Editor (https://github.com/cpeditor/cpeditor)");
+        auto status = store->load(id);
+        if (!status.isEmpty())
+            loadStatus(EditorStatus(status));
+        return;
+    }
 
-        if (language == "Python")
-            meta.replace('\n', "\n# ");
-        else
-            meta.replace('\n', "\n// ");
+    pendingSessionStore = store;
+    pendingSessionID = id;
+    problemURL = summary["problemURL"].toString();
+    if (summary["isLanguageSet"].toBool())
+        setLanguage(summary["language"].toString());
+    untitledIndex = summary["untitledIndex"].toInt();
+    filePath = summary["filePath"].toString();
+    pendingTextChanged = summary["isTextChanged"].toBool();
+    emit editorFileChanged();
+}
 
-        editor->setPlainText(meta + "\n\n" + editor->toPlainText());
+bool MainWindow::isSessionLoaded() const
+{
+    return pendingSessionStore == nullptr;
+}
+
+void MainWindow::loadPendingSession()
+{
+    if (pendingSessionStore == nullptr)
+        return;
+    auto store = pendingSessionStore;
+    pendingSessionStore = nullptr;
+
+    LOG_INFO(INFO_OF(pendingSessionID));
+    // the tab keeps the summary if the journal is missing or invalid
+    auto status = store->load(pendingSessionID);
+    if (!status.isEmpty())
+        loadStatus(EditorStatus(status));
+}
+
+void MainWindow::applyCompanion(const Extensions::CompanionData &data, int checkerIndex)
+{
+    LOG_INFO("Requesting apply from companion" << INFO_OF(checkerIndex));
+
+    if (!materialized)
+    {
+        // the problem is kept in the pending status, so the tabs of a whole contest can be opened at once
+        loadPendingSession();
+        auto status = toStatus();
+        if (isUntitled() && status.editorText.isNull())
+        {
+            auto templateCode =
+                Util::readFile(SettingsManager::get(QString("%1/Template Path").arg(status.language)).toString());
+            status.editorText = companionMeta(data, status.language) + "\n\n" + templateCode;
+        }
+        status.input.clear();
+        status.expected.clear();
+        status.testcasesIsShow.clear();
+        for (const auto &testcase : data.testcases)
+        {
+            status.input.push_back(testcase.input);
+            status.expected.push_back(testcase.output);
+        }
+        if (checkerIndex != -1)
+            status.checkerIndex = checkerIndex;
+        setProblemURL(data.url);
+        status.problemURL = data.url;
+        loadStatus(status);
+        return;
+    }
+
+    if (isUntitled() && !isTextChanged())
+    {
+        editor->setPlainText(companionMeta(data, language) + "\n\n" + editor->toPlainText());
+        updateModified();
     }
 
     testcases->clear();
@@ -467,13 +802,50 @@ void MainWindow::applyCompanion(const Extensions::CompanionData &data)
     for (int i = 0; i < data.testcases.size(); ++i)
         testcases->addTestCase(data.testcases[i].input, data.testcases[i].output);
 
+    if (checkerIndex != -1)
+        testcases->setCheckerIndex(checkerIndex);
+
     setProblemURL(data.url);
 }
 
+QString MainWindow::companionMeta(const Extensions::CompanionData &data, const QString &lang)
+{
+    QString meta = data.toMetaString();
+    meta.prepend("\n");
+    meta.append("Powered by CP Editor (https://github.com/cpeditor/cpeditor)");
+
+    if (lang == "Python")
+        meta.replace('\n', "\n# ");
+    else
+        meta.replace('\n', "\n// ");
+
+    return meta;
+}
+
+QString MainWindow::defaultFilePathForProblemURL(const QString &url)
+{
+    if (url.isEmpty())
+        return QString();
+    auto rules = SettingsHelper::getDefaultFilePathsForProblemURLs();
+    for (auto rule : rules)
+    {
+        if (rule.toStringList().front().isEmpty())
+            continue;
+        auto regex = QRegularExpression(rule.toStringList().front());
+        auto match = regex.match(url);
+        if (match.hasMatch())
+            return match.captured().replace(regex, rule.toStringList().back());
+    }
+    return QString();
+}
+
 void MainWindow::applySettings(const QString &pagePath, bool shouldPerformDigonistic)
 {
     LOG_INFO(INFO_OF(pagePath) << BOOL_INFO_OF(shouldPerformDigonistic));
 
+    if (!materialized)
+        return; // all settings are applied when it's materialized
+
     if (pagePath.isEmpty() || pagePath == "Extensions/Clang Format")
     {
         formatter->updateBinary(SettingsHelper::getClangFormatPath());
@@ -528,12 +900,82 @@ void MainWindow::applySettings(const QString &pagePath, bool shouldPerformDigoni
 void MainWindow::save(bool force, const QString &head, bool safe)
 {
     LOG_INFO("Save " << BOOL_INFO_OF(force) << INFO_OF(head) << BOOL_INFO_OF(safe));
+    if (!materialized)
+    {
+        // the file of a placeholder tab is saved, unless it's untitled or its restored text is changed
+        if (!isUntitled() && !pendingTextChanged)
+            return;
+        materialize();
+    }
     saveFile(force ? AlwaysSave : IgnoreUntitled, head, safe);
 }
 
+void MainWindow::autoSave(Core::SaveService *service)
+{
+    if (!materialized)
+    {
+        // like save(), the file of a placeholder tab is saved only if its restored text is changed
+        if (isUntitled() || !pendingTextChanged)
+            return;
+        materialize();
+    }
+    if (isUntitled() || !QFile::exists(filePath))
+        return;
+
+    saveService = service;
+    if (isTextChanged())
+    {
+        Core::SaveRequest request;
+        request.filePath = filePath;
+        request.text = editor->toPlainText();
+        request.safe = false;
+        request.format = SettingsHelper::isAutoFormat();
+        request.formatBinary = SettingsHelper::getClangFormatPath();
+        request.formatStyle = SettingsHelper::getClangFormatStyle();
+        if (request.format && SettingsHelper::isAutoFormatChangedLinesOnly())
+        {
+            request.formatLines = formatter->changedLines();
+            request.format = !request.formatLines.isEmpty() && !formatter->isFormatted();
+        }
+        // the file is written by ourselves, it's watched again in onAutoSaved()
+        if (service->save(request))
+            fileWatcher->removePath(filePath);
+    }
+    saveTests(false);
+}
+
+void MainWindow::onAutoSaved(const Core::SaveResult &result)
+{
+    LOG_INFO(INFO_OF(result.filePath) << BOOL_INFO_OF(result.ok));
+    updateWatcher();
+    if (!materialized || result.filePath != filePath)
+        return;
+
+    if (!result.formatError.isEmpty())
+        log->warn("Formatter", result.formatError);
+    if (!result.ok)
+    {
+        log->error("Auto Save", result.error);
+        return;
+    }
+
+    // the formatted text is applied only if the text is not edited while saving
+    bool isEdited = editor->toPlainText() != result.text;
+    if (result.formatted && !isEdited)
+    {
+        // only the replaced parts are changed, so the cursor, the selection and the undo history are kept
+        Extensions::ClangFormatter::applyReplacements(editor, result.replacements);
+        formatter->markFormatted();
+    }
+
+    savedText = result.savedText;
+    setCleanText(result.savedText);
+}
+
 void MainWindow::saveAs()
 {
     LOG_INFO("Save as clicked");
+    materialize();
     saveFile(SaveAs, "Save as", true);
 }
 
@@ -558,6 +1000,7 @@ void MainWindow::on_run_clicked()
 void MainWindow::compileOnly()
 {
     LOG_INFO("Requesting Compile Only");
+    materialize();
     emit compileOrRunTriggered();
     afterCompile = Nothing;
     log->clear();
@@ -567,6 +1010,7 @@ void MainWindow::compileOnly()
 void MainWindow::runOnly()
 {
     LOG_INFO("Requesting Run only");
+    materialize();
     emit compileOrRunTriggered();
     log->clear();
     run();
@@ -575,6 +1019,7 @@ void MainWindow::runOnly()
 void MainWindow::compileAndRun()
 {
     LOG_INFO("Requested Compile and Run");
+    materialize();
     emit compileOrRunTriggered();
     afterCompile = Run;
     log->clear();
@@ -584,12 +1029,20 @@ void MainWindow::compileAndRun()
 void MainWindow::formatSource()
 {
     LOG_INFO("Requested code format");
+    materialize();
     formatter->format(editor, filePath, language, true);
 }
 
 void MainWindow::setLanguage(const QString &lang)
 {
     LOG_INFO(INFO_OF(lang));
+    if (!materialized)
+    {
+        language = lang == "Python" || lang == "Java" ? lang : "C++";
+        isLanguageSet = true;
+        emit editorLanguageChanged(this);
+        return;
+    }
     if (!QFile::exists(filePath))
     {
         QString templateContent;
@@ -606,6 +1059,8 @@ void MainWindow::setLanguage(const QString &lang)
     if (language != "Python" && language != "Java")
         language = "C++";
     Util::setEditorLanguage(editor, language);
+    if (isUntitled())
+        reloadCleanText(); // an untitled tab is unchanged if it's the template of its language
     ui->changeLanguageButton->setText(language);
     performCompileAndRunDiagonistics();
     isLanguageSet = true;
@@ -619,16 +1074,19 @@ QString MainWindow::getLanguage()
 
 MessageLogger *MainWindow::getLogger()
 {
+    materialize();
     return log;
 }
 
 void MainWindow::insertText(const QString &text)
 {
+    materialize();
     editor->insertPlainText(text);
 }
 
 void MainWindow::setViewMode(const QString &mode)
 {
+    materialize();
     if (mode == "code")
     {
         ui->left_widget->show();
@@ -650,6 +1108,7 @@ void MainWindow::setViewMode(const QString &mode)
 void MainWindow::detachedExecution()
 {
     LOG_INFO("Executing in detached mode");
+    materialize();
     afterCompile = RunDetached;
     log->clear();
     compile();
@@ -679,6 +1138,12 @@ void MainWindow::killProcesses()
         delete detachedRunner;
         detachedRunner = nullptr;
     }
+
+    if (minimizer != nullptr)
+    {
+        delete minimizer;
+        minimizer = nullptr;
+    }
 }
 
 //***************** HELPER FUNCTIONS *****************
@@ -696,6 +1161,8 @@ void MainWindow::setText(const QString &text, bool keep)
     }
     else
         editor->setPlainText(text);
+    // only the lines edited after loading are formatted in the changed lines mode
+    formatter->markFormatted();
 }
 
 void MainWindow::updateWatcher()
@@ -706,6 +1173,48 @@ void MainWindow::updateWatcher()
         fileWatcher->addPath(filePath);
 }
 
+void MainWindow::setCleanText(const QString &text)
+{
+    if (text.isNull())
+    {
+        cleanTextLength = -1;
+        cleanTextHash.clear();
+    }
+    else
+    {
+        cleanTextLength = text.length();
+        cleanTextHash = Util::textHash(text);
+    }
+    updateModified();
+}
+
+void MainWindow::reloadCleanText()
+{
+    if (isUntitled())
+    {
+        auto content = Util::readFile(SettingsManager::get(QString("%1/Template Path").arg(language)).toString(),
+                                      QString("Read %1 Template").arg(language), log, false);
+        setCleanText(content.isNull() ? QString("") : content);
+    }
+    else
+    {
+        setCleanText(Util::readFile(filePath));
+    }
+}
+
+void MainWindow::updateModified()
+{
+    editor->document()->setModified(!matchesCleanText());
+}
+
+bool MainWindow::matchesCleanText() const
+{
+    // characterCount() includes the last paragraph separator
+    if (cleanTextLength == -1 || editor->document()->characterCount() - 1 != cleanTextLength)
+        return false;
+    return Util::textHash(editor->toPlainText()) == cleanTextHash;
+}
+
 void MainWindow::loadFile(const QString &loadPath)
 {
     LOG_INFO(INFO_OF(loadPath));
@@ -713,6 +1222,7 @@ void MainWindow::loadFile(const QString &loadPath)
     auto path = loadPath;
 
     bool samePath = !isUntitled() && filePath == path;
+    bool fromTemplate = false;
     setFilePath(path);
 
     if (!QFile::exists(path))
@@ -724,10 +1234,12 @@ void MainWindow::loadFile(const QString &loadPath)
         if (!templatePath.isEmpty() && f.open(QIODevice::ReadOnly | QIODevice::Text))
         {
             path = templatePath;
+            fromTemplate = true;
         }
         else
         {
             setText("");
+            setCleanText(isUntitled() ? QString("") : QString());
             return;
         }
     }
@@ -735,7 +1247,10 @@ void MainWindow::loadFile(const QString &loadPath)
     auto content = Util::readFile(path, "Open File", log);
 
     if (content.isNull())
+    {
+        setCleanText(QString());
         return;
+    }
 
     savedText = content;
     if (content.length() > SettingsHelper::getOpenFileLengthLimit())
@@ -747,6 +1262,7 @@ void MainWindow::loadFile(const QString &loadPath)
                        .arg(SettingsHelper::getOpenFileLengthLimit()));
         setText("");
         setFilePath("");
+        reloadCleanText();
         return;
     }
 
@@ -754,6 +1270,8 @@ void MainWindow::loadFile(const QString &loadPath)
         setProblemURL(FileProblemBinder::getProblemForFile(filePath));
 
     setText(content, samePath);
+    // a file which doesn't exist is changed even if it's loaded from the template
+    setCleanText(isUntitled() || !fromTemplate ? content : QString());
 
     loadTests();
 }
@@ -761,8 +1279,14 @@ void MainWindow::loadFile(const QString &loadPath)
 bool MainWindow::saveFile(SaveMode mode, const QString &head, bool safe)
 {
     LOG_INFO(INFO_OF(mode) << INFO_OF(head) << BOOL_INFO_OF(safe));
+    if (saveService != nullptr && !isUntitled())
+    {
+        // an older text being auto saved shouldn't overwrite this save
+        saveService->cancel(filePath);
+        updateWatcher();
+    }
     if (SettingsHelper::isAutoFormat())
-        formatter->format(editor, filePath, language, false);
+        formatter->format(editor, filePath, language, false, true, SettingsHelper::isAutoFormatChangedLinesOnly());
 
     if (mode == SaveAs || (isUntitled() && mode == AlwaysSave))
     {
@@ -774,22 +1298,7 @@ bool MainWindow::saveFile(SaveMode mode, const QString &head, bool safe)
         }
         else
         {
-            if (!problemURL.isEmpty())
-            {
-                auto rules = SettingsHelper::getDefaultFilePathsForProblemURLs();
-                for (auto rule : rules)
-                {
-                    if (rule.toStringList().front().isEmpty())
-                        continue;
-                    auto url = QRegularExpression(rule.toStringList().front());
-                    auto match = url.match(problemURL);
-                    if (match.hasMatch())
-                    {
-                        defaultPath = match.captured().replace(url, rule.toStringList().back());
-                        break;
-                    }
-                }
-            }
+            defaultPath = defaultFilePathForProblemURL(problemURL);
             if (defaultPath.isEmpty())
                 defaultPath = QDir(SettingsHelper::getSavePath()).filePath(getTabTitle(false, false));
             if (language == "C++")
@@ -855,6 +1364,7 @@ bool MainWindow::saveFile(SaveMode mode, const QString &head, bool safe)
         return false;
     }
 
+    setCleanText(editor->toPlainText());
     saveTests(safe);
 
     return true;
@@ -862,7 +1372,7 @@ bool MainWindow::saveFile(SaveMode mode, const QString &head, bool safe)
 
 QString MainWindow::tmpPath()
 {
-    bool created = false;
+    materialize();
     if (tmpDir == nullptr || !tmpDir->isValid() || !QDir(tmpDir->path()).exists())
     {
         if (tmpDir)
@@ -874,7 +1384,6 @@ QString MainWindow::tmpPath()
             log->error("Temp File", "Failed to create the temporary directory");
             return QString();
         }
-        created = true;
     }
     QString name = "sol.";
     if (language == "C++")
@@ -891,34 +1400,16 @@ QString MainWindow::tmpPath()
     QString path = tmpDir->filePath(name);
     if (!Util::saveFile(path, editor->toPlainText(), "Temp File", false, log))
         return QString();
-    if (created)
-        emit editorTmpPathChanged(this, path);
     return path;
 }
 
 bool MainWindow::isTextChanged()
 {
-    if (QFile::exists(filePath))
-        setFilePath(QFileInfo(filePath).canonicalFilePath());
-
-    if (isUntitled())
-    {
-        auto content = Util::readFile(SettingsManager::get(QString("%1/Template Path").arg(language)).toString(),
-                                      QString("Read %1 Template").arg(language), log);
-        if (content.isNull())
-            return !editor->toPlainText().isEmpty();
-        else
-            return editor->toPlainText() != content;
-    }
-    else
-    {
-        auto content = Util::readFile(filePath);
-
-        if (content.isNull())
-            return true;
-
-        return editor->toPlainText() != content;
-    }
+    if (!materialized)
+        return pendingTextChanged;
+    // the document is unmodified at the clean state of the undo stack, which is set when the clean text is set,
+    // and it may be changed back to the clean text by editing, so the text is compared by the hash if it's modified
+    return editor->document()->isModified() && !matchesCleanText();
 }
 
 bool MainWindow::closeConfirm()
@@ -927,6 +1418,7 @@ bool MainWindow::closeConfirm()
     bool confirmed = !isTextChanged();
     if (!confirmed)
     {
+        materialize();
         emit confirmTriggered(this);
         auto res = QMessageBox::warning(
             this, "Save changes?",
@@ -965,12 +1457,13 @@ void MainWindow::onFileWatcherChanged(const QString &path)
 {
     LOG_INFO(INFO_OF(path));
 
-    emit editorTextChanged(this);
-
     auto currentText = editor->toPlainText();
 
     auto fileText = Util::readFile(path);
 
+    setCleanText(fileText);
+    emit editorTextChanged(this);
+
     if (!fileText.isNull())
     {
         if (fileText == currentText)
@@ -1057,11 +1550,13 @@ void MainWindow::updateChecker()
 
 QSplitter *MainWindow::getSplitter()
 {
+    materialize();
     return ui->splitter;
 }
 
 QSplitter *MainWindow::getRightSplitter()
 {
+    materialize();
     return ui->right_splitter;
 }
 
@@ -1125,6 +1620,17 @@ void MainWindow::onCompilationFinished(const QString &warning)
         connect(detachedRunner, SIGNAL(failedToStartRun(int, const QString &)), this,
                 SLOT(onFailedToStartRun(int, const QString &)));
         connect(detachedRunner, SIGNAL(runKilled(int)), this, SLOT(onRunKilled(int)));
+        // the Runner is not needed after the terminal is closed or failed to open
+        auto runner = detachedRunner;
+        auto release = [this, runner] {
+            if (detachedRunner == runner)
+            {
+                detachedRunner = nullptr;
+                runner->deleteLater();
+            }
+        };
+        connect(detachedRunner, &Core::Runner::detachedRunFinished, this, release);
+        connect(detachedRunner, &Core::Runner::failedToStartRun, this, release);
         detachedRunner->runDetached(tmpPath(), filePath, language,
                                     SettingsManager::get(QString("%1/Run Command").arg(language)).toString(),
                                     SettingsManager::get(QString("%1/Run Arguments").arg(language)).toString());
@@ -18,6 +18,7 @@
 #ifndef MAINWINDOW_HPP
 #define MAINWINDOW_HPP
 
+#include <QElapsedTimer>
 #include <QMainWindow>
 
 class MessageLogger;
@@ -37,7 +38,11 @@ namespace Core
 {
 class Checker;
 class Compiler;
+class Minimizer;
 class Runner;
+class SaveService;
+struct SaveResult;
+class SessionStore;
 } // namespace Core
 
 namespace Extensions
@@ -77,16 +82,22 @@ class MainWindow : public QMainWindow
         QMap<QString, QVariant> toMap() const;
     };
 
-    explicit MainWindow(const QString &fileOpen, int index, QWidget *parent);
+    explicit MainWindow(const QString &fileOpen, int index, QWidget *parent, bool placeholder = false);
     ~MainWindow() override;
 
+    // A placeholder tab only knows its path and status, the widgets are created when it's materialized.
+    void materialize();
+    bool dematerialize();
+    bool isMaterialized() const;
+    qint64 idleTime() const;
+
     int getUntitledIndex() const;
     QString getFileName() const;
     QString getFilePath() const;
     QString getProblemURL() const;
     QString getCompleteTitle() const;
     QString getTabTitle(bool complete, bool star, int removeLength = 0);
-    QCodeEditor *getEditor() const;
+    QCodeEditor *getEditor();
     bool isUntitled() const;
 
     void setProblemURL(const QString &url);
@@ -94,8 +105,15 @@ class MainWindow : public QMainWindow
 
     EditorStatus toStatus() const;
     void loadStatus(const EditorStatus &status);
+    QVariantMap sessionSummary();
+
+    // The journal of a restored placeholder tab is read when it's materialized, the summary is used until then.
+    void loadSession(Core::SessionStore *store, const QString &id, const QVariantMap &summary);
+    bool isSessionLoaded() const;
 
     void save(bool force, const QString &head, bool safe = true);
+    void autoSave(Core::SaveService *service);
+    void onAutoSaved(const Core::SaveResult &result);
     void saveAs();
 
     bool isTextChanged();
@@ -108,7 +126,9 @@ class MainWindow : public QMainWindow
     void compileAndRun();
     void formatSource();
 
-    void applyCompanion(const Extensions::CompanionData &data);
+    void applyCompanion(const Extensions::CompanionData &data, int checkerIndex = -1);
+    static QString companionMeta(const Extensions::CompanionData &data, const QString &lang);
+    static QString defaultFilePathForProblemURL(const QString &url);
 
     void setLanguage(const QString &lang);
     QString getLanguage();
@@ -152,9 +172,10 @@ class MainWindow : public QMainWindow
 
     void runTestCase(int index);
 
+    void minimizeTestCase(int index);
+
   signals:
     void editorFileChanged();
-    void editorTmpPathChanged(MainWindow *window, const QString &path);
     void editorTextChanged(MainWindow *window);
     void confirmTriggered(MainWindow *widget);
     void requestToastMessage(const QString &head, const QString &body);
@@ -176,7 +197,7 @@ class MainWindow : public QMainWindow
     };
 
     Ui::MainWindow *ui;
-    QCodeEditor *editor;
+    QCodeEditor *editor = nullptr;
     QString language;
     bool isLanguageSet = false;
 
@@ -185,6 +206,8 @@ class MainWindow : public QMainWindow
     QVector<Core::Runner *> runner;
     Core::Checker *checker = nullptr;
     Core::Runner *detachedRunner = nullptr;
+    Core::Minimizer *minimizer = nullptr;
+    Core::SaveService *saveService = nullptr; // the service used by autoSave(), it may be saving this file
     QTemporaryDir *tmpDir = nullptr;
     AfterCompile afterCompile = Nothing;
 
@@ -194,6 +217,8 @@ class MainWindow : public QMainWindow
     QString problemURL;
     QString filePath;
     QString savedText;
+    QByteArray cleanTextHash; // the MD5 of the text which is considered unchanged, i.e. the saved file or the template
+    int cleanTextLength = -1; // the length of the text which is considered unchanged, -1 if it's unknown
     QString cftoolPath;
     QFileSystemWatcher *fileWatcher;
     bool reloading = false;
@@ -203,6 +228,15 @@ class MainWindow : public QMainWindow
 
     Widgets::TestCases *testcases = nullptr;
 
+    bool materialized = false;                         // whether the widgets are created
+    bool hasPendingStatus = false;                     // whether pendingStatus is loaded when the tab is materialized
+    EditorStatus pendingStatus;                        // the status of a placeholder tab
+    bool pendingTextChanged = false;                   // isTextChanged() of a placeholder tab
+    QElapsedTimer lastUsed;                            // restarted whenever the widgets are needed
+    Core::SessionStore *pendingSessionStore = nullptr; // the store to read the journal from, null if it's read
+    QString pendingSessionID;                          // the ID of the journal to read when it's materialized
+
+    void loadPendingSession();
     void setTestCases();
     void setEditor();
     void setupCore();
@@ -215,6 +249,10 @@ class MainWindow : public QMainWindow
     void setFilePath(const QString &path);
     void setText(const QString &text, bool keep = false);
     void updateWatcher();
+    void setCleanText(const QString &text);
+    void reloadCleanText();
+    void updateModified();
+    bool matchesCleanText() const;
     void loadFile(const QString &loadPath);
     bool saveFile(SaveMode mode, const QString &head, bool safe);
     void performCompileAndRunDiagonistics();
@@ -37,22 +37,63 @@ if __name__ == "__main__":
 #include <QFont>
 #include <QRect>
 
-namespace SettingsHelper
+// the index of each setting in settingInfo
+enum class SettingKey : int
 {
 """)
+    keys = []
     for t in obj:
-        name = t["name"]
-        key = name.replace(" ", "").replace("/", "").replace("+", "p")
-        typename = t["type"]
+        keys.append((t["name"], t["name"].replace(" ", "").replace("/", "").replace("+", "p"), t["type"]))
+    for name, key, typename in keys:
+        setting_helper.write(f"    {key},\n")
+    setting_helper.write(f"""}};
+
+const int SETTING_COUNT = {len(keys)};
+
+// the typed values of the settings, kept in sync with SettingsManager, so the getters don't look up the keys
+struct SettingValues
+{{
+""")
+    for name, key, typename in keys:
+        setting_helper.write(f"    {typename} {key};\n")
+    setting_helper.write("""
+    void assign(SettingKey key, const QVariant &value)
+    {
+        switch (key)
+        {
+""")
+    for name, key, typename in keys:
+        setting_helper.write(f"        case SettingKey::{key}:\n")
+        setting_helper.write(f"            {key} = value.value<{typename}>();\n")
+        setting_helper.write("            break;\n")
+    setting_helper.write("""        }
+    }
+};
+
+namespace SettingsHelper
+{
+""")
+    for name, key, typename in keys:
         setting_helper.write(
             f"    inline void set{key}({typename} value) {{ SettingsManager::set({json.dumps(name)}, value); }}\n")
         if typename == "bool":
             setting_helper.write(
-                f"    inline bool is{key}() {{ return SettingsManager::get({json.dumps(name)}).toBool(); }}\n")
+                f"    inline bool is{key}() {{ return SettingsManager::values().{key}; }}\n")
         else:
             setting_helper.write(
-                f"    inline {typename} get{key}() {{ return SettingsManager::get({json.dumps(name)}).value<{typename}>(); }}\n")
-    setting_helper.write("""}
+                f"    inline {typename} get{key}() {{ return SettingsManager::values().{key}; }}\n")
+    setting_helper.write("""
+    // call functor in the thread of context when the setting is changed, e.g. onChanged(SettingKey::TimeLimit, ...)
+    template <typename Functor>
+    inline QMetaObject::Connection onChanged(SettingKey key, const QObject *context, Functor functor)
+    {
+        return QObject::connect(SettingsManager::notifier(), &SettingsNotifier::settingChanged, context,
+                                [key, functor](int changed) {
+                                    if (changed == int(key))
+                                        functor();
+                                });
+    }
+}
 
 #endif // SETTINGSHELPER_HPP""")
     setting_helper.close()